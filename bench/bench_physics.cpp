@@ -0,0 +1,255 @@
+// Times the hot loops of the physics library in isolation.
+//
+//   bench-physics [filter]
+//
+// Only benchmarks whose name contains filter are run. Each prints the
+// fastest of a few repetitions, which is the least noisy number on a shared
+// machine.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "physics/circles.h"
+#include "physics/fewbody.h"
+#include "physics/floatbodies.h"
+#include "physics/gravity.h"
+#include "physics/models.h"
+#include "physics/nbody.h"
+#include "physics/parareal.h"
+#include "physics/retarded.h"
+#include "physics/softbody.h"
+#include "physics/sph.h"
+
+namespace {
+
+const char *filter = "";
+
+void bench(const char *name, int repeats, const std::function<void()> &run) {
+  if (!std::strstr(name, filter))
+    return;
+  double best = 1e300;
+  for (int r = 0; r < repeats; ++r) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    best = std::min(best, std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - start)
+                              .count());
+  }
+  std::printf("%-36s %10.3f ms\n", name, best);
+}
+
+void benchGravity() {
+  for (size_t n : {1000, 4000, 16000}) {
+    BodyStore bodies;
+    addPlummerSphere(bodies, n, 1.0, 1.0, 1.0);
+    std::vector<double> ax(n), ay(n), az(n);
+    char name[64];
+    std::snprintf(name, sizeof(name), "gravity/direct/%zu", n);
+    bench(name, 3, [&] {
+      gravityDirect(n, bodies.x.data(), bodies.y.data(), bodies.z.data(),
+                    bodies.mass.data(), 1.0, 0.01, ax.data(), ay.data(),
+                    az.data());
+    });
+    std::snprintf(name, sizeof(name), "gravity/tiled/%zu", n);
+    bench(name, 3, [&] {
+      gravityDirectTiled(n, bodies.x.data(), bodies.y.data(), bodies.z.data(),
+                         bodies.mass.data(), 1.0, 0.01, ax.data(), ay.data(),
+                         az.data());
+    });
+
+    std::vector<float> x(bodies.x.begin(), bodies.x.end()),
+        y(bodies.y.begin(), bodies.y.end()),
+        z(bodies.z.begin(), bodies.z.end()),
+        m(bodies.mass.begin(), bodies.mass.end());
+    std::vector<float> fx(n), fy(n), fz(n);
+    for (FloatSum sum : {FloatSum::Plain, FloatSum::Kahan, FloatSum::Neumaier,
+                         FloatSum::FloatFloat}) {
+      std::snprintf(name, sizeof(name), "gravity/packed/%s/%zu",
+                    floatSumName(sum), n);
+      bench(name, 3, [&] {
+        gravityDirectPacked(n, x.data(), y.data(), z.data(), m.data(), 1.0f,
+                            0.01f, fx.data(), fy.data(), fz.data(), sum);
+      });
+      if (!std::strstr(name, filter))
+        continue;
+      // against the double sum of the same float inputs
+      std::vector<double> dx(x.begin(), x.end()), dy(y.begin(), y.end()),
+          dz(z.begin(), z.end()), dm(m.begin(), m.end());
+      gravityDirect(n, dx.data(), dy.data(), dz.data(), dm.data(), 1.0,
+                    double(0.01f), ax.data(), ay.data(), az.data());
+      double worst = 0.0;
+      for (size_t i = 0; i < n; ++i) {
+        double a = std::sqrt(ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i]);
+        double e = std::sqrt((fx[i] - ax[i]) * (fx[i] - ax[i]) +
+                             (fy[i] - ay[i]) * (fy[i] - ay[i]) +
+                             (fz[i] - az[i]) * (fz[i] - az[i]));
+        worst = std::max(worst, e / a);
+      }
+      std::printf("%-36s %10.3e relative error\n", "", worst);
+    }
+  }
+
+  for (size_t n : {16000, 100000}) {
+    BodyStore bodies;
+    addPlummerSphere(bodies, n, 1.0, 1.0, 1.0);
+    std::vector<double> ax(n), ay(n), az(n);
+    GravityTree tree;
+    // built up front too, so the walk can be run on its own
+    tree.build(n, bodies.x.data(), bodies.y.data(), bodies.z.data(),
+               bodies.mass.data());
+    char name[64];
+    std::snprintf(name, sizeof(name), "gravity/tree-build/%zu", n);
+    bench(name, 5, [&] {
+      tree.build(n, bodies.x.data(), bodies.y.data(), bodies.z.data(),
+                 bodies.mass.data());
+    });
+    std::snprintf(name, sizeof(name), "gravity/tree-walk/%zu", n);
+    bench(name, 3, [&] {
+      tree.accelerations(1.0, 0.01, 0.5, ax.data(), ay.data(), az.data());
+    });
+    // the cutoff Respa picks: about 32 neighbours at the density inside
+    // the half-mass radius (1.3 for a Plummer sphere)
+    const double cutoff = 1.3 * std::cbrt(64.0 / double(n));
+    std::snprintf(name, sizeof(name), "gravity/short-range/%zu", n);
+    bench(name, 3, [&] {
+      gravityShortRange(n, bodies.x.data(), bodies.y.data(), bodies.z.data(),
+                        bodies.mass.data(), 1.0, 0.01, cutoff, ax.data(),
+                        ay.data(), az.data());
+    });
+  }
+}
+
+void benchBackends() {
+  // the same tree walk on every backend, to see which scales best here
+  const size_t n = 100000;
+  BodyStore bodies;
+  addPlummerSphere(bodies, n, 1.0, 1.0, 1.0);
+  std::vector<double> ax(n), ay(n), az(n);
+  GravityTree tree;
+  tree.build(n, bodies.x.data(), bodies.y.data(), bodies.z.data(),
+             bodies.mass.data());
+  for (Backend backend : {Backend::Serial, Backend::OpenMP,
+                          Backend::ParallelStl, Backend::ThreadPool}) {
+    Executor executor(backend);
+    char name[64];
+    std::snprintf(name, sizeof(name), "backend/%s/tree-walk/%zu",
+                  backendName(backend), n);
+    bench(name, 3, [&] {
+      tree.accelerations(1.0, 0.01, 0.5, ax.data(), ay.data(), az.data(),
+                         executor);
+    });
+  }
+}
+
+void benchNBody() {
+  NBodyParams params;
+  params.G = 1.0;
+  params.softening = 0.01;
+  NBodySystem system(params);
+  addPlummerSphere(system.bodies, 100000, 1.0, 1.0, 1.0);
+  bench("nbody/step/100000", 3, [&] { system.step(1e-3); });
+
+  // ten direct-sum leapfrog steps in double, then in float with each sum
+  // carrying the forces and the state, for what compensating costs
+  NBodyParams direct = params;
+  direct.solver = GravitySolver::Direct;
+  NBodySystem doubles(direct);
+  addPlummerSphere(doubles.bodies, 4000, 1.0, 1.0, 1.0);
+  bench("nbody/direct/double/4000x10", 3, [&] {
+    for (int i = 0; i < 10; ++i)
+      doubles.step(1e-3);
+  });
+  for (FloatSum sum : {FloatSum::Plain, FloatSum::Kahan, FloatSum::Neumaier,
+                       FloatSum::FloatFloat}) {
+    FloatBodies floats(sum);
+    const BodyStore &b = doubles.bodies;
+    for (size_t i = 0; i < b.size(); ++i)
+      floats.add(float(b.x[i]), float(b.y[i]), float(b.z[i]), float(b.vx[i]),
+                 float(b.vy[i]), float(b.vz[i]), float(b.mass[i]));
+    char name[64];
+    std::snprintf(name, sizeof(name), "nbody/direct/%s/4000x10",
+                  floatSumName(sum));
+    bench(name, 3, [&] { stepFloatBodies(floats, 1.0f, 0.01f, 1e-3f, 10); });
+  }
+
+  // test.cpp's three bodies, a million steps through each path
+  NBodySystem three(params);
+  addThreeBodies(three.bodies, 1.0, 1.0, 1.0);
+  FewBodyState<3> state = fewBodiesFrom<3>(three.bodies);
+  bench("nbody/three/1000000", 1, [&] {
+    for (int i = 0; i < 1000000; ++i)
+      three.step(1e-5);
+  });
+  bench("fewbody/three/1000000", 3, [&] {
+    stepFewBody(state, 1.0, 1e-4, 1e-5, 1000000);
+  });
+  // the 1PN terms switched off at compile time, then on
+  bench("fewbody/three/newtonian/1000000", 3, [&] {
+    stepFewBody<3, false>(state, 1.0, 0.0, 1e-5, 1000000, 100.0);
+  });
+  bench("fewbody/three/1pn/1000000", 3, [&] {
+    stepFewBody<3, true>(state, 1.0, 0.0, 1e-5, 1000000, 100.0);
+  });
+  // gravity at a finite speed, from a ring of past states
+  static RetardedHistory<3> history;
+  history.reset(state, 1e-5, 0.05);
+  bench("retarded/three/1000000", 3, [&] {
+    stepRetarded(state, history, 1.0, 0.0, 1000.0, 1000000);
+  });
+  // the same million steps in 8 slices
+  PararealParams slices;
+  slices.fineSteps = 125000;
+  slices.coarseSteps = 1250;
+  bench("parareal/three/1000000", 3, [&] {
+    runParareal(state, 1.0, 1e-4, 10.0, slices);
+  });
+}
+
+void benchSph() {
+  SphGas gas;
+  gas.addCloud(0.0, 0.0, 0.0, 1.0, 20000, 1.0, 0.05);
+  gas.step(0.0); // settle smoothing lengths
+  bench("sph/step/20000", 3, [&] { gas.step(1e-3); });
+}
+
+void benchCircles() {
+  // a settling pile, kept awake so every step does the full work
+  CircleWorldParams params;
+  params.sleep.enabled = false;
+  CircleWorld world(params);
+  for (int i = 0; i < 20000; ++i) {
+    float x = -1.6f + 3.2f * float(i % 200) / 200.0f;
+    float y = -0.9f + 1.8f * float(i / 200) / 100.0f;
+    world.addCircle(x, y, 0.0f, 0.0f, 0.007f);
+  }
+  for (int i = 0; i < 60; ++i)
+    world.step();
+  bench("circles/step/20000", 5, [&] { world.step(); });
+}
+
+void benchCloth() {
+  SoftBodySystem cloth;
+  cloth.addCloth(-1.0f, 1.0f, 0.0f, 2.0f, 0.0f, 0.0f, 0.0f, 0.0f, 2.0f, 128,
+                 128, 1.0f);
+  cloth.params.gravityY = -9.8f;
+  bench("softbody/cloth/128x128", 5, [&] { cloth.step(1.0f / 60.0f); });
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc > 1)
+    filter = argv[1];
+  benchGravity();
+  benchBackends();
+  benchNBody();
+  benchSph();
+  benchCircles();
+  benchCloth();
+  return 0;
+}
@@ -1,62 +1,74 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
-#include <cmath>  // For M_PI, sin, cos
+#include <cstddef> // For offsetof
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp> // For passing matrix to OpenGL
+#include "physics/circles.h"
+#include "physics/lockstep.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window);
-void drawCircle(unsigned int shaderProgram, unsigned int VAO, glm::vec2 &position, glm::vec2 velocity, float deltaTime); 
 
 // Screen settings
 const unsigned int SCR_WIDTH = 1920;
 const unsigned int SCR_HEIGHT = 1080;
 
-const int numSegments = 100; // Number of segments in the circle (higher = smoother circle)
-const float radius = 0.1f;   // Radius of the circle
-const float centerX = 0.0f;  // X position of the center
-const float centerY = 0.0f;  // Y position of the center
-
-// Function to create the circle's vertices
-std::vector<float> generateCircleVertices() {
-    std::vector<float> vertices;
-    
-    // Add the center vertex (this will be used in the triangle fan)
-    vertices.push_back(centerX);
-    vertices.push_back(centerY);
-    vertices.push_back(0.0f); // Z-coordinate (assuming we're in 2D, so 0)
-
-    // Generate vertices around the circle
-    for (int i = 0; i <= numSegments; ++i) {
-        float angle = (2.0f * M_PI * i) / numSegments;
-        float x = centerX + radius * cos(angle);
-        float y = centerY + radius * sin(angle);
-        
-        vertices.push_back(x);
-        vertices.push_back(y);
-        vertices.push_back(0.0f); // Z-coordinate
-    }
-    
-    return vertices;
-}
+const int numCircles = 2000;          // Circles dropped into the box
+const float circleRadius = 0.015f;    // Radius of the simulated circles
+
+// Per-circle data uploaded every frame: center, radius and colour
+struct CircleInstance {
+    float x, y;
+    float radius;
+    float r, g, b;
+};
+
+// A unit quad drawn as a triangle strip. Every circle is this quad, moved and
+// scaled in the vertex shader, with the round edge cut out in the fragment
+// shader, so smoothness no longer costs vertices.
+const float quadVertices[] = {
+    -1.0f, -1.0f,
+     1.0f, -1.0f,
+    -1.0f,  1.0f,
+     1.0f,  1.0f,
+};
 
 const char *vertexShaderSource = "#version 330 core\n"
-    "layout (location = 0) in vec3 aPos;\n"
-    "uniform mat4 projection;\n" // Add projection uniform
-    "uniform mat4 model;\n" // Add model matrix
+    "layout (location = 0) in vec2 aCorner;\n"
+    "layout (location = 1) in vec3 aCircle;\n" // Center x, y and radius
+    "layout (location = 2) in vec3 aColor;\n"
+    "uniform mat4 projection;\n"
+    "uniform float pixelSize;\n" // Size of one pixel in world units
+    "out vec2 local;\n"
+    "out float circleRadius;\n"
+    "out vec3 color;\n"
     "void main()\n"
     "{\n"
-    "   gl_Position = projection * vec4(aPos.x, aPos.y, aPos.z, 1.0);\n"
+    "   // Grow the quad by a pixel so the antialiased edge isn't clipped\n"
+    "   local = aCorner * (aCircle.z + pixelSize);\n"
+    "   circleRadius = aCircle.z;\n"
+    "   color = aColor;\n"
+    "   gl_Position = projection * vec4(aCircle.xy + local, 0.0, 1.0);\n"
     "}\0";
 
 const char *fragmentShaderSource = "#version 330 core\n"
+    "in vec2 local;\n"
+    "in float circleRadius;\n"
+    "in vec3 color;\n"
+    "uniform float pixelSize;\n"
     "out vec4 FragColor;\n"
     "void main()\n"
     "{\n"
-    "   FragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f);\n"
+    "   // Signed distance to the circle's edge, negative inside\n"
+    "   float dist = length(local) - circleRadius;\n"
+    "   // Fade out over one pixel across the edge\n"
+    "   float coverage = clamp(0.5 - dist / pixelSize, 0.0, 1.0);\n"
+    "   if (coverage <= 0.0)\n"
+    "       discard;\n"
+    "   FragColor = vec4(color, coverage);\n"
     "}\n\0";
 
 int main()
@@ -128,32 +140,76 @@ int main()
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
 
-    unsigned int VBO, VAO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    // Look the uniforms up once instead of every frame
+    GLint projectionLoc = glGetUniformLocation(shaderProgram, "projection");
+    GLint pixelSizeLoc = glGetUniformLocation(shaderProgram, "pixelSize");
 
-    std::vector<float> circleVertices = generateCircleVertices();
+    unsigned int quadVBO, instanceVBO, VAO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &quadVBO);
+    glGenBuffers(1, &instanceVBO);
 
     glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, circleVertices.size() * sizeof(float), circleVertices.data(), GL_STATIC_DRAW);
-
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0); 
-    glBindVertexArray(0);
 
-    // Get uniform location for the projection matrix
-    GLint projectionLoc = glGetUniformLocation(shaderProgram, "projection");
+    // One CircleInstance per circle, advanced once per instance rather than per vertex
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(CircleInstance), (void*)offsetof(CircleInstance, x));
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(CircleInstance), (void*)offsetof(CircleInstance, r));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
 
-// Define velocity (direction and speed of the circle)
-    glm::vec2 velocity(0.0f, -0.1f);  // Move diagonally at 0.1 units per second
-    glm::vec2 position(0.0f, 0.0f);  // Starting at the center of the screen
+    // The circle edges are blended using the coverage from the fragment shader
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Physics world filling the visible area, stepped at a fixed 60 Hz
+#ifdef CIRCLE_LOCKSTEP
+    // Fixed-point world for lockstep sessions (compile with -DCIRCLE_LOCKSTEP).
+    // The scene is built from integers only so every peer starts bit-identical.
+    FixedCircleWorldParams<Fixed16> params;
+    Fixed16 aspect = Fixed16::fromRatio(SCR_WIDTH, SCR_HEIGHT);
+    params.minX = -aspect;
+    params.maxX = aspect;
+    FixedCircleWorld<Fixed16> world(params);
+
+    // Same grid as below, with circleRadius written as a ratio
+    Fixed16 fixedRadius = Fixed16::fromRatio(15, 1000);
+    Fixed16 spacing = fixedRadius * Fixed16::fromRatio(5, 2);
+    int perRow = int(((aspect + aspect) / spacing).raw >> Fixed16::fracBits);
+    for (int i = 0; i < numCircles; ++i) {
+        Fixed16 x = -aspect + fixedRadius + fixedRadius + spacing * Fixed16::fromInt(i % perRow);
+        Fixed16 y = Fixed16::fromRatio(9, 10) - spacing * Fixed16::fromInt(i / perRow);
+        world.addCircle(x, y, Fixed16(), Fixed16(), fixedRadius * Fixed16::fromRatio(9 + i % 7, 12));
+    }
+#else
+    float startAspect = float(SCR_WIDTH) / float(SCR_HEIGHT);
+    CircleWorldParams params;
+    params.minX = -startAspect;
+    params.maxX = startAspect;
+    CircleWorld world(params);
+
+    // Drop the circles in from a loose grid in the top half of the screen
+    int perRow = int(2.0f * startAspect / (2.5f * circleRadius));
+    for (int i = 0; i < numCircles; ++i) {
+        float x = -startAspect + 2.0f * circleRadius + (i % perRow) * 2.5f * circleRadius;
+        float y = 0.9f - (i / perRow) * 2.5f * circleRadius;
+        world.addCircle(x, y, 0.0f, 0.0f, circleRadius * (0.75f + 0.5f * float(i % 7) / 6.0f));
+    }
+#endif
 
     // Time variables for velocity calculation
     float deltaTime = 0.0f;
     float lastFrame = 0.0f;
+
+    std::vector<CircleInstance> instances;
     
     // Render loop
     while (!glfwWindowShouldClose(window))
@@ -181,14 +237,30 @@ int main()
         glm::mat4 projection = glm::ortho(-1.0f * aspectRatio, 1.0f * aspectRatio, -1.0f, 1.0f, -1.0f, 1.0f);
 
         glUseProgram(shaderProgram);
-        GLint projectionLoc = glGetUniformLocation(shaderProgram, "projection");
         glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection)); // Send projection matrix to the shader
+        glUniform1f(pixelSizeLoc, 2.0f / float(height));
+
+        world.update(deltaTime);
+
+        // Sleeping circles are drawn darker
+        instances.resize(world.size());
+        for (size_t i = 0; i < world.size(); ++i) {
+#ifdef CIRCLE_LOCKSTEP
+            instances[i] = {world.x[i].toFloat(), world.y[i].toFloat(), world.radius[i].toFloat(), 1.0f, 0.5f, 0.2f};
+#else
+            float shade = world.isAwake(int(i)) ? 1.0f : 0.6f;
+            instances[i] = {world.x[i], world.y[i], world.radius[i], 1.0f * shade, 0.5f * shade, 0.2f * shade};
+#endif
+        }
 
-        //glBindVertexArray(VAO);
-        //glDrawArrays(GL_TRIANGLE_FAN, 0, circleVertices.size() / 3); // +1 to include the center vertex
-        //glBindVertexArray(0);
+        // Upload this frame's circles and draw them all in one call
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(CircleInstance), instances.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-        drawCircle(shaderProgram, VAO, position, velocity, deltaTime);
+        glBindVertexArray(VAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(instances.size()));
+        glBindVertexArray(0);
 
         // Swap buffers and poll events
         glfwSwapBuffers(window);
@@ -196,7 +268,8 @@ int main()
     }
 
     glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &quadVBO);
+    glDeleteBuffers(1, &instanceVBO);
     glDeleteProgram(shaderProgram);
     glfwTerminate();
     return 0;
@@ -212,32 +285,3 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     glViewport(0, 0, width, height);
 }
-
-void drawCircle(unsigned int shaderProgram, unsigned int VAO, glm::vec2 &position, glm::vec2 velocity, float deltaTime) {
-    // Update position based on velocity
-    position += velocity * deltaTime;
-
-    // Stop the circle from falling below the bottom of the screen
-    if (position.y - radius <= -1.0f) {  // Ensure the circle stops at the bottom of the screen
-        position.y = -1.0f + radius;  // Set the circle at the bottom, no further movement allowed
-    }
-
-    // Create a translation matrix for the position
-    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(position, 0.0f));
-
-    // Get uniform location for the model matrix
-    GLint modelLoc = glGetUniformLocation(shaderProgram, "model");
-
-    // Use the shader program
-    glUseProgram(shaderProgram);
-
-    // Send the model matrix to the shader
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-
-    // Draw the circle
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLE_FAN, 0, numSegments + 2);  // +2 to include the center vertex
-    glBindVertexArray(0);
-}
-
-
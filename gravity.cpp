@@ -6,6 +6,10 @@
 #include <iostream>
 #include <vector>
 
+#include "physics/ccd.h"
+#include "physics/nbody.h"
+#include "physics/softbody.h"
+
 const char *vertexShaderSource = R"glsl(
 #version 330 core
 layout(location=0) in vec3 aPos;
@@ -141,10 +145,11 @@ public:
     return vertices;
   }
 
-  void UpdatePos() {
-    this->position[0] += this->velocity[0] / 94;
-    this->position[1] += this->velocity[1] / 94;
-    this->position[2] += this->velocity[2] / 94;
+  // moves the object through part of a frame (all of it by default)
+  void UpdatePos(float fraction = 1.0f) {
+    this->position[0] += this->velocity[0] / 94 * fraction;
+    this->position[1] += this->velocity[1] / 94 * fraction;
+    this->position[2] += this->velocity[2] / 94 * fraction;
     this->radius = pow(((3 * this->mass / this->density) / (4 * 3.14159265359)),
                        (1.0f / 3.0f)) /
                    sizeRatio;
@@ -164,15 +169,30 @@ public:
     this->velocity[1] += y / 96;
     this->velocity[2] += z / 96;
   }
-  float CheckCollision(const Object &other) {
-    float dx = other.position[0] - this->position[0];
-    float dy = other.position[1] - this->position[1];
-    float dz = other.position[2] - this->position[2];
-    float distance = std::pow(dx * dx + dy * dy + dz * dz, (1.0f / 2.0f));
-    if (other.radius + this->radius > distance) {
-      return -0.2f;
-    }
-    return 1.0f;
+  // Sweeps both objects through the given fraction of a frame and reports
+  // when they would first touch, as a fraction of that motion, so fast
+  // objects can't pass through each other between frames.
+  bool CheckCollision(const Object &other, float fraction, float &toi) const {
+    glm::vec3 offset = other.position - this->position;
+    glm::vec3 motion = (other.velocity - this->velocity) / 94.0f * fraction;
+    return sweptSphereTOI(offset.x, offset.y, offset.z, motion.x, motion.y,
+                          motion.z, this->radius + other.radius, toi);
+  }
+  // Bounces two touching objects off each other, keeping a fifth of their
+  // closing speed.
+  void Collide(Object &other) {
+    glm::vec3 normal = other.position - this->position;
+    float distance = glm::length(normal);
+    if (distance <= 0)
+      return;
+    normal /= distance;
+    float closing = glm::dot(this->velocity - other.velocity, normal);
+    if (closing <= 0)
+      return;
+    float impulse = (1.0f + 0.2f) * closing /
+                    (1.0f / this->mass + 1.0f / other.mass);
+    this->velocity -= normal * (impulse / this->mass);
+    other.velocity += normal * (impulse / other.mass);
   }
 };
 std::vector<Object> objs = {};
@@ -181,8 +201,13 @@ std::vector<float> CreateGridVertices(float size, int divisions,
                                       const std::vector<Object> &objs);
 std::vector<float> UpdateGridVertices(std::vector<float> vertices,
                                       const std::vector<Object> &objs);
+void ApplyGravity(std::vector<Object> &objs);
+void MoveObjects(std::vector<Object> &objs);
+void UpdateCloth(SoftBodySystem &cloth, const std::vector<Object> &objs);
+std::vector<float> CreateClothVertices(SoftBodySystem &cloth);
 
 GLuint gridVAO, gridVBO;
+GLuint clothVAO, clothVBO;
 
 int main() {
   GLFWwindow *window = StartGLU();
@@ -224,6 +249,15 @@ int main() {
   std::vector<float> gridVertices = CreateGridVertices(20000.0f, 25, objs);
   CreateVBOVAO(gridVAO, gridVBO, gridVertices.data(), gridVertices.size());
 
+  // a sheet of cloth above the bodies, held at two corners, that falls
+  // towards them and drapes over them
+  SoftBodyParams clothParams;
+  clothParams.softening = 200.0f;
+  SoftBodySystem cloth(clothParams);
+  cloth.addCloth(-1500, 3000, -1850, 3000, 0, 0, 0, 0, 3000, 48, 48, 1.0f);
+  std::vector<float> clothVertices = CreateClothVertices(cloth);
+  CreateVBOVAO(clothVAO, clothVBO, clothVertices.data(), clothVertices.size());
+
   while (!glfwWindowShouldClose(window) && running == true) {
     float currentFrame = glfwGetTime();
     deltaTime = currentFrame - lastFrame;
@@ -261,37 +295,27 @@ int main() {
                  gridVertices.data(), GL_DYNAMIC_DRAW);
     DrawGrid(shaderProgram, gridVAO, gridVertices.size());
 
+    // Draw the cloth
+    if (!pause) {
+      UpdateCloth(cloth, objs);
+    }
+    glUniform4f(objectColorLoc, 0.8f, 0.8f, 1.0f, 0.6f);
+    clothVertices = CreateClothVertices(cloth);
+    glBindBuffer(GL_ARRAY_BUFFER, clothVBO);
+    glBufferData(GL_ARRAY_BUFFER, clothVertices.size() * sizeof(float),
+                 clothVertices.data(), GL_DYNAMIC_DRAW);
+    DrawGrid(shaderProgram, clothVAO, clothVertices.size());
+
+    // pull every body towards the others
+    if (!pause) {
+      ApplyGravity(objs);
+    }
+
     // Draw the triangles / sphere
     for (auto &obj : objs) {
       glUniform4f(objectColorLoc, obj.color.r, obj.color.g, obj.color.b,
                   obj.color.a);
 
-      for (auto &obj2 : objs) {
-        if (&obj2 != &obj && !obj.Initalizing && !obj2.Initalizing) {
-          float dx = obj2.GetPos()[0] - obj.GetPos()[0];
-          float dy = obj2.GetPos()[1] - obj.GetPos()[1];
-          float dz = obj2.GetPos()[2] - obj.GetPos()[2];
-          float distance = sqrt(dx * dx + dy * dy + dz * dz);
-
-          if (distance > 0) {
-            std::vector<float> direction = {dx / distance, dy / distance,
-                                            dz / distance};
-            distance *= 1000;
-            double Gforce = (G * obj.mass * obj2.mass) / (distance * distance);
-
-            float acc1 = Gforce / obj.mass;
-            std::vector<float> acc = {direction[0] * acc1, direction[1] * acc1,
-                                      direction[2] * acc1};
-            if (!pause) {
-              obj.accelerate(acc[0], acc[1], acc[2]);
-            }
-
-            // collision
-            obj.velocity *= obj.CheckCollision(obj2);
-            std::cout << "radius: " << obj.radius << std::endl;
-          }
-        }
-      }
       if (obj.Initalizing) {
         obj.radius = pow(((3 * obj.mass / obj.density) / (4 * 3.14159265359)),
                          (1.0f / 3.0f)) /
@@ -299,11 +323,6 @@ int main() {
         obj.UpdateVertices();
       }
 
-      // update positions
-      if (!pause) {
-        obj.UpdatePos();
-      }
-
       glm::mat4 model = glm::mat4(1.0f);
       model = glm::translate(model, obj.position); // apply position
       glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
@@ -318,6 +337,11 @@ int main() {
       glDrawArrays(GL_TRIANGLES, 0, obj.vertexCount / 3);
     }
 
+    // update positions, stopping at each collision along the way
+    if (!pause) {
+      MoveObjects(objs);
+    }
+
     glfwSwapBuffers(window);
     glfwPollEvents();
   }
@@ -329,6 +353,8 @@ int main() {
 
   glDeleteVertexArrays(1, &gridVAO);
   glDeleteBuffers(1, &gridVBO);
+  glDeleteVertexArrays(1, &clothVAO);
+  glDeleteBuffers(1, &clothVBO);
 
   glDeleteProgram(shaderProgram);
   glfwTerminate();
@@ -666,3 +692,91 @@ std::vector<float> UpdateGridVertices(std::vector<float> vertices,
 
   return vertices;
 }
+void ApplyGravity(std::vector<Object> &objs) {
+  // Positions are in km, so with distances in metres G * M / d^2 becomes
+  // (G / 1000^2) * M / d^2. Objects still being placed neither pull nor
+  // get pulled.
+  NBodyParams params;
+  params.G = G / 1.0e6;
+  params.solver = GravitySolver::Direct;
+  NBodySystem system(params);
+  std::vector<Object *> moving;
+  for (auto &obj : objs) {
+    if (obj.Initalizing)
+      continue;
+    system.addBody(obj.position.x, obj.position.y, obj.position.z, 0, 0, 0,
+                   obj.mass);
+    moving.push_back(&obj);
+  }
+  system.computeAccelerations();
+  for (size_t i = 0; i < moving.size(); ++i) {
+    moving[i]->accelerate(system.ax[i], system.ay[i], system.az[i]);
+  }
+}
+void MoveObjects(std::vector<Object> &objs) {
+  // Advance everything to the earliest collision in what is left of the
+  // frame, bounce that pair, and repeat. The cap keeps objects resting
+  // against each other from eating the whole frame in tiny steps.
+  const int maxCollisions = 16;
+  float remaining = 1.0f;
+  for (int event = 0; event < maxCollisions && remaining > 0; ++event) {
+    float first = 1.0f;
+    Object *a = nullptr;
+    Object *b = nullptr;
+    for (size_t i = 0; i < objs.size(); ++i) {
+      for (size_t j = i + 1; j < objs.size(); ++j) {
+        if (objs[i].Initalizing || objs[j].Initalizing)
+          continue;
+        float toi;
+        if (objs[i].CheckCollision(objs[j], remaining, toi) && toi < first) {
+          first = toi;
+          a = &objs[i];
+          b = &objs[j];
+        }
+      }
+    }
+
+    for (auto &obj : objs) {
+      obj.UpdatePos(remaining * first);
+    }
+    if (!a)
+      return;
+    a->Collide(*b);
+    remaining *= 1.0f - first;
+  }
+  // out of collisions to handle: finish the frame without stopping
+  for (auto &obj : objs) {
+    obj.UpdatePos(remaining);
+  }
+}
+void UpdateCloth(SoftBodySystem &cloth, const std::vector<Object> &objs) {
+  // The bodies pull on the cloth and push it out of their way. Objects gain
+  // acc / 96 velocity and move velocity / 94 per frame with acc computed in
+  // metres, so in grid units per frame^2 a body pulls with
+  // G * M / (1000^2 * 96 * 94) / d^2. The cloth is far too light to pull
+  // back.
+  cloth.attractors.clear();
+  for (const auto &obj : objs) {
+    if (obj.Initalizing)
+      continue;
+    cloth.attractors.push_back({obj.position.x, obj.position.y,
+                                obj.position.z,
+                                float(G * obj.mass / (1.0e6 * 96.0 * 94.0)),
+                                obj.radius * 1.05f});
+  }
+  cloth.step(1.0f);
+}
+std::vector<float> CreateClothVertices(SoftBodySystem &cloth) {
+  // every constraint drawn as a line
+  const std::vector<int> &a = cloth.distanceA();
+  const std::vector<int> &b = cloth.distanceB();
+  std::vector<float> vertices;
+  vertices.reserve(a.size() * 6);
+  for (size_t k = 0; k < a.size(); ++k) {
+    vertices.insert(vertices.end(),
+                    {cloth.x[a[k]], cloth.y[a[k]], cloth.z[a[k]]});
+    vertices.insert(vertices.end(),
+                    {cloth.x[b[k]], cloth.y[b[k]], cloth.z[b[k]]});
+  }
+  return vertices;
+}
@@ -0,0 +1,34 @@
+#include "ccd.h"
+
+#include <cmath>
+
+bool sweptSphereTOI(float px, float py, float pz, float dx, float dy, float dz,
+                    float radiusSum, float &toi) {
+  // |p + t d| = radiusSum  ->  a t^2 + 2 b t + c = 0
+  float a = dx * dx + dy * dy + dz * dz;
+  float b = px * dx + py * dy + pz * dz;
+  float c = px * px + py * py + pz * pz - radiusSum * radiusSum;
+
+  if (b >= 0.0f) // not approaching
+    return false;
+  if (c <= 0.0f) {
+    toi = 0.0f;
+    return true;
+  }
+  float disc = b * b - a * c;
+  if (disc < 0.0f) // passes by
+    return false;
+  // earliest root, written to stay accurate when the motion is tiny
+  float t = c / (-b + std::sqrt(disc));
+  if (t > 1.0f)
+    return false;
+  toi = t;
+  return true;
+}
+
+bool sweptPlaneTOI(float gapStart, float gapEnd, float &toi) {
+  if (gapEnd >= 0.0f || gapEnd >= gapStart)
+    return false;
+  toi = gapStart <= 0.0f ? 0.0f : gapStart / (gapStart - gapEnd);
+  return true;
+}
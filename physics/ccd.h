@@ -0,0 +1,25 @@
+#pragma once
+
+// Time of impact for bodies moving in straight lines over one step. Each
+// function takes the motion as a start state plus the displacement over the
+// whole step and reports the first contact as a fraction of the step in
+// [0, 1], so the caller can advance to the impact, respond, and carry on with
+// the rest of the step instead of only noticing overlap at the end of it.
+
+// Two spheres, given as b relative to a: (px, py, pz) is b's offset from a at
+// the start of the step and (dx, dy, dz) how much further b moves relative to
+// a during it. Returns false if they never come within radiusSum, or if they
+// already overlap and are separating. Spheres that overlap and keep
+// approaching report an impact at 0.
+bool sweptSphereTOI(float px, float py, float pz, float dx, float dy, float dz,
+                    float radiusSum, float &toi);
+
+// The same test in 2D.
+inline bool sweptCircleTOI(float px, float py, float dx, float dy,
+                           float radiusSum, float &toi) {
+  return sweptSphereTOI(px, py, 0.0f, dx, dy, 0.0f, radiusSum, toi);
+}
+
+// A body against a fixed plane, given as the signed gap between them at the
+// start and end of the step (positive while clear of the plane).
+bool sweptPlaneTOI(float gapStart, float gapEnd, float &toi);
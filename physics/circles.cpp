@@ -0,0 +1,581 @@
+#include "circles.h"
+
+#include <algorithm>
+#include <cmath>
+
+CircleWorld::CircleWorld(const CircleWorldParams &params) : params(params) {}
+
+int CircleWorld::addCircle(float px, float py, float pvx, float pvy, float r,
+                           float density) {
+  x.push_back(px);
+  y.push_back(py);
+  vx.push_back(pvx);
+  vy.push_back(pvy);
+  w.push_back(0.0f);
+  radius.push_back(r);
+  // density <= 0 makes a static circle
+  float mass = density * 3.14159265359f * r * r;
+  invMass.push_back(mass > 0.0f ? 1.0f / mass : 0.0f);
+  invInertia.push_back(mass > 0.0f ? 2.0f / (mass * r * r) : 0.0f);
+  maxRadius = std::max(maxRadius, r);
+  islands.addBody(mass > 0.0f);
+  return int(x.size()) - 1;
+}
+
+void CircleWorld::wake(int i) {
+  if (islands.wake(i))
+    manager.unpark([&](int b) { return !islands.isAwake(b); });
+}
+
+void CircleWorld::clear() {
+  x.clear();
+  y.clear();
+  vx.clear();
+  vy.clear();
+  w.clear();
+  radius.clear();
+  invMass.clear();
+  invInertia.clear();
+  manager.clear();
+  islands.clear();
+  impactList.clear();
+  maxRadius = 0.0f;
+  accumulator = 0.0f;
+}
+
+int CircleWorld::update(float frameTime) {
+  accumulator += frameTime;
+  int steps = 0;
+  while (accumulator >= params.fixedDt && steps < params.maxSubSteps) {
+    step();
+    accumulator -= params.fixedDt;
+    ++steps;
+  }
+  // running behind: drop the backlog instead of spiralling
+  if (steps == params.maxSubSteps)
+    accumulator = std::min(accumulator, params.fixedDt);
+  return steps;
+}
+
+void CircleWorld::step() {
+  impactList.clear();
+  // a fully settled world costs nothing
+  if (islands.awakeBodies().empty())
+    return;
+
+  const int n = int(size());
+  startX.resize(n);
+  startY.resize(n);
+  for (int i : islands.awakeBodies()) {
+    startX[i] = x[i];
+    startY[i] = y[i];
+  }
+
+  buildGrid();
+  wakeTouched();
+  findContacts();
+  manager.update(found);
+  prepareContacts();
+
+  // Contacts are found once per step; each substep re-measures their
+  // separation from the current positions along the step's normal.
+  const int subSteps = std::max(1, params.solverSubSteps);
+  const float h = params.fixedDt / float(subSteps);
+  for (int sub = 0; sub < subSteps; ++sub) {
+    integrateVelocities(h);
+    warmStart();
+    solveContacts(h, true);
+    integratePositions(h);
+    solveContacts(h, false);
+  }
+  applyRestitution();
+  if (params.continuous)
+    solveContinuous();
+  updateSleep(params.fixedDt);
+}
+
+void CircleWorld::integrateVelocities(float h) {
+  const std::vector<int> &active = islands.awakeBodies();
+  const int n = int(active.size());
+  const float gx = params.gravityX * h;
+  const float gy = params.gravityY * h;
+
+#pragma omp parallel for schedule(static)
+  for (int k = 0; k < n; ++k) {
+    int i = active[k];
+    vx[i] += gx;
+    vy[i] += gy;
+  }
+}
+
+void CircleWorld::integratePositions(float h) {
+  const std::vector<int> &active = islands.awakeBodies();
+  const int n = int(active.size());
+
+#pragma omp parallel for schedule(static)
+  for (int k = 0; k < n; ++k) {
+    int i = active[k];
+    x[i] += vx[i] * h;
+    y[i] += vy[i] * h;
+  }
+}
+
+void CircleWorld::updateSleep(float dt) {
+  const SleepSettings &sleep = params.sleep;
+  if (!sleep.enabled)
+    return;
+
+  const float linear2 = sleep.linearTolerance * sleep.linearTolerance;
+  for (int i : islands.awakeBodies()) {
+    bool resting = vx[i] * vx[i] + vy[i] * vy[i] < linear2 &&
+                   std::abs(w[i]) < sleep.angularTolerance;
+    islands.rest(i, resting, dt);
+  }
+  for (const CircleContact &c : manager.contacts()) {
+    if (c.b >= 0 && !islands.isStatic(c.a) && !islands.isStatic(c.b))
+      islands.link(c.a, c.b);
+  }
+
+  if (islands.sleepIslands(sleep) == 0)
+    return;
+  const int n = int(size());
+  for (int i = 0; i < n; ++i) {
+    if (islands.isSleeping(i)) {
+      vx[i] = 0.0f;
+      vy[i] = 0.0f;
+      w[i] = 0.0f;
+    }
+  }
+  manager.park([&](int b) { return !islands.isAwake(b); });
+}
+
+void CircleWorld::solveContinuous() {
+  // Speculative contacts only cover circles that started the step within
+  // reach of each other, so anything that moved further than its margin may
+  // have passed straight through something. Those circles are swept from
+  // where they started against where everything else started and ended, and
+  // moved back to the first impact. Their velocity is kept; next step the
+  // impact is a speculative contact and the solver takes it from there.
+  const float margin = params.speculativeMargin;
+  const CircleWorldParams &p = params;
+
+  for (int i : islands.awakeBodies()) {
+    const float dx = x[i] - startX[i];
+    const float dy = y[i] - startY[i];
+    const float r = radius[i];
+    const float fast = margin * r;
+    if (dx * dx + dy * dy <= fast * fast)
+      continue;
+
+    float toi = 1.0f;
+    int hit = 0;
+    float t;
+    auto consider = [&](int other) {
+      if (t < toi) {
+        toi = t;
+        hit = other;
+      }
+    };
+
+    // walls, as in findContacts(): -1 left, -2 right, -3 floor, -4 ceiling.
+    // Ones that were already within reach have a contact.
+    auto wall = [&](float gapStart, float gapEnd, int other) {
+      if (gapStart > fast && sweptPlaneTOI(gapStart, gapEnd, t))
+        consider(other);
+    };
+    wall(startX[i] - r - p.minX, x[i] - r - p.minX, -1);
+    wall(p.maxX - startX[i] - r, p.maxX - x[i] - r, -2);
+    wall(startY[i] - r - p.minY, y[i] - r - p.minY, -3);
+    wall(p.maxY - startY[i] - r, p.maxY - y[i] - r, -4);
+
+    // The grid holds start positions. Slow circles moved less than their
+    // margin, so widening the swept box by one radius plus a margin catches
+    // every one the path could reach.
+    const float grow = r + maxRadius * (1.0f + margin);
+    const int x0 = cellOf(std::min(startX[i], x[i]) - grow, 0.0f) % gridW;
+    const int x1 = cellOf(std::max(startX[i], x[i]) + grow, 0.0f) % gridW;
+    const int y0 = cellOf(0.0f, std::min(startY[i], y[i]) - grow) / gridW;
+    const int y1 = cellOf(0.0f, std::max(startY[i], y[i]) + grow) / gridW;
+    for (int cy = y0; cy <= y1; ++cy) {
+      for (int cx = x0; cx <= x1; ++cx) {
+        int cell = cy * gridW + cx;
+        for (int k = cellStart[cell]; k < cellStart[cell + 1]; ++k) {
+          int j = cellBodies[k];
+          if (j == i)
+            continue;
+          // sleeping and static circles didn't move this step
+          float jx0 = islands.isAwake(j) ? startX[j] : x[j];
+          float jy0 = islands.isAwake(j) ? startY[j] : y[j];
+          float px = jx0 - startX[i];
+          float py = jy0 - startY[i];
+          float rs = r + radius[j];
+          // already in contact at the start, so the solver has it
+          if (px * px + py * py < rs * rs * (1.0f + margin) * (1.0f + margin))
+            continue;
+          if (sweptCircleTOI(px, py, (x[j] - jx0) - dx, (y[j] - jy0) - dy, rs,
+                             t))
+            consider(j);
+        }
+      }
+    }
+
+    if (toi < 1.0f) {
+      x[i] = startX[i] + dx * toi;
+      y[i] = startY[i] + dy * toi;
+      impactList.push_back({i, hit, toi});
+    }
+  }
+}
+
+void CircleWorld::wakeTouched() {
+  // Anything an awake circle could touch this step wakes up first, so the
+  // narrowphase never has to pair awake bodies with sleeping ones.
+  const std::vector<int> &active = islands.awakeBodies();
+  const float margin = 1.0f + params.speculativeMargin;
+  std::vector<int> touched;
+
+  for (int i : active) {
+    const int cx = bodyCell[i] % gridW, cy = bodyCell[i] / gridW;
+    for (int ny = std::max(cy - 1, 0); ny <= std::min(cy + 1, gridH - 1); ++ny) {
+      for (int nx = std::max(cx - 1, 0); nx <= std::min(cx + 1, gridW - 1);
+           ++nx) {
+        int nc = ny * gridW + nx;
+        for (int k = cellStart[nc]; k < cellStart[nc + 1]; ++k) {
+          int j = cellBodies[k];
+          if (!islands.isSleeping(j))
+            continue;
+          float dx = x[j] - x[i];
+          float dy = y[j] - y[i];
+          float reach = (radius[i] + radius[j]) * margin;
+          if (dx * dx + dy * dy < reach * reach)
+            touched.push_back(j);
+        }
+      }
+    }
+  }
+
+  bool woke = false;
+  for (int j : touched)
+    woke |= islands.wake(j);
+  if (woke)
+    manager.unpark([&](int b) { return !islands.isAwake(b); });
+}
+
+int CircleWorld::cellOf(float px, float py) const {
+  int cx = int((px - params.minX) / cellSize);
+  int cy = int((py - params.minY) / cellSize);
+  cx = std::clamp(cx, 0, gridW - 1);
+  cy = std::clamp(cy, 0, gridH - 1);
+  return cy * gridW + cx;
+}
+
+void CircleWorld::buildGrid() {
+  const int n = int(size());
+  // wide enough that speculative pairs are always in neighbouring cells
+  cellSize = std::max(2.0f * maxRadius * (1.0f + params.speculativeMargin), 1e-6f);
+  gridW = std::max(1, int(std::ceil((params.maxX - params.minX) / cellSize)));
+  gridH = std::max(1, int(std::ceil((params.maxY - params.minY) / cellSize)));
+  const int cells = gridW * gridH;
+
+  // counting sort of bodies into cells
+  cellStart.assign(cells + 1, 0);
+  bodyCell.resize(n);
+  for (int i = 0; i < n; ++i) {
+    bodyCell[i] = cellOf(x[i], y[i]);
+    ++cellStart[bodyCell[i] + 1];
+  }
+  for (int c = 0; c < cells; ++c)
+    cellStart[c + 1] += cellStart[c];
+
+  cellBodies.resize(n);
+  std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+  for (int i = 0; i < n; ++i)
+    cellBodies[fill[bodyCell[i]]++] = i;
+}
+
+void CircleWorld::findContacts() {
+  const std::vector<int> &active = islands.awakeBodies();
+  const int n = int(active.size());
+  const float margin = 1.0f + params.speculativeMargin;
+  const CircleWorldParams &p = params;
+
+  // Awake bodies are handled in fixed chunks, each gathering the contacts of
+  // its bodies with higher-indexed awake neighbours, static circles and the
+  // walls. Emitting them in (a, b) order per body means the chunks usually
+  // concatenate already sorted by key, whatever the thread count.
+  const int chunkSize = 1024;
+  const int chunks = (n + chunkSize - 1) / chunkSize;
+  chunkContacts.resize(chunks);
+
+#pragma omp parallel for schedule(dynamic)
+  for (int chunk = 0; chunk < chunks; ++chunk) {
+    std::vector<CircleContact> &out = chunkContacts[chunk];
+    out.clear();
+    const int end = std::min(n, (chunk + 1) * chunkSize);
+
+    for (int k = chunk * chunkSize; k < end; ++k) {
+      const int i = active[k];
+      const size_t first = out.size();
+      const int cx = bodyCell[i] % gridW, cy = bodyCell[i] / gridW;
+
+      for (int ny = std::max(cy - 1, 0); ny <= std::min(cy + 1, gridH - 1);
+           ++ny) {
+        for (int nx = std::max(cx - 1, 0); nx <= std::min(cx + 1, gridW - 1);
+             ++nx) {
+          int nc = ny * gridW + nx;
+          for (int m = cellStart[nc]; m < cellStart[nc + 1]; ++m) {
+            int j = cellBodies[m];
+            // wakeTouched() made sure no sleeping body is in reach
+            if (islands.isSleeping(j) || (j <= i && !islands.isStatic(j)))
+              continue;
+            float dx = x[j] - x[i];
+            float dy = y[j] - y[i];
+            float r = radius[i] + radius[j];
+            float reach = r * margin;
+            float d2 = dx * dx + dy * dy;
+            if (d2 >= reach * reach)
+              continue;
+            float d = std::sqrt(d2);
+            CircleContact c;
+            c.a = std::min(i, j);
+            c.b = std::max(i, j);
+            if (j < i) {
+              dx = -dx;
+              dy = -dy;
+            }
+            if (d > 1e-9f) {
+              c.nx = dx / d;
+              c.ny = dy / d;
+            } else {
+              c.nx = 0.0f;
+              c.ny = 1.0f;
+            }
+            c.depth = r - d;
+            out.push_back(c);
+          }
+        }
+      }
+      // only a handful per body, so this is cheap
+      std::sort(out.begin() + first, out.end(),
+                [](const CircleContact &l, const CircleContact &r) {
+                  return l.b < r.b;
+                });
+
+      // Walls are static bodies -1 (left), -2 (right), -3 (floor) and
+      // -4 (ceiling), added in key order.
+      auto wall = [&](int id, float nx, float ny, float depth) {
+        CircleContact c;
+        c.a = i;
+        c.b = -1 - id;
+        c.nx = nx;
+        c.ny = ny;
+        c.depth = depth;
+        out.push_back(c);
+      };
+      float r = radius[i];
+      float reach = r * margin;
+      if (y[i] + reach > p.maxY)
+        wall(3, 0.0f, 1.0f, (y[i] + r) - p.maxY);
+      if (y[i] - reach < p.minY)
+        wall(2, 0.0f, -1.0f, p.minY - (y[i] - r));
+      if (x[i] + reach > p.maxX)
+        wall(1, 1.0f, 0.0f, (x[i] + r) - p.maxX);
+      if (x[i] - reach < p.minX)
+        wall(0, -1.0f, 0.0f, p.minX - (x[i] - r));
+    }
+  }
+
+  found.clear();
+  for (const std::vector<CircleContact> &chunk : chunkContacts)
+    found.insert(found.end(), chunk.begin(), chunk.end());
+}
+
+void CircleWorld::prepareContacts() {
+  std::vector<CircleContact> &cs = manager.contacts();
+  const int count = int(cs.size());
+
+#pragma omp parallel for schedule(static)
+  for (int k = 0; k < count; ++k) {
+    CircleContact &c = cs[k];
+    const int a = c.a, b = c.b;
+    float imb = 0.0f, iib = 0.0f, rb = 0.0f, vbx = 0.0f, vby = 0.0f;
+    if (b >= 0) {
+      imb = invMass[b];
+      iib = invInertia[b];
+      rb = radius[b];
+      vbx = vx[b];
+      vby = vy[b];
+    }
+    float ra = radius[a];
+
+    // The contact arms are parallel to the normal, so rotation only enters
+    // the tangent direction.
+    float kn = invMass[a] + imb;
+    float kt = kn + invInertia[a] * ra * ra + iib * rb * rb;
+    c.normalMass = kn > 0.0f ? 1.0f / kn : 0.0f;
+    c.tangentMass = kt > 0.0f ? 1.0f / kt : 0.0f;
+    c.approachSpeed = (vbx - vx[a]) * c.nx + (vby - vy[a]) * c.ny;
+  }
+
+  // Static bodies are left out of the colouring, so one batch may hold
+  // many contacts against the same one; the solve never writes to them.
+  colorConstraints(
+      cs.size(), size(),
+      [&](size_t k) {
+        const CircleContact &c = cs[k];
+        int a = invMass[c.a] > 0.0f ? c.a : -1;
+        int b = c.b >= 0 && invMass[c.b] > 0.0f ? c.b : -1;
+        return std::make_pair(a, b);
+      },
+      batches);
+}
+
+void CircleWorld::warmStart() {
+  std::vector<CircleContact> &cs = manager.contacts();
+
+  // Every body appears at most once per batch, so batches can apply their
+  // impulses in parallel.
+#pragma omp parallel
+  forEachBatched(batches, [&](int k) {
+    const CircleContact &c = cs[k];
+    float tx = -c.ny, ty = c.nx;
+    float px = c.nx * c.normalImpulse + tx * c.tangentImpulse;
+    float py = c.ny * c.normalImpulse + ty * c.tangentImpulse;
+    if (invMass[c.a] > 0.0f) {
+      vx[c.a] -= invMass[c.a] * px;
+      vy[c.a] -= invMass[c.a] * py;
+      w[c.a] -= invInertia[c.a] * radius[c.a] * c.tangentImpulse;
+    }
+    if (c.b >= 0 && invMass[c.b] > 0.0f) {
+      vx[c.b] += invMass[c.b] * px;
+      vy[c.b] += invMass[c.b] * py;
+      w[c.b] -= invInertia[c.b] * radius[c.b] * c.tangentImpulse;
+    }
+  });
+}
+
+void CircleWorld::solveContact(CircleContact &c, float h, bool useBias,
+                               const Softness &soft) {
+  const int a = c.a, b = c.b;
+  const float nx = c.nx, ny = c.ny;
+  const float tx = -ny, ty = nx;
+  const float ra = radius[a], ima = invMass[a], iia = invInertia[a];
+  const CircleWorldParams &p = params;
+
+  float rb = 0.0f, imb = 0.0f, iib = 0.0f;
+  float vbx = 0.0f, vby = 0.0f, wb = 0.0f;
+  float separation;
+  if (b >= 0) {
+    rb = radius[b];
+    imb = invMass[b];
+    iib = invInertia[b];
+    vbx = vx[b];
+    vby = vy[b];
+    wb = w[b];
+    separation = (x[b] - x[a]) * nx + (y[b] - y[a]) * ny - ra - rb;
+  } else {
+    // walls sit at these distances along their outward normals
+    float wallPos[4] = {-p.minX, p.maxX, -p.minY, p.maxY};
+    separation = wallPos[-1 - b] - (x[a] * nx + y[a] * ny) - ra;
+  }
+  float vax = vx[a], vay = vy[a], wa = w[a];
+
+  // Non-penetration first. A gap only limits how fast the pair may close
+  // this substep; overlap is pushed out through the soft spring while
+  // biasing, and left alone in the relax pass.
+  float bias = 0.0f, massScale = 1.0f, impulseScale = 0.0f;
+  if (separation > 0.0f) {
+    bias = separation / h;
+  } else if (useBias) {
+    bias = std::max(soft.biasRate * separation, -p.maxPushout);
+    massScale = soft.massScale;
+    impulseScale = soft.impulseScale;
+  }
+
+  float vn = (vbx - vax) * nx + (vby - vay) * ny;
+  float jn = -c.normalMass * massScale * (vn + bias) -
+             impulseScale * c.normalImpulse;
+  float oldN = c.normalImpulse;
+  c.normalImpulse = std::max(oldN + jn, 0.0f);
+  jn = c.normalImpulse - oldN;
+
+  vax -= ima * nx * jn;
+  vay -= ima * ny * jn;
+  vbx += imb * nx * jn;
+  vby += imb * ny * jn;
+
+  // then friction, limited by the normal impulse
+  // contact point velocities: v + w x r, with r = ra n on a and -rb n on b
+  float vt = (vbx - vax) * tx + (vby - vay) * ty - wb * rb - wa * ra;
+  float jt = -vt * c.tangentMass;
+  float maxFriction = p.friction * c.normalImpulse;
+  float oldT = c.tangentImpulse;
+  c.tangentImpulse = std::clamp(oldT + jt, -maxFriction, maxFriction);
+  jt = c.tangentImpulse - oldT;
+
+  if (ima > 0.0f) {
+    vx[a] = vax - ima * tx * jt;
+    vy[a] = vay - ima * ty * jt;
+    w[a] = wa - iia * ra * jt;
+  }
+  if (b >= 0 && imb > 0.0f) {
+    vx[b] = vbx + imb * tx * jt;
+    vy[b] = vby + imb * ty * jt;
+    w[b] = wb - iib * rb * jt;
+  }
+}
+
+void CircleWorld::solveContacts(float h, bool useBias) {
+  std::vector<CircleContact> &cs = manager.contacts();
+
+  // Overlap is treated as a mass-spring-damper; these turn its frequency and
+  // damping ratio into the implicit-step coefficients for this substep.
+  // Springs stiffer than a quarter of the substep rate go unstable.
+  Softness soft;
+  float hertz = std::min(params.contactHertz, 0.25f / h);
+  float omega = 2.0f * 3.14159265359f * hertz;
+  float a1 = 2.0f * params.contactDampingRatio + h * omega;
+  float a2 = h * omega * a1;
+  float a3 = 1.0f / (1.0f + a2);
+  soft.biasRate = omega / a1;
+  soft.massScale = a2 * a3;
+  soft.impulseScale = a3;
+
+#pragma omp parallel
+  forEachBatched(batches,
+                 [&](int k) { solveContact(cs[k], h, useBias, soft); });
+}
+
+void CircleWorld::applyRestitution() {
+  std::vector<CircleContact> &cs = manager.contacts();
+  const float e = params.restitution;
+  const float threshold = params.restitutionThreshold;
+  if (e == 0.0f)
+    return;
+
+  // Bounce contacts that were closing fast at the start of the step, aiming
+  // for -e times that speed now the solve has stopped them.
+#pragma omp parallel
+  forEachBatched(batches, [&](int k) {
+    CircleContact &c = cs[k];
+    if (c.approachSpeed > -threshold || c.normalImpulse == 0.0f)
+      return;
+    const int a = c.a, b = c.b;
+    float imb = b >= 0 ? invMass[b] : 0.0f;
+    float vbx = b >= 0 ? vx[b] : 0.0f;
+    float vby = b >= 0 ? vy[b] : 0.0f;
+    float vn = (vbx - vx[a]) * c.nx + (vby - vy[a]) * c.ny;
+    float jn = -c.normalMass * (vn + e * c.approachSpeed);
+    float oldN = c.normalImpulse;
+    c.normalImpulse = std::max(oldN + jn, 0.0f);
+    jn = c.normalImpulse - oldN;
+    if (invMass[a] > 0.0f) {
+      vx[a] -= invMass[a] * c.nx * jn;
+      vy[a] -= invMass[a] * c.ny * jn;
+    }
+    if (imb > 0.0f) {
+      vx[b] += imb * c.nx * jn;
+      vy[b] += imb * c.ny * jn;
+    }
+  });
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ccd.h"
+#include "coloring.h"
+#include "contacts.h"
+#include "islands.h"
+
+// Settings for a CircleWorld. Units are the normalised screen units circle.cpp
+// draws in, so the visible area is roughly [-aspect, aspect] x [-1, 1].
+struct CircleWorldParams {
+  float gravityX = 0.0f;
+  float gravityY = -1.0f;
+
+  // walls of the box the circles live in
+  float minX = -1.7f;
+  float maxX = 1.7f;
+  float minY = -1.0f;
+  float maxY = 1.0f;
+
+  float fixedDt = 1.0f / 60.0f;
+  int maxSubSteps = 4; // frames slower than this drop time
+
+  // Each fixed step is solved in this many substeps, with one solver pass and
+  // one relax pass per substep. Substepping converges much faster on deep
+  // piles than extra iterations on a full step.
+  int solverSubSteps = 4;
+
+  float friction = 0.4f;
+  float restitution = 0.2f;
+  float restitutionThreshold = 0.05f; // slower impacts don't bounce
+
+  // Overlap is pushed out by a stiff, heavily damped spring rather than a
+  // hard position fix, so the correction can't pump energy into a pile.
+  float contactHertz = 60.0f; // capped at a quarter of the substep rate
+  float contactDampingRatio = 10.0f;
+  float maxPushout = 0.5f; // fastest overlap is pushed out, units/s
+
+  // contacts are created this far before circles touch (as a fraction of
+  // the pair's radius sum) so piles settle without first sinking into
+  // each other
+  float speculativeMargin = 0.1f;
+
+  // Circles moving further in a step than their speculative margin can skip
+  // past a contact entirely. Those are swept against the circles and walls
+  // along their path and stopped at the first impact.
+  bool continuous = true;
+
+  // resting islands stop being integrated and solved until touched
+  SleepSettings sleep;
+};
+
+// A fast circle stopped short of tunnelling during the last step. other is
+// the circle it hit, or -1 - wall index for a wall (as in CircleContact), and
+// toi how far through the step it got.
+struct CircleImpact {
+  int body, other;
+  float toi;
+};
+
+// A 2D rigid circle engine. Bodies are stored as structure-of-arrays so the
+// integrate and contact loops stream through memory, and pairs are found with
+// a uniform grid whose cells are a little over one circle diameter wide.
+// Contacts persist between steps in a ContactManager and are solved with
+// warm-started sequential impulses (soft contacts, friction, restitution)
+// over a few substeps. Contacts are coloured so that each colour can be
+// solved in parallel. Touching circles that have all come to rest fall
+// asleep as an island and cost nothing until something touches them.
+class CircleWorld {
+public:
+  explicit CircleWorld(const CircleWorldParams &params = CircleWorldParams());
+
+  // Returns the index of the new circle. Indices stay stable for the lifetime
+  // of the world.
+  int addCircle(float x, float y, float vx, float vy, float radius,
+                float density = 1.0f);
+  size_t size() const { return x.size(); }
+  void clear();
+
+  // Call after changing a circle's state by hand so a sleeping one moves.
+  void wake(int i);
+  bool isAwake(int i) const { return islands.isAwake(i); }
+  size_t awakeCount() { return islands.awakeBodies().size(); }
+
+  // Runs as many fixed steps as frameTime covers (up to maxSubSteps) and
+  // returns how many were taken. Leftover time carries into the next call.
+  int update(float frameTime);
+  void step();
+
+  CircleWorldParams params;
+
+  // per circle state
+  std::vector<float> x, y;
+  std::vector<float> vx, vy;
+  std::vector<float> w; // angular velocity
+  std::vector<float> radius;
+  std::vector<float> invMass;
+  std::vector<float> invInertia;
+
+  const std::vector<CircleContact> &contacts() const {
+    return manager.contacts();
+  }
+  const ContactManager &contactManager() const { return manager; }
+
+  // continuous impacts found during the last step, in body order
+  const std::vector<CircleImpact> &impacts() const { return impactList; }
+
+private:
+  // implicit spring coefficients for pushing out overlap in one substep
+  struct Softness {
+    float biasRate, massScale, impulseScale;
+  };
+
+  void integrateVelocities(float h);
+  void integratePositions(float h);
+  void updateSleep(float dt);
+  void buildGrid();
+  void wakeTouched();
+  void findContacts();
+  void prepareContacts();
+  void warmStart();
+  void solveContact(CircleContact &c, float h, bool useBias,
+                    const Softness &soft);
+  void solveContacts(float h, bool useBias);
+  void applyRestitution();
+  void solveContinuous();
+  int cellOf(float px, float py) const;
+
+  float accumulator = 0.0f;
+  float maxRadius = 0.0f;
+
+  // uniform grid, rebuilt every step with a counting sort
+  float cellSize = 0.0f;
+  int gridW = 0, gridH = 0;
+  std::vector<int> cellStart; // gridW * gridH + 1 offsets into cellBodies
+  std::vector<int> cellBodies;
+  std::vector<int> bodyCell;
+
+  std::vector<std::vector<CircleContact>> chunkContacts;
+  std::vector<CircleContact> found;
+  ContactManager manager;
+  ConstraintBatches batches;
+  SleepIslands islands;
+
+  // positions at the start of the step, for the continuous sweep
+  std::vector<float> startX, startY;
+  std::vector<CircleImpact> impactList;
+};
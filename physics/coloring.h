@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Constraints split into batches where no two constraints in the same batch
+// touch the same body, so each batch can be solved in parallel without locks.
+// Batch k holds order[start[k]] .. order[start[k + 1] - 1].
+struct ConstraintBatches {
+  std::vector<int> order;
+  std::vector<int> start;
+  // Index of a batch that ran out of colours and must be solved serially, or
+  // -1 when every batch is independent.
+  int serialBatch = -1;
+
+  int count() const { return start.empty() ? 0 : int(start.size()) - 1; }
+};
+
+// Greedy colouring over at most 64 colours. pairOf(i) returns the two body
+// indices of constraint i; negative indices are static (walls, pinned points)
+// and never conflict. Constraints that find no free colour spill into the
+// serial batch.
+template <typename PairOf>
+void colorConstraints(size_t count, size_t bodyCount, PairOf pairOf,
+                      ConstraintBatches &out) {
+  constexpr int maxColors = 64;
+  std::vector<uint64_t> used(bodyCount, 0);
+  std::vector<int8_t> color(count);
+  int counts[maxColors + 1] = {};
+
+  for (size_t i = 0; i < count; ++i) {
+    std::pair<int, int> p = pairOf(i);
+    uint64_t mask = 0;
+    if (p.first >= 0)
+      mask |= used[p.first];
+    if (p.second >= 0)
+      mask |= used[p.second];
+
+    int c = maxColors; // spill
+    if (~mask != 0) {
+      c = __builtin_ctzll(~mask);
+      uint64_t bit = uint64_t(1) << c;
+      if (p.first >= 0)
+        used[p.first] |= bit;
+      if (p.second >= 0)
+        used[p.second] |= bit;
+    }
+    color[i] = int8_t(c);
+    ++counts[c];
+  }
+
+  // drop empty colours and lay the batches out back to back
+  int remap[maxColors + 1];
+  out.start.assign(1, 0);
+  out.serialBatch = -1;
+  for (int c = 0; c <= maxColors; ++c) {
+    remap[c] = -1;
+    if (counts[c] == 0)
+      continue;
+    remap[c] = int(out.start.size()) - 1;
+    if (c == maxColors)
+      out.serialBatch = remap[c];
+    out.start.push_back(out.start.back() + counts[c]);
+  }
+
+  out.order.resize(count);
+  std::vector<int> fill(out.start.begin(), out.start.end() - 1);
+  for (size_t i = 0; i < count; ++i)
+    out.order[fill[remap[color[i]]]++] = int(i);
+}
+
+// Calls fn(constraint) for every constraint, batch after batch. Meant to be
+// called from inside an OpenMP parallel region: each batch is shared out
+// across the threads and the serial batch runs on one of them. Outside a
+// parallel region it simply runs everything in batch order.
+template <typename Fn>
+void forEachBatched(const ConstraintBatches &batches, Fn fn) {
+  for (int k = 0; k < batches.count(); ++k) {
+    const int begin = batches.start[k], end = batches.start[k + 1];
+    if (k == batches.serialBatch) {
+#pragma omp single
+      for (int i = begin; i < end; ++i)
+        fn(batches.order[i]);
+    } else {
+#pragma omp for schedule(static)
+      for (int i = begin; i < end; ++i)
+        fn(batches.order[i]);
+    }
+  }
+}
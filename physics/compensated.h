@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cmath>
+
+#include "simd.h"
+
+// Sums of many small float terms that keep most of the precision a double
+// would. A plain float sum of thousands of forces loses the low bits of
+// every term smaller than the running total; these carry the lost part
+// along instead. T is float or a Floatx8 / Floatx16 packet, so they work
+// lane by lane inside SIMD kernels. The same types keep integrator state:
+// a float position held as a Summed and moved with add(v * dt) doesn't
+// lose small steps against a large coordinate (see floatbodies.h). None of
+// them survive -ffast-math, which is free to cancel the correction terms.
+enum class FloatSum {
+  Plain,      // sum += x
+  Kahan,      // one correction term, subtracted before each add
+  Neumaier,   // Kahan that also holds up when a term outweighs the sum
+  FloatFloat, // an unevaluated hi + lo pair, about 48 bits of mantissa
+};
+
+// The default for the float kernels, set by the CPPHYSICS_FLOAT_SUM
+// CMake option.
+#if defined(CPPHYSICS_FLOAT_SUM_KAHAN)
+inline constexpr FloatSum defaultFloatSum = FloatSum::Kahan;
+#elif defined(CPPHYSICS_FLOAT_SUM_NEUMAIER)
+inline constexpr FloatSum defaultFloatSum = FloatSum::Neumaier;
+#elif defined(CPPHYSICS_FLOAT_SUM_FLOATFLOAT)
+inline constexpr FloatSum defaultFloatSum = FloatSum::FloatFloat;
+#else
+inline constexpr FloatSum defaultFloatSum = FloatSum::Plain;
+#endif
+
+inline const char *floatSumName(FloatSum sum) {
+  switch (sum) {
+  case FloatSum::Kahan:
+    return "kahan";
+  case FloatSum::Neumaier:
+    return "neumaier";
+  case FloatSum::FloatFloat:
+    return "float-float";
+  case FloatSum::Plain:
+    break;
+  }
+  return "plain";
+}
+
+inline float absoluteValue(float v) { return std::fabs(v); }
+
+// packets: clear the sign bits, which stays in vector registers where a
+// compare and select may not
+template <typename T> inline T absoluteValue(T v) {
+  typedef int Bits __attribute__((vector_size(sizeof(T))));
+  return (T)((Bits)v & 0x7fffffff);
+}
+
+// Each keeps two words at most. split() gives them as the sum rounded to T
+// and the part that rounding misses, and from() takes them back, so a sum
+// can live in a pair of arrays between adds, as integrator state does.
+template <FloatSum S, typename T> struct Summed;
+
+template <typename T> struct Summed<FloatSum::Plain, T> {
+  T sum{};
+  void add(T x) { sum += x; }
+  T value() const { return sum; }
+  void split(T &v, T &rest) const { v = sum, rest = T{}; }
+  static Summed from(T v, T) { return {v}; }
+};
+
+template <typename T> struct Summed<FloatSum::Kahan, T> {
+  T sum{}, carry{};
+  void add(T x) {
+    T y = x - carry;
+    T t = sum + y;
+    carry = (t - sum) - y;
+    sum = t;
+  }
+  T value() const { return sum; }
+  // the carry is what the next add takes off, so the sum is short by it
+  void split(T &v, T &rest) const { v = sum, rest = -carry; }
+  static Summed from(T v, T rest) { return {v, -rest}; }
+};
+
+template <typename T> struct Summed<FloatSum::Neumaier, T> {
+  T sum{}, carry{};
+  void add(T x) {
+    T t = sum + x;
+    carry += select(absoluteValue(sum) >= absoluteValue(x), (sum - t) + x,
+                    (x - t) + sum);
+    sum = t;
+  }
+  T value() const { return sum + carry; }
+  void split(T &v, T &rest) const {
+    // the carry can outgrow an ulp of the sum; fold it in first
+    v = sum + carry;
+    rest = carry - (v - sum);
+  }
+  static Summed from(T v, T rest) { return {v, rest}; }
+};
+
+template <typename T> struct Summed<FloatSum::FloatFloat, T> {
+  T hi{}, lo{};
+  void add(T x) {
+    // Knuth's two-sum gives hi + x exactly as s + e; fold in lo and
+    // renormalise so lo stays below half an ulp of hi
+    T s = hi + x;
+    T b = s - hi;
+    T e = (hi - (s - b)) + (x - b) + lo;
+    hi = s + e;
+    lo = e - (hi - s);
+  }
+  T value() const { return hi; }
+  void split(T &v, T &rest) const { v = hi, rest = lo; }
+  static Summed from(T v, T rest) { return {v, rest}; }
+};
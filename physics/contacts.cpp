@@ -0,0 +1,52 @@
+#include "contacts.h"
+
+#include <algorithm>
+
+void ContactManager::update(std::vector<CircleContact> &fresh) {
+  auto byKey = [](const CircleContact &l, const CircleContact &r) {
+    return l.key() < r.key();
+  };
+  // narrowphases that already emit in key order skip the sort
+  if (!std::is_sorted(fresh.begin(), fresh.end(), byKey))
+    std::sort(fresh.begin(), fresh.end(), byKey);
+
+  // both lists are sorted by key, so matching is a single merge walk
+  previous.swap(current);
+  current.swap(fresh);
+  fresh.clear();
+
+  matched = 0;
+  size_t j = 0;
+  for (CircleContact &c : current) {
+    uint64_t k = c.key();
+    while (j < previous.size() && previous[j].key() < k)
+      ++j;
+    if (j < previous.size() && previous[j].key() == k) {
+      c.normalImpulse = previous[j].normalImpulse;
+      c.tangentImpulse = previous[j].tangentImpulse;
+      ++matched;
+    } else {
+      c.normalImpulse = 0.0f;
+      c.tangentImpulse = 0.0f;
+    }
+  }
+}
+
+void ContactManager::clear() {
+  current.clear();
+  previous.clear();
+  parked.clear();
+  matched = 0;
+}
+
+void ContactManager::mergeSorted(std::vector<CircleContact> &into,
+                                 const std::vector<CircleContact> &from) {
+  if (from.empty())
+    return;
+  size_t mid = into.size();
+  into.insert(into.end(), from.begin(), from.end());
+  std::inplace_merge(into.begin(), into.begin() + mid, into.end(),
+                     [](const CircleContact &l, const CircleContact &r) {
+                       return l.key() < r.key();
+                     });
+}
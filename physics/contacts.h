@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One contact point between circle a and circle b, or between circle a and a
+// wall when b is negative (-1 - wall index). The normal points from a to b.
+struct CircleContact {
+  int a, b;
+  float nx, ny;
+  float depth;
+
+  // accumulated impulses, carried between steps for warm starting
+  float normalImpulse = 0.0f;
+  float tangentImpulse = 0.0f;
+
+  // solver scratch, filled in each step
+  float normalMass = 0.0f;
+  float tangentMass = 0.0f;
+  float approachSpeed = 0.0f; // normal velocity before solving, for bounce
+
+  uint64_t key() const {
+    return (uint64_t(uint32_t(a)) << 32) | uint64_t(uint32_t(b));
+  }
+};
+
+// Keeps the contact set alive across steps. Each step the narrowphase hands
+// over the pairs it found and any pair that was already touching last step
+// gets its accumulated impulses back, so the solver starts close to the
+// answer instead of from zero.
+class ContactManager {
+public:
+  // Takes ownership of the new contacts (the vector is left empty). Contacts
+  // end up sorted by key, which also makes the solve order independent of how
+  // the narrowphase was threaded.
+  void update(std::vector<CircleContact> &fresh);
+  void clear();
+
+  std::vector<CircleContact> &contacts() { return current; }
+  const std::vector<CircleContact> &contacts() const { return current; }
+
+  // how many of this step's contacts existed last step
+  size_t persisted() const { return matched; }
+
+  // Moves contacts whose bodies are all asleep out of the live set (walls
+  // count as asleep), keeping their impulses until the island wakes.
+  template <typename IsAsleep> void park(IsAsleep asleep) {
+    auto live = std::stable_partition(
+        current.begin(), current.end(), [&](const CircleContact &c) {
+          return !(asleep(c.a) && (c.b < 0 || asleep(c.b)));
+        });
+    std::vector<CircleContact> moved(live, current.end());
+    current.erase(live, current.end());
+    mergeSorted(parked, moved);
+  }
+
+  // Brings parked contacts that touch an awake body back, so the next
+  // update() can warm start from them.
+  template <typename IsAsleep> void unpark(IsAsleep asleep) {
+    auto still = std::stable_partition(
+        parked.begin(), parked.end(), [&](const CircleContact &c) {
+          return asleep(c.a) && (c.b < 0 || asleep(c.b));
+        });
+    std::vector<CircleContact> moved(still, parked.end());
+    parked.erase(still, parked.end());
+    mergeSorted(current, moved);
+  }
+
+  size_t parkedCount() const { return parked.size(); }
+
+private:
+  static void mergeSorted(std::vector<CircleContact> &into,
+                          const std::vector<CircleContact> &from);
+
+  std::vector<CircleContact> current;
+  std::vector<CircleContact> previous;
+  std::vector<CircleContact> parked; // sorted by key
+  size_t matched = 0;
+};
@@ -0,0 +1,188 @@
+#include "cpphysics.h"
+
+#include <algorithm>
+#include <limits>
+#include <new>
+
+#include "nbody.h"
+
+struct cpphysics_nbody {
+  NBodySystem system;
+};
+
+namespace {
+
+// Runs f, turning any exception into the C API's -1.
+template <typename F> int guarded(F &&f) {
+  try {
+    f();
+    return 0;
+  } catch (...) {
+    return -1;
+  }
+}
+
+void copyIn(const double *xyz, BigVector<double> &x, BigVector<double> &y,
+            BigVector<double> &z) {
+  for (size_t i = 0; i < x.size(); ++i) {
+    x[i] = xyz[3 * i];
+    y[i] = xyz[3 * i + 1];
+    z[i] = xyz[3 * i + 2];
+  }
+}
+
+void copyOut(const BigVector<double> &x, const BigVector<double> &y,
+             const BigVector<double> &z, double *xyz) {
+  for (size_t i = 0; i < x.size(); ++i) {
+    xyz[3 * i] = x[i];
+    xyz[3 * i + 1] = y[i];
+    xyz[3 * i + 2] = z[i];
+  }
+}
+
+} // namespace
+
+extern "C" {
+
+void cpphysics_nbody_default_params(cpphysics_nbody_params *params) {
+  if (!params)
+    return;
+  NBodyParams defaults;
+  params->G = defaults.G;
+  params->softening = defaults.softening;
+  params->solver = CPPHYSICS_SOLVER_AUTO;
+  params->theta = defaults.theta;
+  params->integrator = CPPHYSICS_LEAPFROG;
+}
+
+cpphysics_nbody *cpphysics_nbody_create(const cpphysics_nbody_params *params,
+                                        size_t count) {
+  cpphysics_nbody_params p;
+  cpphysics_nbody_default_params(&p);
+  if (params)
+    p = *params;
+
+  NBodyParams np;
+  np.G = p.G;
+  np.softening = p.softening;
+  np.theta = p.theta;
+  np.solver = p.solver == CPPHYSICS_SOLVER_DIRECT ? GravitySolver::Direct
+              : p.solver == CPPHYSICS_SOLVER_TREE ? GravitySolver::Tree
+                                                  : GravitySolver::Auto;
+  np.integrator =
+      p.integrator == CPPHYSICS_EULER ? Integrator::Euler : Integrator::Leapfrog;
+
+  cpphysics_nbody *nbody = new (std::nothrow) cpphysics_nbody{NBodySystem(np)};
+  if (nbody && cpphysics_nbody_resize(nbody, count) != 0) {
+    delete nbody;
+    return nullptr;
+  }
+  return nbody;
+}
+
+void cpphysics_nbody_destroy(cpphysics_nbody *nbody) { delete nbody; }
+
+int cpphysics_nbody_resize(cpphysics_nbody *nbody, size_t count) {
+  if (!nbody)
+    return -1;
+  return guarded([&] {
+    NBodySystem &s = nbody->system;
+    BodyStore &b = s.bodies;
+    for (auto *v : {&b.x, &b.y, &b.z, &b.vx, &b.vy, &b.vz, &b.mass, &b.radius,
+                    &s.ax, &s.ay, &s.az})
+      v->resize(count, 0.0);
+  });
+}
+
+size_t cpphysics_nbody_count(const cpphysics_nbody *nbody) {
+  return nbody ? nbody->system.size() : 0;
+}
+
+int cpphysics_nbody_get_arrays(cpphysics_nbody *nbody,
+                               cpphysics_nbody_arrays *arrays) {
+  if (!nbody || !arrays)
+    return -1;
+  NBodySystem &s = nbody->system;
+  BodyStore &b = s.bodies;
+  arrays->count = b.size();
+  arrays->x = b.x.data();
+  arrays->y = b.y.data();
+  arrays->z = b.z.data();
+  arrays->vx = b.vx.data();
+  arrays->vy = b.vy.data();
+  arrays->vz = b.vz.data();
+  arrays->mass = b.mass.data();
+  arrays->ax = s.ax.data();
+  arrays->ay = s.ay.data();
+  arrays->az = s.az.data();
+  return 0;
+}
+
+int cpphysics_nbody_set_positions(cpphysics_nbody *nbody, const double *xyz,
+                                  size_t count) {
+  if (!nbody || (!xyz && count) || count != nbody->system.size())
+    return -1;
+  BodyStore &b = nbody->system.bodies;
+  copyIn(xyz, b.x, b.y, b.z);
+  return 0;
+}
+
+int cpphysics_nbody_get_positions(const cpphysics_nbody *nbody, double *xyz,
+                                  size_t count) {
+  if (!nbody || (!xyz && count) || count != nbody->system.size())
+    return -1;
+  const BodyStore &b = nbody->system.bodies;
+  copyOut(b.x, b.y, b.z, xyz);
+  return 0;
+}
+
+int cpphysics_nbody_set_velocities(cpphysics_nbody *nbody, const double *xyz,
+                                   size_t count) {
+  if (!nbody || (!xyz && count) || count != nbody->system.size())
+    return -1;
+  BodyStore &b = nbody->system.bodies;
+  copyIn(xyz, b.vx, b.vy, b.vz);
+  return 0;
+}
+
+int cpphysics_nbody_get_velocities(const cpphysics_nbody *nbody, double *xyz,
+                                   size_t count) {
+  if (!nbody || (!xyz && count) || count != nbody->system.size())
+    return -1;
+  const BodyStore &b = nbody->system.bodies;
+  copyOut(b.vx, b.vy, b.vz, xyz);
+  return 0;
+}
+
+int cpphysics_nbody_set_masses(cpphysics_nbody *nbody, const double *mass,
+                               size_t count) {
+  if (!nbody || (!mass && count) || count != nbody->system.size())
+    return -1;
+  std::copy(mass, mass + count, nbody->system.bodies.mass.begin());
+  return 0;
+}
+
+int cpphysics_nbody_step(cpphysics_nbody *nbody, double dt, int steps) {
+  if (!nbody)
+    return -1;
+  return guarded([&] {
+    for (int i = 0; i < steps; ++i)
+      nbody->system.step(dt);
+  });
+}
+
+double cpphysics_nbody_time(const cpphysics_nbody *nbody) {
+  return nbody ? nbody->system.time : 0.0;
+}
+
+double cpphysics_nbody_energy(const cpphysics_nbody *nbody) {
+  if (!nbody)
+    return 0.0;
+  // energy() allocates and may start the executor's threads, so it can
+  // throw like the guarded calls; a double has no -1 to spare
+  double energy = std::numeric_limits<double>::quiet_NaN();
+  guarded([&] { energy = nbody->system.energy(); });
+  return energy;
+}
+
+} // extern "C"
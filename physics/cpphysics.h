@@ -0,0 +1,90 @@
+#ifndef CPPHYSICS_H
+#define CPPHYSICS_H
+
+/* C interface to the N-body core (physics/nbody.h) for embedding the
+ * simulator from C and from other languages' foreign function interfaces.
+ *
+ * Everything goes through an opaque cpphysics_nbody handle. Functions that
+ * can fail return 0 on success and -1 on failure (a null handle, a size
+ * mismatch or running out of memory); nothing throws across this boundary.
+ *
+ * State lives in structure-of-arrays form inside the handle, and
+ * cpphysics_nbody_get_arrays() hands out pointers straight into those
+ * arrays so callers can read (and write) bodies without copying. The
+ * pointers stay valid until the body count changes (cpphysics_nbody_resize)
+ * or the handle is destroyed; stepping never moves them. The bulk set/get
+ * functions copy to and from interleaved x, y, z triples instead. */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cpphysics_nbody cpphysics_nbody;
+
+enum {
+  CPPHYSICS_SOLVER_AUTO = 0,
+  CPPHYSICS_SOLVER_DIRECT = 1,
+  CPPHYSICS_SOLVER_TREE = 2
+};
+
+enum { CPPHYSICS_EULER = 0, CPPHYSICS_LEAPFROG = 1 };
+
+typedef struct cpphysics_nbody_params {
+  double G;
+  double softening;
+  int solver;     /* CPPHYSICS_SOLVER_* */
+  double theta;   /* tree opening angle */
+  int integrator; /* CPPHYSICS_EULER or CPPHYSICS_LEAPFROG */
+} cpphysics_nbody_params;
+
+/* Direct pointers into a handle's arrays, count entries each. Positions,
+ * velocities and masses may be written through; accelerations are those
+ * of the last step (zero before the first one). */
+typedef struct cpphysics_nbody_arrays {
+  size_t count;
+  double *x, *y, *z;
+  double *vx, *vy, *vz;
+  double *mass;
+  const double *ax, *ay, *az;
+} cpphysics_nbody_arrays;
+
+/* SI G, no softening, automatic solver, theta 0.5, leapfrog */
+void cpphysics_nbody_default_params(cpphysics_nbody_params *params);
+
+/* params may be null for the defaults. Returns null on failure. */
+cpphysics_nbody *cpphysics_nbody_create(const cpphysics_nbody_params *params,
+                                        size_t count);
+void cpphysics_nbody_destroy(cpphysics_nbody *nbody);
+
+/* New bodies start at rest at the origin with zero mass. Invalidates
+ * pointers from cpphysics_nbody_get_arrays. */
+int cpphysics_nbody_resize(cpphysics_nbody *nbody, size_t count);
+size_t cpphysics_nbody_count(const cpphysics_nbody *nbody);
+
+int cpphysics_nbody_get_arrays(cpphysics_nbody *nbody,
+                               cpphysics_nbody_arrays *arrays);
+
+/* Bulk copies; xyz holds count interleaved triples, count must match. */
+int cpphysics_nbody_set_positions(cpphysics_nbody *nbody, const double *xyz,
+                                  size_t count);
+int cpphysics_nbody_get_positions(const cpphysics_nbody *nbody, double *xyz,
+                                  size_t count);
+int cpphysics_nbody_set_velocities(cpphysics_nbody *nbody, const double *xyz,
+                                   size_t count);
+int cpphysics_nbody_get_velocities(const cpphysics_nbody *nbody, double *xyz,
+                                   size_t count);
+int cpphysics_nbody_set_masses(cpphysics_nbody *nbody, const double *mass,
+                               size_t count);
+
+int cpphysics_nbody_step(cpphysics_nbody *nbody, double dt, int steps);
+double cpphysics_nbody_time(const cpphysics_nbody *nbody);
+/* kinetic plus potential, O(n^2); NaN if it could not be computed */
+double cpphysics_nbody_energy(const cpphysics_nbody *nbody);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
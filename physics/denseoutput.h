@@ -0,0 +1,55 @@
+#pragma once
+
+#include "fewbody.h"
+
+// Positions and velocities anywhere inside one integrator step, from the
+// states at its two ends. Each coordinate follows the cubic Hermite curve
+// through both ends' positions and velocities, which is third order
+// accurate, so the in-between state costs a few multiply-adds instead of
+// another step or more force evaluations.
+
+// The cubic through (x0, v0) at tau = 0 and (x1, v1) at tau = 1 for a step
+// of h, at tau in [0, 1]; velocity is its derivative in time.
+inline double hermitePosition(double x0, double v0, double x1, double v1,
+                              double h, double tau) {
+  const double t2 = tau * tau, t3 = t2 * tau;
+  return (2.0 * t3 - 3.0 * t2 + 1.0) * x0 + (t3 - 2.0 * t2 + tau) * h * v0 +
+         (3.0 * t2 - 2.0 * t3) * x1 + (t3 - t2) * h * v1;
+}
+
+inline double hermiteVelocity(double x0, double v0, double x1, double v1,
+                              double h, double tau) {
+  const double t2 = tau * tau;
+  return 6.0 * (tau - t2) * (x1 - x0) / h + (3.0 * t2 - 4.0 * tau + 1.0) * v0 +
+         (3.0 * t2 - 2.0 * tau) * v1;
+}
+
+// One step of a few-body run, from start at time t0 to end at t0 + h.
+template <int N> struct DenseStep {
+  FewBodyState<N> start, end;
+  double t0 = 0.0, h = 0.0;
+
+  // body i at fraction tau of the step
+  void body(int i, double tau, double p[3], double v[3]) const {
+    const double *x0[3] = {&start.x[i], &start.y[i], &start.z[i]};
+    const double *v0[3] = {&start.vx[i], &start.vy[i], &start.vz[i]};
+    const double *x1[3] = {&end.x[i], &end.y[i], &end.z[i]};
+    const double *v1[3] = {&end.vx[i], &end.vy[i], &end.vz[i]};
+    for (int k = 0; k < 3; ++k) {
+      p[k] = hermitePosition(*x0[k], *v0[k], *x1[k], *v1[k], h, tau);
+      v[k] = hermiteVelocity(*x0[k], *v0[k], *x1[k], *v1[k], h, tau);
+    }
+  }
+
+  // every body at fraction tau of the step
+  FewBodyState<N> at(double tau) const {
+    FewBodyState<N> s = start;
+    for (int i = 0; i < N; ++i) {
+      double p[3], v[3];
+      body(i, tau, p, v);
+      s.x[i] = p[0], s.y[i] = p[1], s.z[i] = p[2];
+      s.vx[i] = v[0], s.vy[i] = v[1], s.vz[i] = v[2];
+    }
+    return s;
+  }
+};
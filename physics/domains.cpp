@@ -0,0 +1,655 @@
+#include "domains.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <new>
+#include <type_traits>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "gravity.h"
+#include "numa.h"
+
+#ifdef __linux__
+
+namespace {
+
+constexpr int maxProcesses = 64;
+
+// The header of the shared segment; the arrays follow it.
+struct Shared {
+  pthread_barrier_t barrier;
+  // at a report step rank 0 posts ready, and everyone waits until the
+  // caller has read the bodies and posts resume
+  sem_t ready, resume;
+  size_t begin[maxProcesses + 1]; // process p owns begin[p] .. begin[p + 1]
+  size_t firstGroup[maxProcesses];
+  size_t groupCount[maxProcesses];
+  DomainStats stats[maxProcesses];
+  double recentSeconds[maxProcesses]; // since the last rebalance
+};
+
+struct Segment {
+  Shared *header = nullptr;
+  void *memory = nullptr;
+  size_t bytes = 0;
+  size_t n = 0, groupCapacity = 0;
+
+  double *x, *y, *z, *vx, *vy, *vz, *m, *ax, *ay, *az;
+  int64_t *id;
+  // published groups: centre of mass, mass, radius, first body and count,
+  // and the first body's key along the curve when the groups were cut
+  double *gx, *gy, *gz, *gm, *gr;
+  size_t *gBegin, *gCount;
+  uint64_t *gKey;
+
+  bool create(size_t bodies, int processes, int groupSize) {
+    n = bodies;
+    groupCapacity = 4 * (n / size_t(groupSize) + size_t(processes) + 1);
+    bytes = sizeof(Shared) + 10 * n * sizeof(double) + n * sizeof(int64_t) +
+            groupCapacity * (5 * sizeof(double) + 2 * sizeof(size_t) +
+                             sizeof(uint64_t));
+    memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+      memory = nullptr;
+      return false;
+    }
+    header = new (memory) Shared();
+    char *p = static_cast<char *>(memory) + sizeof(Shared);
+    auto carve = [&](auto *&array, size_t count) {
+      array = reinterpret_cast<std::remove_reference_t<decltype(array)>>(p);
+      p += count * sizeof(*array);
+    };
+    for (double **a : {&x, &y, &z, &vx, &vy, &vz, &m, &ax, &ay, &az})
+      carve(*a, n);
+    carve(id, n);
+    for (double **a : {&gx, &gy, &gz, &gm, &gr})
+      carve(*a, groupCapacity);
+    carve(gBegin, groupCapacity);
+    carve(gCount, groupCapacity);
+    carve(gKey, groupCapacity);
+
+    pthread_barrierattr_t attr;
+    pthread_barrierattr_init(&attr);
+    pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    bool ok = pthread_barrier_init(&header->barrier, &attr,
+                                   unsigned(processes)) == 0;
+    pthread_barrierattr_destroy(&attr);
+    return ok && sem_init(&header->ready, 1, 0) == 0 &&
+           sem_init(&header->resume, 1, 0) == 0;
+  }
+
+  ~Segment() {
+    if (memory) {
+      sem_destroy(&header->ready);
+      sem_destroy(&header->resume);
+      pthread_barrier_destroy(&header->barrier);
+      munmap(memory, bytes);
+    }
+  }
+};
+
+// Splits the bodies first .. last - 1, sorted by key, into groups of at
+// most size along the curve's cubes, shift being the lowest key bit of the
+// cube they share: a cube with too many bodies is split into its eighths,
+// and neighbouring eighths small enough are merged, so a group never
+// spreads past the cube around it.
+void splitCube(const std::vector<uint64_t> &key, size_t first, size_t last,
+               int shift, size_t size, std::vector<size_t> &starts) {
+  if (last - first <= size || shift <= 0) {
+    starts.push_back(first);
+    return;
+  }
+  const int below = shift - 3;
+  size_t run = first; // bodies run .. b - 1 wait for a group
+  for (size_t b = first; b < last;) {
+    size_t e = b + 1;
+    while (e < last && key[e] >> below == key[b] >> below)
+      ++e;
+    if (e - b > size) {
+      if (run < b)
+        starts.push_back(run);
+      splitCube(key, b, e, below, size, starts);
+      run = e;
+    } else if (e - run > size) {
+      starts.push_back(run);
+      run = b;
+    }
+    b = e;
+  }
+  if (run < last)
+    starts.push_back(run);
+}
+
+// Re-sorts every body along the curve and cuts the runs so each process
+// gets an equal share of the work, weighing each body by its process's
+// recent force time per body; then splits each run into its groups.
+void rebalance(Segment &s, int processes, int groupSize) {
+  Shared &h = *s.header;
+  std::vector<double> weight(s.n, 1.0);
+  for (int p = 0; p < processes; ++p) {
+    size_t count = h.begin[p + 1] - h.begin[p];
+    if (count && h.recentSeconds[p] > 0.0)
+      std::fill(weight.begin() + h.begin[p], weight.begin() + h.begin[p + 1],
+                h.recentSeconds[p] / count);
+    h.recentSeconds[p] = 0.0;
+  }
+
+  std::vector<uint64_t> key = spatialKeys(s.n, s.x, s.y, s.z);
+  std::vector<int> order(s.n);
+  for (size_t i = 0; i < s.n; ++i)
+    order[i] = int(i);
+  std::sort(order.begin(), order.end(),
+            [&](int a, int b) { return key[a] < key[b]; });
+  std::vector<double> sorted(s.n);
+  for (double *a : {s.x, s.y, s.z, s.vx, s.vy, s.vz, s.m, s.ax, s.ay, s.az}) {
+    for (size_t i = 0; i < s.n; ++i)
+      sorted[i] = a[order[i]];
+    std::copy(sorted.begin(), sorted.end(), a);
+  }
+  std::vector<int64_t> ids(s.n);
+  std::vector<uint64_t> keys(s.n);
+  for (size_t i = 0; i < s.n; ++i) {
+    ids[i] = s.id[order[i]];
+    keys[i] = key[order[i]];
+    sorted[i] = weight[order[i]];
+  }
+  std::copy(ids.begin(), ids.end(), s.id);
+
+  double total = 0.0;
+  for (double w : sorted)
+    total += w;
+  double sum = 0.0;
+  int p = 1;
+  h.begin[0] = 0;
+  for (size_t i = 0; i < s.n && p < processes; ++i) {
+    sum += sorted[i];
+    while (p < processes && sum >= total * p / processes)
+      h.begin[p++] = i + 1;
+  }
+  while (p <= processes)
+    h.begin[p++] = s.n;
+
+  // each process's groups in its own stretch of the group arrays, four
+  // slots per groupSize bodies; merging keeps most groups well over a
+  // quarter full, and any past the stretch go into its last group
+  const size_t size = size_t(groupSize);
+  std::vector<size_t> starts;
+  for (p = 0; p < processes; ++p) {
+    const size_t first = 4 * (h.begin[p] / size + size_t(p));
+    const size_t room = 4 * (h.begin[p + 1] / size + size_t(p) + 1) - first;
+    starts.clear();
+    if (h.begin[p] < h.begin[p + 1])
+      splitCube(keys, h.begin[p], h.begin[p + 1], 63, size, starts);
+    const size_t count = std::min(starts.size(), room);
+    for (size_t k = 0; k < count; ++k) {
+      s.gBegin[first + k] = starts[k];
+      s.gKey[first + k] = keys[starts[k]];
+      s.gCount[first + k] =
+          (k + 1 < count ? starts[k + 1] : h.begin[p + 1]) - starts[k];
+    }
+    h.firstGroup[p] = first;
+    h.groupCount[p] = count;
+  }
+}
+
+class Domain {
+public:
+  Domain(Segment &s, const DomainParams &params, int rank)
+      : s(s), h(*s.header), params(params), rank(rank) {}
+
+  void run(double dt, int steps) {
+    publishGroups();
+    wait();
+    computeForces();
+    wait();
+    for (int step = 1; step <= steps; ++step) {
+      kick(0.5 * dt);
+      drift(dt);
+      publishGroups();
+      wait();
+      computeForces();
+      wait();
+      kick(0.5 * dt);
+      // the forces move with their bodies, so the next kick needs no new
+      // force pass
+      if (params.rebalanceEvery > 0 && step % params.rebalanceEvery == 0 &&
+          step < steps) {
+        wait();
+        if (rank == 0)
+          rebalance(s, params.processes, params.groupSize);
+        wait();
+      }
+      if (params.reportEvery > 0 &&
+          (step % params.reportEvery == 0 || step == steps)) {
+        wait();
+        if (rank == 0) {
+          sem_post(&h.ready);
+          while (sem_wait(&h.resume) != 0 && errno == EINTR)
+            ;
+        }
+        wait();
+      }
+    }
+  }
+
+private:
+  struct Cell {
+    double x, y, z, m, r;
+    size_t group;          // for a leaf, the published group
+    size_t firstChild = 0; // into children
+    size_t childCount = 0; // 0 for a leaf
+  };
+
+  struct Box {
+    double lo[3], hi[3];
+  };
+
+  void wait() { pthread_barrier_wait(&h.barrier); }
+  size_t begin() const { return h.begin[rank]; }
+  size_t end() const { return h.begin[rank + 1]; }
+
+  void kick(double dt) {
+    for (size_t i = begin(); i < end(); ++i) {
+      s.vx[i] += s.ax[i] * dt;
+      s.vy[i] += s.ay[i] * dt;
+      s.vz[i] += s.az[i] * dt;
+    }
+  }
+
+  void drift(double dt) {
+    for (size_t i = begin(); i < end(); ++i) {
+      s.x[i] += s.vx[i] * dt;
+      s.y[i] += s.vy[i] * dt;
+      s.z[i] += s.vz[i] * dt;
+    }
+  }
+
+  // the groups rebalance() cut from the owned bodies, with where their
+  // bodies are now
+  void publishGroups() {
+    const size_t first = h.firstGroup[rank];
+    for (size_t g = first; g < first + h.groupCount[rank]; ++g) {
+      const size_t b = s.gBegin[g], e = b + s.gCount[g];
+      double mass = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+      for (size_t i = b; i < e; ++i) {
+        mass += s.m[i];
+        cx += s.m[i] * s.x[i];
+        cy += s.m[i] * s.y[i];
+        cz += s.m[i] * s.z[i];
+      }
+      if (mass > 0.0) {
+        cx /= mass;
+        cy /= mass;
+        cz /= mass;
+      } else {
+        cx = s.x[b], cy = s.y[b], cz = s.z[b];
+      }
+      double r2 = 0.0;
+      for (size_t i = b; i < e; ++i) {
+        double dx = s.x[i] - cx, dy = s.y[i] - cy, dz = s.z[i] - cz;
+        r2 = std::max(r2, dx * dx + dy * dy + dz * dz);
+      }
+      s.gx[g] = cx;
+      s.gy[g] = cy;
+      s.gz[g] = cz;
+      s.gm[g] = mass;
+      s.gr[g] = std::sqrt(r2);
+    }
+  }
+
+  // Everyone else's groups as the leaves of one octree per process, cut
+  // along the curve's cubes like the groups themselves.
+  void buildCells() {
+    cells.clear();
+    children.clear();
+    roots.clear();
+    for (int p = 0; p < params.processes; ++p) {
+      if (p == rank || h.groupCount[p] == 0)
+        continue;
+      const size_t first = h.firstGroup[p];
+      roots.push_back(buildCell(first, first + h.groupCount[p], 63));
+    }
+  }
+
+  // The cell over groups a .. b - 1, whose first keys share all bits from
+  // shift up. Returns its index in cells.
+  size_t buildCell(size_t a, size_t b, int shift) {
+    if (b - a == 1) {
+      cells.push_back({s.gx[a], s.gy[a], s.gz[a], s.gm[a], s.gr[a], a});
+      return cells.size() - 1;
+    }
+    // down to the first cube the groups don't all share, then one child
+    // per eighth of it that holds any
+    auto eighth = [&](size_t g) { return s.gKey[g] >> (shift - 3); };
+    while (shift > 0 && eighth(a) == eighth(b - 1))
+      shift -= 3;
+    std::vector<size_t> below;
+    for (size_t g = a; g < b;) {
+      size_t e = g + 1;
+      while (shift > 0 && e < b && eighth(e) == eighth(g))
+        ++e;
+      below.push_back(buildCell(g, e, shift - 3));
+      g = e;
+    }
+
+    Cell cell{0.0, 0.0, 0.0, 0.0, 0.0, 0, children.size(), below.size()};
+    for (size_t k : below) {
+      const Cell &c = cells[k];
+      cell.m += c.m;
+      cell.x += c.m * c.x;
+      cell.y += c.m * c.y;
+      cell.z += c.m * c.z;
+    }
+    if (cell.m > 0.0) {
+      cell.x /= cell.m;
+      cell.y /= cell.m;
+      cell.z /= cell.m;
+    } else {
+      cell.x = cells[below[0]].x;
+      cell.y = cells[below[0]].y;
+      cell.z = cells[below[0]].z;
+    }
+    for (size_t k : below) {
+      const Cell &c = cells[k];
+      double dx = c.x - cell.x, dy = c.y - cell.y, dz = c.z - cell.z;
+      cell.r = std::max(cell.r, std::sqrt(dx * dx + dy * dy + dz * dz) + c.r);
+    }
+    children.insert(children.end(), below.begin(), below.end());
+    cells.push_back(cell);
+    return cells.size() - 1;
+  }
+
+  // whether c's radius looks smaller than theta radians from every point of
+  // box, the same test as GravityTree's with the radius for the edge
+  bool far(const Cell &c, const Box &box) const {
+    double dx = std::max({box.lo[0] - c.x, 0.0, c.x - box.hi[0]});
+    double dy = std::max({box.lo[1] - c.y, 0.0, c.y - box.hi[1]});
+    double dz = std::max({box.lo[2] - c.z, 0.0, c.z - box.hi[2]});
+    return c.r * c.r <
+           params.theta * params.theta * (dx * dx + dy * dy + dz * dz);
+  }
+
+  // Everyone else's cells, walked from coarse to fine for the own bodies
+  // inside box: cells far from the box go on the list as one multipole,
+  // groups that aren't as their bodies.
+  void interactionList(const Box &box) {
+    lx.clear();
+    ly.clear();
+    lz.clear();
+    lm.clear();
+    stack.assign(roots.begin(), roots.end());
+    while (!stack.empty()) {
+      const Cell &c = cells[stack.back()];
+      stack.pop_back();
+      if (far(c, box)) {
+        lx.push_back(c.x);
+        ly.push_back(c.y);
+        lz.push_back(c.z);
+        lm.push_back(c.m);
+        ++multipoles;
+      } else if (c.childCount > 0) {
+        stack.insert(stack.end(), children.begin() + c.firstChild,
+                     children.begin() + c.firstChild + c.childCount);
+      } else {
+        const size_t b = s.gBegin[c.group], e = b + s.gCount[c.group];
+        lx.insert(lx.end(), s.x + b, s.x + e);
+        ly.insert(ly.end(), s.y + b, s.y + e);
+        lz.insert(lz.end(), s.z + b, s.z + e);
+        lm.insert(lm.end(), s.m + b, s.m + e);
+        if (!imported[c.group]) {
+          imported[c.group] = 1;
+          ghosts += e - b;
+        }
+      }
+    }
+  }
+
+  void computeForces() {
+    auto start = std::chrono::steady_clock::now();
+    const size_t own = end() - begin();
+    if (own == 0)
+      return;
+
+    // own bodies on each other, through a tree of just them; forked from a
+    // process that may have OpenMP threads, so stay serial
+    tree.build(own, s.x + begin(), s.y + begin(), s.z + begin(),
+               s.m + begin());
+    tree.accelerations(params.G, params.softening, params.theta,
+                       s.ax + begin(), s.ay + begin(), s.az + begin(),
+                       Executor(Backend::Serial));
+
+    // then everyone else, group by own group: each group's list is good
+    // for all of its bodies and only its bodies
+    buildCells();
+    imported.assign(s.groupCapacity, 0);
+    ghosts = multipoles = interactions = 0;
+    const double eps2 = params.softening * params.softening;
+    const size_t first = h.firstGroup[rank];
+    for (size_t g = first; g < first + h.groupCount[rank]; ++g) {
+      const size_t b = s.gBegin[g], e = b + s.gCount[g];
+      Box box{{s.x[b], s.y[b], s.z[b]}, {s.x[b], s.y[b], s.z[b]}};
+      for (size_t i = b + 1; i < e; ++i) {
+        box.lo[0] = std::min(box.lo[0], s.x[i]);
+        box.lo[1] = std::min(box.lo[1], s.y[i]);
+        box.lo[2] = std::min(box.lo[2], s.z[i]);
+        box.hi[0] = std::max(box.hi[0], s.x[i]);
+        box.hi[1] = std::max(box.hi[1], s.y[i]);
+        box.hi[2] = std::max(box.hi[2], s.z[i]);
+      }
+      interactionList(box);
+
+      const size_t count = lx.size();
+      interactions += count * (e - b);
+      const double *px = lx.data(), *py = ly.data(), *pz = lz.data(),
+                   *pm = lm.data();
+      for (size_t i = b; i < e; ++i) {
+        const double xi = s.x[i], yi = s.y[i], zi = s.z[i];
+        double sx = 0.0, sy = 0.0, sz = 0.0;
+#pragma omp simd reduction(+ : sx, sy, sz)
+        for (size_t j = 0; j < count; ++j) {
+          double dx = px[j] - xi, dy = py[j] - yi, dz = pz[j] - zi;
+          double r2 = dx * dx + dy * dy + dz * dz + eps2;
+          double inv = r2 > 0.0 ? 1.0 / std::sqrt(r2) : 0.0;
+          double f = pm[j] * inv * inv * inv;
+          sx += dx * f;
+          sy += dy * f;
+          sz += dz * f;
+        }
+        s.ax[i] += params.G * sx;
+        s.ay[i] += params.G * sy;
+        s.az[i] += params.G * sz;
+      }
+    }
+
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    DomainStats &stats = h.stats[rank];
+    stats.ghosts = ghosts;
+    stats.multipoles = multipoles;
+    stats.interactions = interactions;
+    stats.forceSeconds += seconds;
+    h.recentSeconds[rank] += seconds;
+  }
+
+  Segment &s;
+  Shared &h;
+  const DomainParams &params;
+  const int rank;
+
+  GravityTree tree;
+  // everyone else's octrees, children before their parents
+  std::vector<Cell> cells;
+  std::vector<size_t> children, roots, stack; // indices into cells
+  std::vector<char> imported; // per group, whether its bodies are ghosts
+  size_t ghosts = 0, multipoles = 0, interactions = 0;
+  std::vector<double> lx, ly, lz, lm; // the current own group's list
+};
+
+// The bodies back in the caller's order.
+void gather(const Segment &s, BodyStore &bodies) {
+  for (size_t i = 0; i < s.n; ++i) {
+    const size_t k = size_t(s.id[i]);
+    bodies.x[k] = s.x[i];
+    bodies.y[k] = s.y[i];
+    bodies.z[k] = s.z[i];
+    bodies.vx[k] = s.vx[i];
+    bodies.vy[k] = s.vy[i];
+    bodies.vz[k] = s.vz[i];
+  }
+}
+
+// Waits for rank 0 to reach a report step. False if a process exits first,
+// which leaves the others stuck at a barrier; it is dropped from children.
+bool awaitReport(Shared &h, std::vector<pid_t> &children) {
+  for (;;) {
+    timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec += 50000000;
+    if (until.tv_nsec >= 1000000000) {
+      until.tv_nsec -= 1000000000;
+      ++until.tv_sec;
+    }
+    if (sem_timedwait(&h.ready, &until) == 0)
+      return true;
+    if (errno != ETIMEDOUT && errno != EINTR)
+      return false;
+    int status = 0;
+    pid_t pid = waitpid(-1, &status, WNOHANG);
+    if (pid > 0) {
+      children.erase(std::find(children.begin(), children.end(), pid));
+      return false;
+    }
+  }
+}
+
+} // namespace
+
+bool runDomains(BodyStore &bodies, const DomainParams &params, double dt,
+                int steps, std::vector<DomainStats> *stats,
+                const std::function<void(int step)> &report) {
+  const size_t n = bodies.size();
+  const int processes = std::clamp(params.processes, 1, maxProcesses);
+  DomainParams p = params;
+  p.processes = processes;
+  p.groupSize = std::max(params.groupSize, 1);
+  if (!report)
+    p.reportEvery = 0;
+
+  Segment s;
+  if (!s.create(n, processes, p.groupSize))
+    return false;
+  // processes spread over nodes as the thread pool spreads its threads;
+  // each node's processes get their first cut's share of the arrays in its
+  // memory before anything touches them (later cuts move a little, and
+  // pages that change hands stay where they are)
+  const NumaTopology &topology = NumaTopology::get();
+  const int nodes = p.numa ? std::min(topology.nodes(), processes) : 1;
+  std::vector<int> first;
+  for (int k = 0; k <= nodes; ++k)
+    first.push_back(processes * k / nodes);
+  for (double *a : {s.x, s.y, s.z, s.vx, s.vy, s.vz, s.m, s.ax, s.ay, s.az})
+    placeOnNodes(a, n, sizeof(double), first);
+  placeOnNodes(s.id, n, sizeof(int64_t), first);
+
+  const BodyStore &b = bodies;
+  std::copy(b.x.begin(), b.x.end(), s.x);
+  std::copy(b.y.begin(), b.y.end(), s.y);
+  std::copy(b.z.begin(), b.z.end(), s.z);
+  std::copy(b.vx.begin(), b.vx.end(), s.vx);
+  std::copy(b.vy.begin(), b.vy.end(), s.vy);
+  std::copy(b.vz.begin(), b.vz.end(), s.vz);
+  std::copy(b.mass.begin(), b.mass.end(), s.m);
+  for (size_t i = 0; i < n; ++i)
+    s.id[i] = int64_t(i);
+  // the first cut, with every body weighing the same
+  s.header->begin[processes] = n;
+  rebalance(s, processes, p.groupSize);
+
+  // or whatever is buffered would be written again by rank 0's report
+  std::fflush(stdout);
+  std::fflush(stderr);
+  std::vector<pid_t> children;
+  bool ok = true;
+  for (int rank = 0; rank < processes && ok; ++rank) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      if (p.numa) {
+        const int node = int(std::upper_bound(first.begin(), first.end(),
+                                              rank) -
+                             first.begin()) -
+                         1;
+        const std::vector<int> &cpus = topology.cpus[node];
+        pinThread(cpus[(rank - first[node]) % cpus.size()]);
+      }
+      Domain(s, p, rank).run(dt, steps);
+      _exit(0);
+    }
+    if (pid < 0)
+      ok = false;
+    else
+      children.push_back(pid);
+  }
+
+  // the processes stay up for the whole run, with rank 0 stopping them all
+  // at every report step while the caller looks at the bodies
+  for (int step = 1; ok && p.reportEvery > 0 && step <= steps; ++step) {
+    if (step % p.reportEvery != 0 && step != steps)
+      continue;
+    ok = awaitReport(*s.header, children);
+    if (ok) {
+      gather(s, bodies);
+      report(step);
+      sem_post(&s.header->resume);
+    }
+  }
+
+  if (!ok) {
+    // the others would wait at the barrier forever
+    for (pid_t child : children)
+      kill(child, SIGKILL);
+  }
+  for (size_t left = children.size(); left > 0; --left) {
+    int status = 0;
+    if (wait(&status) < 0)
+      break;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      ok = false;
+      for (pid_t child : children)
+        kill(child, SIGKILL);
+    }
+  }
+  if (!ok)
+    return false;
+
+  gather(s, bodies);
+  if (stats) {
+    stats->assign(s.header->stats, s.header->stats + processes);
+    for (int r = 0; r < processes; ++r)
+      (*stats)[r].bodies = s.header->begin[r + 1] - s.header->begin[r];
+  }
+  return true;
+}
+
+#else
+
+bool runDomains(BodyStore &, const DomainParams &, double, int,
+                std::vector<DomainStats> *, const std::function<void(int)> &) {
+  return false;
+}
+
+#endif
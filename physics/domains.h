@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "nbody.h"
+
+// Gravity split over several processes on one machine, to spread a run's
+// force work over cores and, with numa, each process's share of the bodies
+// over the NUMA nodes its process runs on. The bodies are sorted along a
+// space-filling curve and cut into one contiguous run, a compact region of
+// space, per process. Bodies live in a shared memory segment; each process
+// owns and writes only its run.
+//
+// This does not make room for bigger runs: the segment holds every body
+// (about 90 bytes each) and every process maps all of it, next to the
+// caller's BodyStore, so a run needs about twice its bodies' memory on one
+// machine. What numa buys is that each process's own bodies, which it reads
+// and writes every step, sit in its node's memory, and that the process
+// stays on that node's CPUs; ghosts are still read across nodes.
+//
+// Each process's bodies are cut into groups of at most groupSize along the
+// curve's cubes, and every step it publishes each group's centre of mass,
+// mass and radius. Each other process stacks those groups into an octree
+// and, for each of its own groups, walks it from coarse to fine: a cell
+// whose radius looks smaller than theta radians from the group is one
+// multipole (a point mass), a group that doesn't is imported body by body
+// as ghosts. The group's bodies, and only they, sum that list, and own
+// bodies act on each other through a tree, so a process's force work is
+// about its share of a one-process tree's. Processes meet at a barrier
+// after publishing and again before moving on.
+//
+// Every rebalanceEvery steps the bodies are re-sorted, the cuts moved so
+// each process gets the same share of measured force time, not of bodies,
+// and the groups cut again.
+struct DomainParams {
+  int processes = 4;
+  double G = 1.0;
+  double softening = 0.01;
+  double theta = 0.5;
+  int groupSize = 16;
+  int rebalanceEvery = 10;
+  int reportEvery = 0; // steps between calls to runDomains' report
+  bool numa = false;   // pin processes and place their bodies node by node
+};
+
+struct DomainStats {
+  size_t bodies = 0;       // owned at the end of the run
+  size_t ghosts = 0;       // other processes' bodies imported, last step
+  size_t multipoles = 0;   // cells used, over own groups, last step
+  size_t interactions = 0; // others' bodies and cells, over own bodies
+  double forceSeconds = 0; // summed over the run
+};
+
+// Steps bodies steps times by dt (kick-drift-kick leapfrog) in
+// params.processes forked processes and writes the result back in the
+// original order. The processes last the whole run: every
+// params.reportEvery steps, and after the last, they all wait while bodies
+// is brought up to date and report is called with the step reached.
+// Per-process stats go to stats if given. False if the shared segment or a
+// process could not be set up, or a process failed; the bodies are then as
+// of the last report.
+bool runDomains(BodyStore &bodies, const DomainParams &params, double dt,
+                int steps, std::vector<DomainStats> *stats = nullptr,
+                const std::function<void(int step)> &report = {});
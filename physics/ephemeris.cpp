@@ -0,0 +1,187 @@
+#include "ephemeris.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "denseoutput.h"
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+const char magic[8] = "CPHEPH1";
+
+// sum c[k] T_k(s) by Clenshaw's recurrence
+double chebyshev(const double *c, size_t terms, double s) {
+  double b1 = 0.0, b2 = 0.0;
+  for (size_t k = terms; k-- > 1;) {
+    double b0 = 2.0 * s * b1 - b2 + c[k];
+    b2 = b1;
+    b1 = b0;
+  }
+  return s * b1 - b2 + c[0];
+}
+
+// its derivative in s, from T_k' = k U_(k-1)
+double chebyshevSlope(const double *c, size_t terms, double s) {
+  double b1 = 0.0, b2 = 0.0;
+  for (size_t k = terms; k-- > 1;) {
+    double b0 = 2.0 * s * b1 - b2 + double(k) * c[k];
+    b2 = b1;
+    b1 = b0;
+  }
+  return b1;
+}
+
+} // namespace
+
+bool EphemerisWriter::open(const std::string &path, const BodyStore &bodies,
+                           double t, const EphemerisParams &p) {
+  params = p;
+  params.degree = std::max(params.degree, 1);
+  n = bodies.size();
+  start = last = t;
+  written = 0;
+  nextNode = 0;
+
+  // Chebyshev-Gauss nodes, in increasing time; none falls on an interval's
+  // ends
+  const int count = params.degree + 1;
+  nodes.resize(count);
+  for (int j = 0; j < count; ++j)
+    nodes[j] = -std::cos(kPi * (j + 0.5) / count);
+  samples.assign(n * 3 * count, 0.0);
+  record.resize(n * 3 * count);
+  previous.resize(n * 6);
+  for (size_t i = 0; i < n; ++i) {
+    const double state[6] = {bodies.x[i],  bodies.y[i],  bodies.z[i],
+                             bodies.vx[i], bodies.vy[i], bodies.vz[i]};
+    std::copy(state, state + 6, previous.begin() + i * 6);
+  }
+
+  file.open(path, std::ios::binary | std::ios::trunc);
+  EphemerisHeader header;
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.bodies = uint32_t(n);
+  header.degree = uint32_t(params.degree);
+  header.start = start;
+  header.interval = params.interval;
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  return bool(file);
+}
+
+bool EphemerisWriter::add(const BodyStore &bodies, double t) {
+  if (!file || bodies.size() != n || t <= last)
+    return bool(file);
+  const int count = params.degree + 1;
+  const double h = t - last;
+  for (;;) {
+    const double t0 = start + double(written) * params.interval;
+    // the nodes this step reaches, each from the step's Hermite curve
+    while (nextNode < count) {
+      const double node =
+          t0 + 0.5 * params.interval * (nodes[nextNode] + 1.0);
+      if (node > t)
+        break;
+      const double tau = (node - last) / h;
+      for (size_t i = 0; i < n; ++i) {
+        const double *p = &previous[i * 6];
+        const double end[6] = {bodies.x[i],  bodies.y[i],  bodies.z[i],
+                               bodies.vx[i], bodies.vy[i], bodies.vz[i]};
+        for (int c = 0; c < 3; ++c)
+          samples[(i * 3 + c) * count + nextNode] =
+              hermitePosition(p[c], p[c + 3], end[c], end[c + 3], h, tau);
+      }
+      ++nextNode;
+    }
+    if (nextNode < count || t < t0 + params.interval)
+      break;
+    fit();
+    ++written;
+    nextNode = 0;
+  }
+
+  last = t;
+  for (size_t i = 0; i < n; ++i) {
+    const double state[6] = {bodies.x[i],  bodies.y[i],  bodies.z[i],
+                             bodies.vx[i], bodies.vy[i], bodies.vz[i]};
+    std::copy(state, state + 6, previous.begin() + i * 6);
+  }
+  return bool(file);
+}
+
+void EphemerisWriter::fit() {
+  // interpolation at the Chebyshev-Gauss nodes:
+  // c_k = (2 - [k = 0]) / count * sum_j f_j T_k(s_j), T_k(s_j) = cos(k a_j)
+  const int count = params.degree + 1;
+  for (size_t series = 0; series < n * 3; ++series) {
+    const double *f = &samples[series * count];
+    double *c = &record[series * count];
+    for (int k = 0; k < count; ++k) {
+      double sum = 0.0;
+      for (int j = 0; j < count; ++j) {
+        // the nodes run backwards in angle: s_j = -cos(a_j) = cos(pi - a_j)
+        double angle = kPi - kPi * (j + 0.5) / count;
+        sum += f[j] * std::cos(k * angle);
+      }
+      c[k] = (k == 0 ? 1.0 : 2.0) / count * sum;
+    }
+  }
+  file.write(reinterpret_cast<const char *>(record.data()),
+             std::streamsize(record.size() * sizeof(double)));
+}
+
+bool EphemerisWriter::close() {
+  if (!file.is_open())
+    return false;
+  file.close();
+  return !file.fail();
+}
+
+bool Ephemeris::load(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  EphemerisHeader header;
+  if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      std::memcmp(header.magic, magic, sizeof(magic)) != 0 ||
+      header.degree == 0 || !(header.interval > 0.0))
+    return false;
+  in.seekg(0, std::ios::end);
+  const size_t bytes = size_t(in.tellg()) - sizeof(header);
+  const size_t perRecord =
+      size_t(header.bodies) * 3 * (header.degree + 1) * sizeof(double);
+  if (perRecord == 0 || bytes == 0 || bytes % perRecord != 0)
+    return false;
+
+  n = header.bodies;
+  terms = header.degree + 1;
+  count = bytes / perRecord;
+  first = header.start;
+  length = header.interval;
+  coefficients.resize(bytes / sizeof(double));
+  in.seekg(sizeof(header));
+  return bool(in.read(reinterpret_cast<char *>(coefficients.data()),
+                      std::streamsize(bytes)));
+}
+
+const double *Ephemeris::series(size_t body, double t, double &s) const {
+  double offset = (t - first) / length;
+  size_t r = offset <= 0.0 ? 0 : std::min(size_t(offset), count - 1);
+  s = 2.0 * (offset - double(r)) - 1.0;
+  return &coefficients[(r * n + body) * 3 * terms];
+}
+
+void Ephemeris::position(size_t body, double t, double p[3]) const {
+  double s;
+  const double *c = series(body, t, s);
+  for (int k = 0; k < 3; ++k)
+    p[k] = chebyshev(c + k * terms, terms, s);
+}
+
+void Ephemeris::velocity(size_t body, double t, double v[3]) const {
+  double s;
+  const double *c = series(body, t, s);
+  // ds/dt = 2 / length
+  for (int k = 0; k < 3; ++k)
+    v[k] = chebyshevSlope(c + k * terms, terms, s) * 2.0 / length;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "nbody.h"
+
+// Body positions at any time of a run without keeping every step, the way
+// JPL ephemerides store planets. Time is cut into fixed intervals; over
+// each, every coordinate of every body is a Chebyshev series of a few
+// terms, fitted through the run's dense output at the interval's Chebyshev
+// nodes. A query finds its interval by division and sums one short series
+// per coordinate.
+//
+// File layout, native byte order: the header below, then one record per
+// interval of bodies * 3 * (degree + 1) doubles, body by body, x then y
+// then z, lowest term first.
+struct EphemerisHeader {
+  char magic[8]; // "CPHEPH1"
+  uint32_t bodies;
+  uint32_t degree;
+  double start;
+  double interval;
+};
+
+struct EphemerisParams {
+  double interval = 0.1; // time per record, several steps long
+  int degree = 10;       // highest Chebyshev term
+};
+
+// Fits and writes records as a run goes. Memory is one interval's node
+// samples, whatever the run's length.
+class EphemerisWriter {
+public:
+  // Starts a file for bodies bodies from start, the run's current time.
+  // False if the file can't be created.
+  bool open(const std::string &path, const BodyStore &bodies, double start,
+            const EphemerisParams &params = EphemerisParams());
+  // The bodies after a step that ended at time t. Each step is treated as
+  // a cubic Hermite curve between its end states (the integrators' dense
+  // output), which gives the positions at the nodes it spans. False once
+  // writing fails.
+  bool add(const BodyStore &bodies, double t);
+  // Writes what is pending; a last, unfinished interval is dropped.
+  bool close();
+  size_t records() const { return written; }
+
+private:
+  void fit();
+
+  std::ofstream file;
+  EphemerisParams params;
+  size_t n = 0;
+  double start = 0.0, last = 0.0;
+  size_t written = 0;
+  int nextNode = 0;
+  std::vector<double> nodes;    // in time, within the current interval
+  std::vector<double> samples;  // body, coordinate, node
+  std::vector<double> previous; // the last step's positions and velocities
+  std::vector<double> record;
+};
+
+// Reads an ephemeris file into memory and answers queries.
+class Ephemeris {
+public:
+  // False if the file is missing, not an ephemeris or cut short.
+  bool load(const std::string &path);
+
+  size_t bodies() const { return n; }
+  double start() const { return first; }
+  double end() const { return first + count * length; }
+
+  // body's position or velocity at t; times outside start() .. end() are
+  // extrapolated from the first or last interval
+  void position(size_t body, double t, double p[3]) const;
+  void velocity(size_t body, double t, double v[3]) const;
+
+private:
+  const double *series(size_t body, double t, double &s) const;
+
+  size_t n = 0, terms = 0, count = 0;
+  double first = 0.0, length = 1.0;
+  std::vector<double> coefficients;
+};
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "denseoutput.h"
+
+// Events in a few-body run, found inside a step rather than at its ends.
+// After every leapfrog step each event's function g of one pair is watched
+// on the step's dense output; where it crosses zero the crossing is pinned
+// down by root finding and the callback sees the state at that exact time.
+// The step stays the same size, and a pass that dips below a distance and
+// back out within one step is still caught, because the pair's closest
+// point inside the step is checked too.
+enum class EventKind {
+  Collision,     // the pair's distance falls to distance (the radius sum)
+  CloseApproach, // the same, for a threshold that isn't contact
+  Pericentre,    // the pair's distance stops shrinking
+  Apocentre,     // the pair's distance stops growing
+};
+
+struct Event {
+  EventKind kind = EventKind::Collision;
+  int i = 0, j = 1; // the pair
+  double distance = 0.0;
+};
+
+// What the callback wants done after an event.
+enum class EventAction {
+  Continue, // nothing changed; look for more events in the same step
+  Restart,  // the callback changed the state; carry on from it
+  Stop,     // end the run at the event
+};
+
+namespace events {
+
+// g for e at fraction tau of step: the squared gap for distances, falling
+// through zero; the radial velocity for turning points
+template <int N>
+double value(const Event &e, const DenseStep<N> &step, double tau) {
+  double pi[3], vi[3], pj[3], vj[3];
+  step.body(e.i, tau, pi, vi);
+  step.body(e.j, tau, pj, vj);
+  double dx = pj[0] - pi[0], dy = pj[1] - pi[1], dz = pj[2] - pi[2];
+  if (e.kind == EventKind::Collision || e.kind == EventKind::CloseApproach)
+    return dx * dx + dy * dy + dz * dz - e.distance * e.distance;
+  return dx * (vj[0] - vi[0]) + dy * (vj[1] - vi[1]) + dz * (vj[2] - vi[2]);
+}
+
+// whether going from ga to gb is the crossing e is about
+inline bool crosses(const Event &e, double ga, double gb) {
+  if (e.kind == EventKind::Pericentre)
+    return ga < 0.0 && gb >= 0.0;
+  return ga > 0.0 && gb <= 0.0;
+}
+
+// A root of g in [a, b] where g(a) and g(b) have opposite signs, by
+// regula falsi with the Illinois fix for one-sided convergence.
+template <typename G>
+double root(G &&g, double a, double b, double ga, double gb) {
+  int side = 0;
+  for (int k = 0; k < 100 && b - a > 1e-15; ++k) {
+    double c = (a * gb - b * ga) / (gb - ga);
+    double gc = g(c);
+    if (gc == 0.0)
+      return c;
+    if ((gc > 0.0) == (ga > 0.0)) {
+      a = c, ga = gc;
+      if (side == -1)
+        gb *= 0.5;
+      side = -1;
+    } else {
+      b = c, gb = gc;
+      if (side == 1)
+        ga *= 0.5;
+      side = 1;
+    }
+  }
+  return gb == ga ? b : (a * gb - b * ga) / (gb - ga);
+}
+
+// The first crossing of e in (from, 1], or a negative number if none. The
+// step is split into samples pieces; a distance that dips and recovers
+// within a piece is caught at the pair's pericentre inside it.
+template <int N>
+double first(const Event &e, const DenseStep<N> &step, double from,
+             int samples) {
+  auto g = [&](double tau) { return value(e, step, tau); };
+  const bool distance =
+      e.kind == EventKind::Collision || e.kind == EventKind::CloseApproach;
+  Event turning = e;
+  turning.kind = EventKind::Pericentre;
+  auto radial = [&](double tau) { return value(turning, step, tau); };
+
+  double a = from, ga = g(a), ra = distance ? radial(a) : 0.0;
+  for (int k = 1; k <= samples; ++k) {
+    double b = from + (1.0 - from) * k / samples;
+    double gb = g(b);
+    if (crosses(e, ga, gb))
+      return root(g, a, b, ga, gb);
+    if (distance) {
+      double rb = radial(b);
+      if (ga > 0.0 && crosses(turning, ra, rb)) {
+        double p = root(radial, a, b, ra, rb);
+        double gp = g(p);
+        if (gp <= 0.0)
+          return root(g, a, p, ga, gp);
+      }
+      ra = rb;
+    }
+    a = b, ga = gb;
+  }
+  return -1.0;
+}
+
+} // namespace events
+
+// Steps s steps times by dt like stepFewBody, advancing t, and calls
+// onEvent(index into list, time, state) at every event in time order;
+// events at the same time come in list order, on the same state, and a
+// Restart from any of them applies once they all have been seen.
+// The state passed is the interpolated one at the event; after Restart the
+// run carries on from it, finishing the step it was in so t stays on the
+// grid of steps. Returns false if a callback stopped the run, with s and t
+// at that event. samples splits each step for the search; more catch
+// faster-changing functions.
+template <int N, typename F>
+bool stepWithEvents(FewBodyState<N> &s, double &t, double G, double eps2,
+                    double dt, long steps, const std::vector<Event> &list,
+                    F &&onEvent, int samples = 4) {
+  samples = samples < 1 ? 1 : samples;
+  // A handled event isn't looked for again until this long after it, so the
+  // crossing it was found at can't be found again, even when a Restart
+  // leaves the state as it was; events this close together count as one
+  // time. Absolute, so every restart makes progress however little is left
+  // of the step.
+  const double window = 1e-9 * dt;
+  std::vector<double> handled(list.size(), -HUGE_VAL), taus(list.size());
+  double from = 0.0;
+  for (long n = 0; n < steps; ++n) {
+    double left = dt; // what remains of this step
+    while (left > 0.0) {
+      DenseStep<N> step;
+      step.start = s;
+      step.end = s;
+      step.t0 = t;
+      step.h = left;
+      stepFewBody(step.end, G, eps2, left);
+
+      bool restarted = false;
+      while (!restarted && from <= 1.0) {
+        // the earliest event still ahead in the step
+        size_t hit = list.size();
+        double when = 2.0;
+        for (size_t k = 0; k < list.size(); ++k) {
+          double start = std::max(from, (handled[k] + window - t) / left);
+          taus[k] = start > 1.0 ? -1.0
+                                : events::first(list[k], step, start, samples);
+          if (taus[k] >= start && taus[k] < when)
+            hit = k, when = taus[k];
+        }
+        if (hit == list.size())
+          break;
+        // it and any others within the window of it, in list order, all
+        // on the same state
+        FewBodyState<N> at = step.at(when);
+        const double time = t + when * left;
+        bool restart = false;
+        for (size_t k = 0; k < list.size(); ++k) {
+          if (taus[k] < when || (taus[k] - when) * left > window)
+            continue;
+          handled[k] = time;
+          EventAction action = onEvent(k, time, at);
+          if (action == EventAction::Stop) {
+            s = at;
+            t = time;
+            return false;
+          }
+          restart = restart || action == EventAction::Restart;
+        }
+        if (!restart) {
+          from = when;
+          continue;
+        }
+        s = at;
+        t = time;
+        left -= when * left;
+        restarted = true;
+        from = 0.0;
+      }
+      if (!restarted) {
+        s = step.end;
+        t += left;
+        left = 0.0;
+        from = 0.0;
+      }
+    }
+  }
+  return true;
+}
@@ -0,0 +1,275 @@
+#include "execution.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "numa.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef CPPHYSICS_PARALLEL_STL
+#include <execution>
+#include <numeric>
+#endif
+
+// Workers that sleep until run() hands them a job, then pull chunk indices
+// from shared counters until none are left. The calling thread pulls too.
+//
+// A NUMA-aware pool pins its workers node by node and cuts every job into
+// one contiguous slice of chunks per node, in proportion to the node's
+// threads. Threads drain their own node's slice first and only then help
+// the others, so a node keeps working on the same bodies (and the same
+// pages) from step to step.
+class ThreadPool {
+public:
+  ThreadPool(int threads, bool numa) {
+    const NumaTopology &topology = NumaTopology::get();
+    const int nodes = numa ? std::min(topology.nodes(), threads) : 1;
+    queues.reset(new Queue[nodes]);
+    for (int k = 0; k <= nodes; ++k)
+      first.push_back(threads * k / nodes);
+    for (int t = 0; t < threads; ++t)
+      nodeOf.push_back(int(std::upper_bound(first.begin(), first.end(), t) -
+                           first.begin()) -
+                       1);
+    stats.resize(nodes);
+    for (int k = 0; k < nodes; ++k)
+      stats[k].threads = first[k + 1] - first[k];
+
+    for (int t = 1; t < threads; ++t) {
+      int cpu = -1;
+      if (numa) {
+        const std::vector<int> &cpus = topology.cpus[nodeOf[t]];
+        cpu = cpus[(t - first[nodeOf[t]]) % cpus.size()];
+      }
+      workers.emplace_back([this, t, cpu] {
+        if (cpu >= 0)
+          pinThread(cpu);
+        work(t);
+      });
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers)
+      worker.join();
+  }
+
+  int size() const { return int(workers.size()) + 1; }
+
+  void run(size_t chunks, void (*call)(void *, size_t), void *context) {
+    // one job at a time; a second caller waits its turn
+    std::lock_guard<std::mutex> job(running);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      jobCall = call;
+      jobContext = context;
+      const size_t threads = size_t(size());
+      for (size_t k = 0; k + 1 < first.size(); ++k) {
+        queues[k].next = chunks * first[k] / threads;
+        queues[k].end = chunks * first[k + 1] / threads;
+      }
+      busy = int(workers.size());
+      ++generation;
+    }
+    wake.notify_all();
+    pull(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return busy == 0; });
+  }
+
+  std::vector<int> first; // first thread of each node, then the count
+  std::vector<NodeStats> stats;
+  std::mutex mutex;
+
+private:
+  struct alignas(64) Queue {
+    std::atomic<size_t> next{0};
+    size_t end = 0;
+  };
+
+  void pull(int thread) {
+    const auto start = std::chrono::steady_clock::now();
+    const int nodes = int(first.size()) - 1;
+    const int own = nodeOf[thread];
+    size_t ran = 0, stolen = 0;
+    for (int i = 0; i < nodes; ++i) {
+      Queue &queue = queues[(own + i) % nodes];
+      for (size_t c; (c = queue.next.fetch_add(1)) < queue.end;) {
+        jobCall(jobContext, c);
+        ++ran;
+        stolen += i > 0;
+      }
+    }
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    std::lock_guard<std::mutex> lock(mutex);
+    stats[own].chunks += ran;
+    stats[own].stolen += stolen;
+    stats[own].busySeconds += seconds;
+  }
+
+  void work(int thread) {
+    unsigned seen = 0;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping)
+          return;
+        seen = generation;
+      }
+      pull(thread);
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--busy == 0)
+        finished.notify_one();
+    }
+  }
+
+  std::vector<std::thread> workers;
+  std::vector<int> nodeOf;
+  std::unique_ptr<Queue[]> queues; // one per node
+  std::mutex running;
+  std::condition_variable wake, finished;
+  bool stopping = false;
+  unsigned generation = 0;
+  int busy = 0;
+
+  void (*jobCall)(void *, size_t) = nullptr;
+  void *jobContext = nullptr;
+};
+
+namespace {
+
+int hardwareThreads() {
+  return int(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+} // namespace
+
+const char *backendName(Backend backend) {
+  switch (backend) {
+  case Backend::Serial:
+    return "serial";
+  case Backend::OpenMP:
+    return "openmp";
+  case Backend::ParallelStl:
+    return "stl";
+  case Backend::ThreadPool:
+    return "pool";
+  }
+  return "?";
+}
+
+bool parseBackend(const char *name, Backend &backend) {
+  for (Backend b : {Backend::Serial, Backend::OpenMP, Backend::ParallelStl,
+                    Backend::ThreadPool}) {
+    if (!std::strcmp(name, backendName(b))) {
+      backend = b;
+      return true;
+    }
+  }
+  return false;
+}
+
+Executor::Executor(Backend backend, int threads, bool numa)
+    : kind(backend), requested(std::max(threads, 0)),
+      numa(numa && backend == Backend::ThreadPool) {
+  if (kind == Backend::ThreadPool)
+    pool = std::make_shared<ThreadPool>(
+        requested ? requested : hardwareThreads(), this->numa);
+}
+
+int Executor::threads() const {
+  switch (kind) {
+  case Backend::Serial:
+    return 1;
+  case Backend::OpenMP:
+#ifdef _OPENMP
+    return requested ? requested : omp_get_max_threads();
+#else
+    return 1;
+#endif
+  case Backend::ParallelStl:
+#ifdef CPPHYSICS_PARALLEL_STL
+    return hardwareThreads();
+#else
+    return 1;
+#endif
+  case Backend::ThreadPool:
+    return pool->size();
+  }
+  return 1;
+}
+
+std::vector<int> Executor::nodeSplit() const {
+  if (pool)
+    return pool->first;
+  return {0, threads()};
+}
+
+std::vector<NodeStats> Executor::nodeStats() const {
+  if (!pool)
+    return {};
+  std::lock_guard<std::mutex> lock(pool->mutex);
+  return pool->stats;
+}
+
+void Executor::resetNodeStats() const {
+  if (!pool)
+    return;
+  std::lock_guard<std::mutex> lock(pool->mutex);
+  for (NodeStats &node : pool->stats)
+    node = NodeStats{node.threads};
+}
+
+void Executor::run(size_t chunks, void (*call)(void *, size_t),
+                   void *context) const {
+  switch (kind) {
+  case Backend::Serial:
+    break;
+  case Backend::OpenMP: {
+#ifdef _OPENMP
+    const long count = long(chunks);
+    const int threads = requested ? requested : omp_get_max_threads();
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+    for (long c = 0; c < count; ++c)
+      call(context, size_t(c));
+    return;
+#else
+    break;
+#endif
+  }
+  case Backend::ParallelStl: {
+#ifdef CPPHYSICS_PARALLEL_STL
+    // par rather than par_unseq: each chunk already vectorises its own
+    // inner loops, and chunks allocate (tree walks), which unsequenced
+    // execution does not allow
+    std::vector<size_t> index(chunks);
+    std::iota(index.begin(), index.end(), size_t(0));
+    std::for_each(std::execution::par, index.begin(), index.end(),
+                  [&](size_t c) { call(context, c); });
+    return;
+#else
+    break;
+#endif
+  }
+  case Backend::ThreadPool:
+    pool->run(chunks, call, context);
+    return;
+  }
+  for (size_t c = 0; c < chunks; ++c)
+    call(context, c);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "numa.h"
+
+// Where the per-body loops of a force pass run. Every backend gives the same
+// answers; they differ only in how chunks of bodies are handed to threads,
+// so the fastest one can be picked per machine at run time.
+enum class Backend {
+  Serial,      // the calling thread only
+  OpenMP,      // an OpenMP parallel loop (serial when built without OpenMP)
+  ParallelStl, // std::for_each(std::execution::par) (serial without TBB)
+  ThreadPool,  // the library's own pool of worker threads
+};
+
+const char *backendName(Backend backend);
+// "serial", "openmp", "stl" or "pool"; false for anything else
+bool parseBackend(const char *name, Backend &backend);
+
+class ThreadPool;
+
+// Hands disjoint chunks of an index range to a backend. Cheap to copy;
+// copies of a thread-pool executor share its workers.
+class Executor {
+public:
+  // threads = 0 uses every hardware thread; ignored by Serial. numa only
+  // applies to the thread pool: its workers are pinned node by node and
+  // each node gets a fixed slice of every loop.
+  explicit Executor(Backend backend = Backend::OpenMP, int threads = 0,
+                    bool numa = false);
+
+  Backend backend() const { return kind; }
+  int requestedThreads() const { return requested; }
+  bool numaAware() const { return numa; }
+  // threads actually used
+  int threads() const;
+
+  // The first thread of each node followed by the thread count; node k's
+  // slice of a loop over n is [n * split[k] / total, n * split[k + 1] /
+  // total), to pass to placeOnNodes. One node unless NUMA-aware.
+  std::vector<int> nodeSplit() const;
+  // per node, since the pool was made or last reset; empty without a pool
+  std::vector<NodeStats> nodeStats() const;
+  void resetNodeStats() const;
+
+  // Calls body(begin, end) for chunks of at most grain indices that cover
+  // 0 .. n - 1 exactly once, possibly several at a time; returns when all
+  // are done. Chunks are the unit of load balancing.
+  template <typename F> void forRange(size_t n, size_t grain, F &&body) const {
+    if (n == 0)
+      return;
+    grain = std::max<size_t>(grain, 1);
+    auto chunk = [&](size_t c) {
+      size_t begin = c * grain;
+      body(begin, std::min(begin + grain, n));
+    };
+    run((n + grain - 1) / grain, &callChunk<decltype(chunk)>, &chunk);
+  }
+
+private:
+  template <typename C> static void callChunk(void *chunk, size_t c) {
+    (*static_cast<C *>(chunk))(c);
+  }
+  void run(size_t chunks, void (*call)(void *, size_t), void *context) const;
+
+  Backend kind;
+  int requested;
+  bool numa;
+  std::shared_ptr<ThreadPool> pool;
+};
@@ -0,0 +1,311 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <utility>
+
+#include "composition.h"
+#include "nbody.h"
+
+// A handful of bodies whose count is fixed at compile time, such as the
+// three in gravity.cpp and test.cpp. With N known every pair interaction,
+// drift and kick is unrolled by the compiler, the state fits in registers
+// and a step has no loops, branches or allocations; this is the path for
+// ensembles that run the same small system billions of times.
+template <int N> struct FewBodyState {
+  double x[N], y[N], z[N];
+  double vx[N], vy[N], vz[N];
+  double mass[N];
+};
+
+namespace fewbody {
+
+// GCC otherwise keeps the force sum as a call of its own
+#define FEWBODY_INLINE inline __attribute__((always_inline))
+
+// Pair k of the N * (N - 1) / 2 pairs i < j, in the order (0,1), (0,2), ...
+template <int N> constexpr int pairFirst(int k) {
+  int i = 0;
+  while (k >= N - 1 - i) {
+    k -= N - 1 - i;
+    ++i;
+  }
+  return i;
+}
+
+template <int N> constexpr int pairSecond(int k) {
+  int i = pairFirst<N>(k);
+  for (int f = 0; f < i; ++f)
+    k -= N - 1 - f;
+  return i + 1 + k;
+}
+
+template <int N> struct Accelerations {
+  double x[N], y[N], z[N];
+};
+
+template <int N, int I, int J>
+FEWBODY_INLINE void pair(const FewBodyState<N> &s, double eps2,
+                         Accelerations<N> &a) {
+  double dx = s.x[J] - s.x[I];
+  double dy = s.y[J] - s.y[I];
+  double dz = s.z[J] - s.z[I];
+  double inv = 1.0 / std::sqrt(dx * dx + dy * dy + dz * dz + eps2);
+  double inv3 = inv * inv * inv;
+  double toJ = s.mass[J] * inv3, toI = s.mass[I] * inv3;
+  a.x[I] += dx * toJ;
+  a.y[I] += dy * toJ;
+  a.z[I] += dz * toJ;
+  a.x[J] -= dx * toI;
+  a.y[J] -= dy * toI;
+  a.z[J] -= dz * toI;
+}
+
+// Accelerations over G, each pair visited once.
+template <int N, size_t... K>
+FEWBODY_INLINE Accelerations<N>
+accelerations(const FewBodyState<N> &s, double eps2, std::index_sequence<K...>) {
+  Accelerations<N> a = {};
+  (pair<N, pairFirst<N>(K), pairSecond<N>(K)>(s, eps2, a), ...);
+  return a;
+}
+
+template <int N, size_t... I>
+FEWBODY_INLINE void drift(FewBodyState<N> &s, double dt,
+                          std::index_sequence<I...>) {
+  ((s.x[I] += s.vx[I] * dt, s.y[I] += s.vy[I] * dt, s.z[I] += s.vz[I] * dt),
+   ...);
+}
+
+template <int N, size_t... I>
+FEWBODY_INLINE void kick(FewBodyState<N> &s, const Accelerations<N> &a,
+                         double Gdt, std::index_sequence<I...>) {
+  ((s.vx[I] += a.x[I] * Gdt, s.vy[I] += a.y[I] * Gdt,
+    s.vz[I] += a.z[I] * Gdt),
+   ...);
+}
+
+// First post-Newtonian (Einstein-Infeld-Hoffmann) gravity, as in the JPL
+// ephemerides (Newhall, Standish and Williams 1983). On top of the
+// Newtonian pull it needs each body's potential, which potentials() sums
+// over G, and the other bodies' Newtonian accelerations a.
+
+template <int N> struct Potentials {
+  double phi[N];
+};
+
+template <int N, int I, int J>
+FEWBODY_INLINE void potentialPair(const FewBodyState<N> &s, double eps2,
+                                  Potentials<N> &p) {
+  double dx = s.x[J] - s.x[I];
+  double dy = s.y[J] - s.y[I];
+  double dz = s.z[J] - s.z[I];
+  double inv = 1.0 / std::sqrt(dx * dx + dy * dy + dz * dz + eps2);
+  p.phi[I] += s.mass[J] * inv;
+  p.phi[J] += s.mass[I] * inv;
+}
+
+template <int N, size_t... K>
+FEWBODY_INLINE Potentials<N> potentials(const FewBodyState<N> &s, double eps2,
+                                        std::index_sequence<K...>) {
+  Potentials<N> p = {};
+  (potentialPair<N, pairFirst<N>(K), pairSecond<N>(K)>(s, eps2, p), ...);
+  return p;
+}
+
+// The 1PN terms one side of a pair adds to body i from body j, over G; d
+// runs from i to j. g = G / c^2, k = 1 / c^2.
+template <int N>
+FEWBODY_INLINE void postNewtonianSide(const FewBodyState<N> &s,
+                                      const Accelerations<N> &a,
+                                      const Potentials<N> &p, int i, int j,
+                                      const double d[3], double inv, double g,
+                                      double k, Accelerations<N> &out) {
+  const double inv3 = inv * inv * inv;
+  const double vi[3] = {s.vx[i], s.vy[i], s.vz[i]};
+  const double vj[3] = {s.vx[j], s.vy[j], s.vz[j]};
+  const double aj[3] = {a.x[j], a.y[j], a.z[j]};
+  double vi2 = 0.0, vj2 = 0.0, vij = 0.0, dvj = 0.0, daj = 0.0, dw = 0.0;
+  for (int c = 0; c < 3; ++c) {
+    vi2 += vi[c] * vi[c];
+    vj2 += vj[c] * vj[c];
+    vij += vi[c] * vj[c];
+    dvj += d[c] * vj[c];
+    daj += d[c] * aj[c];
+    dw += d[c] * (4.0 * vi[c] - 3.0 * vj[c]);
+  }
+  const double radial = dvj * inv;
+  const double bracket = -g * (4.0 * p.phi[i] + p.phi[j]) +
+                         k * (vi2 + 2.0 * vj2 - 4.0 * vij) -
+                         1.5 * k * radial * radial + 0.5 * g * daj;
+  const double mj = s.mass[j];
+  // (x_i - x_j) . (4 v_i - 3 v_j) = -dw
+  const double along = mj * inv3 * bracket, across = -mj * inv3 * dw * k;
+  const double pulled = 3.5 * g * mj * inv;
+  double *o[3] = {&out.x[i], &out.y[i], &out.z[i]};
+  for (int c = 0; c < 3; ++c)
+    *o[c] += along * d[c] + across * (vi[c] - vj[c]) + pulled * aj[c];
+}
+
+template <int N, int I, int J>
+FEWBODY_INLINE void postNewtonianPair(const FewBodyState<N> &s,
+                                      const Accelerations<N> &a,
+                                      const Potentials<N> &p, double eps2,
+                                      double g, double k,
+                                      Accelerations<N> &out) {
+  const double d[3] = {s.x[J] - s.x[I], s.y[J] - s.y[I], s.z[J] - s.z[I]};
+  const double back[3] = {-d[0], -d[1], -d[2]};
+  const double inv =
+      1.0 / std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2] + eps2);
+  postNewtonianSide(s, a, p, I, J, d, inv, g, k, out);
+  postNewtonianSide(s, a, p, J, I, back, inv, g, k, out);
+}
+
+// The 1PN correction over G, given the Newtonian accelerations over G.
+template <int N, size_t... K>
+FEWBODY_INLINE Accelerations<N>
+postNewtonian(const FewBodyState<N> &s, const Accelerations<N> &a, double G,
+              double eps2, double invC2, std::index_sequence<K...> pairs) {
+  const Potentials<N> p = potentials(s, eps2, pairs);
+  // a and phi are over G, so the terms that hold them take one more G
+  Accelerations<N> out = {};
+  (postNewtonianPair<N, pairFirst<N>(K), pairSecond<N>(K)>(
+       s, a, p, eps2, G * invC2, invC2, out),
+   ...);
+  return out;
+}
+
+#undef FEWBODY_INLINE
+
+} // namespace fewbody
+
+// One drift-kick-drift leapfrog step, the same scheme as
+// Integrator::Leapfrog, with force and integrator fused into one function.
+// There is no r = 0 check: with eps2 = 0 bodies must never coincide.
+template <int N>
+inline void stepFewBody(FewBodyState<N> &s, double G, double eps2, double dt) {
+  static_assert(N >= 2, "a few-body system needs at least two bodies");
+  constexpr auto bodies = std::make_index_sequence<N>();
+  constexpr auto pairs = std::make_index_sequence<N * (N - 1) / 2>();
+  fewbody::drift(s, 0.5 * dt, bodies);
+  fewbody::kick(s, fewbody::accelerations(s, eps2, pairs), G * dt, bodies);
+  fewbody::drift(s, 0.5 * dt, bodies);
+}
+
+// steps leapfrog steps; consecutive half drifts are merged, which gives the
+// same orbit as calling stepFewBody steps times (up to rounding) with one
+// force evaluation per step.
+template <int N>
+inline void stepFewBody(FewBodyState<N> &s, double G, double eps2, double dt,
+                        long steps) {
+  constexpr auto bodies = std::make_index_sequence<N>();
+  constexpr auto pairs = std::make_index_sequence<N * (N - 1) / 2>();
+  if (steps <= 0)
+    return;
+  fewbody::drift(s, 0.5 * dt, bodies);
+  for (long k = 1; k < steps; ++k) {
+    fewbody::kick(s, fewbody::accelerations(s, eps2, pairs), G * dt, bodies);
+    fewbody::drift(s, dt, bodies);
+  }
+  fewbody::kick(s, fewbody::accelerations(s, eps2, pairs), G * dt, bodies);
+  fewbody::drift(s, 0.5 * dt, bodies);
+}
+
+// steps steps of the leapfrog composed into a higher order method (see
+// composition.h): one force evaluation per stage, with every pair of
+// consecutive half drifts merged, across steps too.
+template <int N>
+inline void stepFewBody(FewBodyState<N> &s, double G, double eps2, double dt,
+                        long steps, const CompositionWeights &c) {
+  constexpr auto bodies = std::make_index_sequence<N>();
+  constexpr auto pairs = std::make_index_sequence<N * (N - 1) / 2>();
+  if (steps <= 0)
+    return;
+  fewbody::drift(s, 0.5 * c.w[0] * dt, bodies);
+  for (long n = 0; n < steps; ++n) {
+    for (int k = 0; k < c.stages; ++k) {
+      fewbody::kick(s, fewbody::accelerations(s, eps2, pairs),
+                    G * c.w[k] * dt, bodies);
+      double next = k + 1 < c.stages ? c.w[k + 1]
+                    : n + 1 < steps  ? c.w[0]
+                                     : 0.0;
+      fewbody::drift(s, 0.5 * (c.w[k] + next) * dt, bodies);
+    }
+  }
+}
+
+// stepFewBody(s, G, eps2, dt, steps) with gravity chosen at compile time:
+// Newtonian, the same code as above, or with the first post-Newtonian
+// (EIH) terms for compact objects, c being the speed of light in the run's
+// units. The 1PN force depends on velocity, so each kick takes it at a
+// velocity half a kick ahead, which keeps the step second order; that
+// costs two 1PN passes per step, and a Newtonian run none. Softening
+// should be 0 when it is on.
+template <int N, bool PostNewtonian>
+inline void stepFewBody(FewBodyState<N> &s, double G, double eps2, double dt,
+                        long steps, double c) {
+  if constexpr (!PostNewtonian) {
+    (void)c;
+    stepFewBody(s, G, eps2, dt, steps);
+  } else {
+    constexpr auto bodies = std::make_index_sequence<N>();
+    constexpr auto pairs = std::make_index_sequence<N * (N - 1) / 2>();
+    const double invC2 = 1.0 / (c * c);
+    auto kick = [&] {
+      const fewbody::Accelerations<N> a =
+          fewbody::accelerations(s, eps2, pairs);
+      fewbody::Accelerations<N> total = a;
+      // a first guess of the kick gives the velocity half way through it
+      FewBodyState<N> half = s;
+      fewbody::Accelerations<N> pn =
+          fewbody::postNewtonian(s, a, G, eps2, invC2, pairs);
+      for (int i = 0; i < N; ++i) {
+        half.vx[i] += 0.5 * G * dt * (a.x[i] + pn.x[i]);
+        half.vy[i] += 0.5 * G * dt * (a.y[i] + pn.y[i]);
+        half.vz[i] += 0.5 * G * dt * (a.z[i] + pn.z[i]);
+      }
+      pn = fewbody::postNewtonian(half, a, G, eps2, invC2, pairs);
+      for (int i = 0; i < N; ++i) {
+        total.x[i] += pn.x[i];
+        total.y[i] += pn.y[i];
+        total.z[i] += pn.z[i];
+      }
+      fewbody::kick(s, total, G * dt, bodies);
+    };
+    if (steps <= 0)
+      return;
+    fewbody::drift(s, 0.5 * dt, bodies);
+    for (long k = 1; k < steps; ++k) {
+      kick();
+      fewbody::drift(s, dt, bodies);
+    }
+    kick();
+    fewbody::drift(s, 0.5 * dt, bodies);
+  }
+}
+
+// The first N bodies of a store, and back.
+template <int N> FewBodyState<N> fewBodiesFrom(const BodyStore &b) {
+  FewBodyState<N> s;
+  for (int i = 0; i < N; ++i) {
+    s.x[i] = b.x[i];
+    s.y[i] = b.y[i];
+    s.z[i] = b.z[i];
+    s.vx[i] = b.vx[i];
+    s.vy[i] = b.vy[i];
+    s.vz[i] = b.vz[i];
+    s.mass[i] = b.mass[i];
+  }
+  return s;
+}
+
+template <int N> void copyFewBodies(const FewBodyState<N> &s, BodyStore &b) {
+  for (int i = 0; i < N; ++i) {
+    b.x[i] = s.x[i];
+    b.y[i] = s.y[i];
+    b.z[i] = s.z[i];
+    b.vx[i] = s.vx[i];
+    b.vy[i] = s.vy[i];
+    b.vz[i] = s.vz[i];
+  }
+}
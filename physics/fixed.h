@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+// Signed fixed-point number with FracBits fractional bits stored in Raw, using
+// Wide for intermediate products. Everything is plain integer arithmetic, so
+// the same inputs give bit-identical results on every compiler, optimisation
+// level and CPU, which is what lockstep simulation needs and floats can't
+// promise.
+//
+// Rounding is always towards negative infinity (arithmetic shifts) for
+// multiplication and towards zero for division, matching what the integer
+// operations do.
+template <typename Raw, typename Wide, int FracBits> struct FixedPoint {
+  static_assert(sizeof(Wide) >= 2 * sizeof(Raw), "Wide must hold a product");
+  using RawType = Raw;
+  using WideType = Wide;
+  static constexpr int fracBits = FracBits;
+  static constexpr Raw oneRaw = Raw(1) << FracBits;
+
+  Raw raw = 0;
+
+  constexpr FixedPoint() = default;
+
+  static constexpr FixedPoint fromRaw(Raw r) {
+    FixedPoint f;
+    f.raw = r;
+    return f;
+  }
+  static constexpr FixedPoint fromInt(int64_t i) {
+    return fromRaw(Raw(i * int64_t(oneRaw)));
+  }
+  // num / den, exact to the last bit; the way to write constants
+  static constexpr FixedPoint fromRatio(int64_t num, int64_t den) {
+    return fromRaw(Raw(Wide(num) * Wide(oneRaw) / Wide(den)));
+  }
+  // Only for setting up scenes and reading results for drawing. Conversions
+  // from float are deterministic as long as every peer starts from the same
+  // float, but nothing inside a step should use them.
+  static FixedPoint fromFloat(double d) {
+    return fromRaw(Raw(d * double(oneRaw)));
+  }
+  float toFloat() const { return float(double(raw) / double(oneRaw)); }
+
+  constexpr FixedPoint operator-() const { return fromRaw(-raw); }
+  constexpr FixedPoint operator+(FixedPoint o) const {
+    return fromRaw(raw + o.raw);
+  }
+  constexpr FixedPoint operator-(FixedPoint o) const {
+    return fromRaw(raw - o.raw);
+  }
+  constexpr FixedPoint operator*(FixedPoint o) const {
+    return fromRaw(Raw((Wide(raw) * Wide(o.raw)) >> FracBits));
+  }
+  constexpr FixedPoint operator/(FixedPoint o) const {
+    return fromRaw(Raw(Wide(raw) * Wide(oneRaw) / Wide(o.raw)));
+  }
+  FixedPoint &operator+=(FixedPoint o) { return *this = *this + o; }
+  FixedPoint &operator-=(FixedPoint o) { return *this = *this - o; }
+  FixedPoint &operator*=(FixedPoint o) { return *this = *this * o; }
+
+  constexpr bool operator==(FixedPoint o) const { return raw == o.raw; }
+  constexpr bool operator!=(FixedPoint o) const { return raw != o.raw; }
+  constexpr bool operator<(FixedPoint o) const { return raw < o.raw; }
+  constexpr bool operator>(FixedPoint o) const { return raw > o.raw; }
+  constexpr bool operator<=(FixedPoint o) const { return raw <= o.raw; }
+  constexpr bool operator>=(FixedPoint o) const { return raw >= o.raw; }
+};
+
+// Q16.16: range +-32768, resolution 1.5e-5. Plenty for the screen-sized
+// circle box and cheap, since products fit in 64 bits.
+using Fixed16 = FixedPoint<int32_t, int64_t, 16>;
+// Q32.32: range +-2e9, resolution 2.3e-10, for scenes that need the headroom.
+using Fixed32 = FixedPoint<int64_t, __int128, 32>;
+
+template <typename F> constexpr F fixedMin(F a, F b) { return b < a ? b : a; }
+template <typename F> constexpr F fixedMax(F a, F b) { return a < b ? b : a; }
+template <typename F> constexpr F fixedClamp(F v, F lo, F hi) {
+  return fixedMin(fixedMax(v, lo), hi);
+}
+template <typename F> constexpr F fixedAbs(F v) { return v.raw < 0 ? -v : v; }
+
+// Integer square root rounded down, bit by bit.
+template <typename U> U integerSqrt(U n) {
+  U result = 0;
+  U bit = U(1) << (sizeof(U) * 8 - 2);
+  while (bit > n)
+    bit >>= 2;
+  while (bit != 0) {
+    if (n >= result + bit) {
+      n -= result + bit;
+      result = (result >> 1) + bit;
+    } else {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+  return result;
+}
+
+// Square root rounded down. Negative inputs give zero.
+template <typename F> F fixedSqrt(F v) {
+  using UWide = std::make_unsigned_t<typename F::WideType>;
+  if (v.raw <= 0)
+    return F();
+  // sqrt(raw / one) * one == sqrt(raw * one)
+  return F::fromRaw(
+      typename F::RawType(integerSqrt(UWide(v.raw) << F::fracBits)));
+}
+
+// x * x + y * y in raw units of the wide type, without rounding the squares
+// first. Short distances would lose most of their bits otherwise.
+template <typename F> typename F::WideType fixedLengthSquaredRaw(F x, F y) {
+  using W = typename F::WideType;
+  return W(x.raw) * W(x.raw) + W(y.raw) * W(y.raw);
+}
+
+// sqrt(x * x + y * y), rounded down
+template <typename F> F fixedLength(F x, F y) {
+  using UWide = std::make_unsigned_t<typename F::WideType>;
+  return F::fromRaw(typename F::RawType(
+      integerSqrt(UWide(fixedLengthSquaredRaw(x, y)))));
+}
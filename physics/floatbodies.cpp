@@ -0,0 +1,106 @@
+#include "floatbodies.h"
+
+#include "gravity.h"
+
+int FloatBodies::add(float px, float py, float pz, float pvx, float pvy,
+                     float pvz, float m) {
+  x.push_back(px);
+  y.push_back(py);
+  z.push_back(pz);
+  vx.push_back(pvx);
+  vy.push_back(pvy);
+  vz.push_back(pvz);
+  mass.push_back(m);
+  for (std::vector<float> *rest :
+       {&xRest, &yRest, &zRest, &vxRest, &vyRest, &vzRest})
+    rest->push_back(0.0f);
+  // the forces changed with the bodies
+  ax.clear();
+  return int(x.size()) - 1;
+}
+
+void FloatBodies::clear() {
+  for (std::vector<float> *v :
+       {&x, &y, &z, &vx, &vy, &vz, &mass, &xRest, &yRest, &zRest, &vxRest,
+        &vyRest, &vzRest, &ax, &ay, &az})
+    v->clear();
+}
+
+namespace {
+
+// value += rate * h for every body, through the Summed of S. A rate that is
+// itself compensated adds what its rounded value misses as a second term,
+// since rate + rateRest in float would round straight back to rate.
+template <FloatSum S>
+void advance(size_t n, float *value, float *rest, const float *rate,
+             const float *rateRest, float h, const Executor &executor) {
+  executor.forRange(n, 4096, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Summed<S, float> sum = Summed<S, float>::from(value[i], rest[i]);
+      sum.add(rate[i] * h);
+      if (S != FloatSum::Plain && rateRest)
+        sum.add(rateRest[i] * h);
+      sum.split(value[i], rest[i]);
+    }
+  });
+}
+
+template <FloatSum S>
+void leapfrog(FloatBodies &b, float G, float eps, float dt, long steps,
+              const Executor &executor) {
+  const size_t n = b.size();
+  auto forces = [&] {
+    gravityDirectPacked(n, b.x.data(), b.y.data(), b.z.data(), b.mass.data(),
+                        G, eps, b.ax.data(), b.ay.data(), b.az.data(), S,
+                        executor);
+  };
+  auto kick = [&](float h) {
+    advance<S>(n, b.vx.data(), b.vxRest.data(), b.ax.data(), nullptr, h,
+               executor);
+    advance<S>(n, b.vy.data(), b.vyRest.data(), b.ay.data(), nullptr, h,
+               executor);
+    advance<S>(n, b.vz.data(), b.vzRest.data(), b.az.data(), nullptr, h,
+               executor);
+  };
+  auto drift = [&](float h) {
+    advance<S>(n, b.x.data(), b.xRest.data(), b.vx.data(), b.vxRest.data(),
+               h, executor);
+    advance<S>(n, b.y.data(), b.yRest.data(), b.vy.data(), b.vyRest.data(),
+               h, executor);
+    advance<S>(n, b.z.data(), b.zRest.data(), b.vz.data(), b.vzRest.data(),
+               h, executor);
+  };
+
+  if (b.ax.size() != n) {
+    b.ax.resize(n);
+    b.ay.resize(n);
+    b.az.resize(n);
+    forces();
+  }
+  for (long k = 0; k < steps; ++k) {
+    kick(0.5f * dt);
+    drift(dt);
+    forces();
+    kick(0.5f * dt);
+  }
+}
+
+} // namespace
+
+void stepFloatBodies(FloatBodies &bodies, float G, float eps, float dt,
+                     long steps, const Executor &executor) {
+  switch (bodies.sum) {
+  case FloatSum::Plain:
+    leapfrog<FloatSum::Plain>(bodies, G, eps, dt, steps, executor);
+    break;
+  case FloatSum::Kahan:
+    leapfrog<FloatSum::Kahan>(bodies, G, eps, dt, steps, executor);
+    break;
+  case FloatSum::Neumaier:
+    leapfrog<FloatSum::Neumaier>(bodies, G, eps, dt, steps, executor);
+    break;
+  case FloatSum::FloatFloat:
+    leapfrog<FloatSum::FloatFloat>(bodies, G, eps, dt, steps, executor);
+    break;
+  }
+}
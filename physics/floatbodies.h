@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "compensated.h"
+#include "execution.h"
+
+// Point masses in single precision, pulled by gravityDirectPacked and moved
+// by a kick-drift-kick leapfrog. Each position and velocity is a compensated
+// sum kept in two arrays (the rounded value and what it misses), so the
+// small drift and kick of every step aren't rounded away against a much
+// larger coordinate: over many steps a plain float state drifts off by
+// about an ulp per step, a compensated one by about an ulp in all. Forces
+// see only the rounded values; drifts move by the whole velocity, rest and
+// all. The sum is fixed when the store is made, since the second words mean
+// something only to the method that wrote them.
+struct FloatBodies {
+  explicit FloatBodies(FloatSum sum = defaultFloatSum) : sum(sum) {}
+
+  int add(float px, float py, float pz, float pvx, float pvy, float pvz,
+          float m);
+  void clear();
+  size_t size() const { return x.size(); }
+
+  FloatSum sum;
+  std::vector<float> x, y, z;
+  std::vector<float> vx, vy, vz;
+  std::vector<float> mass;
+  // what the values above miss; zero for FloatSum::Plain
+  std::vector<float> xRest, yRest, zRest;
+  std::vector<float> vxRest, vyRest, vzRest;
+  // the last accelerations, reused by the next step's first half kick
+  std::vector<float> ax, ay, az;
+};
+
+// steps leapfrog steps of dt, with forces and the per-body loops on
+// executor.
+void stepFloatBodies(FloatBodies &bodies, float G, float eps, float dt,
+                     long steps, const Executor &executor = Executor());
@@ -0,0 +1,553 @@
+#include "gravity.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+#include "simd.h"
+
+void gravityDirect(size_t n, const double *x, const double *y, const double *z,
+                   const double *m, double G, double eps, double *ax,
+                   double *ay, double *az, const Executor &executor) {
+  const int count = int(n);
+  const double eps2 = eps * eps;
+
+  executor.forRange(n, 16, [&](size_t begin, size_t end) {
+    for (int i = int(begin); i < int(end); ++i) {
+      const double xi = x[i], yi = y[i], zi = z[i];
+      double sx = 0.0, sy = 0.0, sz = 0.0;
+#pragma omp simd reduction(+ : sx, sy, sz)
+      for (int j = 0; j < count; ++j) {
+        double dx = x[j] - xi, dy = y[j] - yi, dz = z[j] - zi;
+        double r2 = dx * dx + dy * dy + dz * dz + eps2;
+        // the body itself sits at r2 == 0 and adds nothing
+        double inv = r2 > 0.0 ? 1.0 / std::sqrt(r2) : 0.0;
+        double s = m[j] * inv * inv * inv;
+        sx += dx * s;
+        sy += dy * s;
+        sz += dz * s;
+      }
+      ax[i] = G * sx;
+      ay[i] = G * sy;
+      az[i] = G * sz;
+    }
+  });
+}
+
+namespace {
+
+constexpr int maxTileTargets = 256;
+
+// Sources s0 .. s1 - 1 acting on the four targets i .. i + 3; every source
+// loaded is used four times.
+void sumFour(int i, int s0, int s1, const double *x, const double *y,
+             const double *z, const double *m, double eps2, double *sx,
+             double *sy, double *sz) {
+  const double x0 = x[i], y0 = y[i], z0 = z[i];
+  const double x1 = x[i + 1], y1 = y[i + 1], z1 = z[i + 1];
+  const double x2 = x[i + 2], y2 = y[i + 2], z2 = z[i + 2];
+  const double x3 = x[i + 3], y3 = y[i + 3], z3 = z[i + 3];
+  double ax0 = 0, ay0 = 0, az0 = 0, ax1 = 0, ay1 = 0, az1 = 0;
+  double ax2 = 0, ay2 = 0, az2 = 0, ax3 = 0, ay3 = 0, az3 = 0;
+#pragma omp simd reduction(+ : ax0, ay0, az0, ax1, ay1, az1, ax2, ay2, az2,   \
+                               ax3, ay3, az3)
+  for (int j = s0; j < s1; ++j) {
+    const double xj = x[j], yj = y[j], zj = z[j], mj = m[j];
+    // the body itself sits at r2 == 0 and adds nothing
+#define CPPHYSICS_PAIR(k)                                                      \
+  {                                                                            \
+    double dx = xj - x##k, dy = yj - y##k, dz = zj - z##k;                     \
+    double r2 = dx * dx + dy * dy + dz * dz + eps2;                            \
+    double inv = r2 > 0.0 ? 1.0 / std::sqrt(r2) : 0.0;                         \
+    double s = mj * inv * inv * inv;                                           \
+    ax##k += dx * s;                                                           \
+    ay##k += dy * s;                                                           \
+    az##k += dz * s;                                                           \
+  }
+    CPPHYSICS_PAIR(0)
+    CPPHYSICS_PAIR(1)
+    CPPHYSICS_PAIR(2)
+    CPPHYSICS_PAIR(3)
+#undef CPPHYSICS_PAIR
+  }
+  sx[0] += ax0, sy[0] += ay0, sz[0] += az0;
+  sx[1] += ax1, sy[1] += ay1, sz[1] += az1;
+  sx[2] += ax2, sy[2] += ay2, sz[2] += az2;
+  sx[3] += ax3, sy[3] += ay3, sz[3] += az3;
+}
+
+void sumOne(int i, int s0, int s1, const double *x, const double *y,
+            const double *z, const double *m, double eps2, double *sx,
+            double *sy, double *sz) {
+  const double xi = x[i], yi = y[i], zi = z[i];
+  double ax = 0.0, ay = 0.0, az = 0.0;
+#pragma omp simd reduction(+ : ax, ay, az)
+  for (int j = s0; j < s1; ++j) {
+    double dx = x[j] - xi, dy = y[j] - yi, dz = z[j] - zi;
+    double r2 = dx * dx + dy * dy + dz * dz + eps2;
+    double inv = r2 > 0.0 ? 1.0 / std::sqrt(r2) : 0.0;
+    double s = m[j] * inv * inv * inv;
+    ax += dx * s;
+    ay += dy * s;
+    az += dz * s;
+  }
+  *sx += ax, *sy += ay, *sz += az;
+}
+
+// Accelerations of targets 0 .. targets - 1 from all n sources.
+void directTiles(int targets, int n, const double *x, const double *y,
+                 const double *z, const double *m, double G, double eps,
+                 double *ax, double *ay, double *az, const GravityTiles &tiles,
+                 const Executor &executor) {
+  const int tileTargets =
+      std::clamp((tiles.targets + 3) / 4 * 4, 4, maxTileTargets);
+  const int tileSources = std::max(tiles.sources, 64);
+  const double eps2 = eps * eps;
+
+  // one tile of targets per chunk
+  const size_t tileCount = (size_t(targets) + tileTargets - 1) / tileTargets;
+  executor.forRange(tileCount, 1, [&](size_t tile, size_t) {
+    const int t0 = int(tile) * tileTargets;
+    const int t1 = std::min(t0 + tileTargets, targets);
+    double sx[maxTileTargets] = {}, sy[maxTileTargets] = {},
+           sz[maxTileTargets] = {};
+    for (int s0 = 0; s0 < n; s0 += tileSources) {
+      const int s1 = std::min(s0 + tileSources, n);
+      int i = t0;
+      for (; i + 4 <= t1; i += 4)
+        sumFour(i, s0, s1, x, y, z, m, eps2, sx + (i - t0), sy + (i - t0),
+                sz + (i - t0));
+      for (; i < t1; ++i)
+        sumOne(i, s0, s1, x, y, z, m, eps2, sx + (i - t0), sy + (i - t0),
+               sz + (i - t0));
+    }
+    for (int i = t0; i < t1; ++i) {
+      ax[i] = G * sx[i - t0];
+      ay[i] = G * sy[i - t0];
+      az[i] = G * sz[i - t0];
+    }
+  });
+}
+
+} // namespace
+
+void gravityDirectTiled(size_t n, const double *x, const double *y,
+                        const double *z, const double *m, double G,
+                        double eps, double *ax, double *ay, double *az,
+                        const GravityTiles &tiles, const Executor &executor) {
+  directTiles(int(n), int(n), x, y, z, m, G, eps, ax, ay, az, tiles,
+              executor);
+}
+
+GravityTiles tuneGravityTiles(size_t n, const double *x, const double *y,
+                              const double *z, const double *m, double eps,
+                              const Executor &executor) {
+  // enough targets for a few tiles of every size, so threads share them out
+  const int targets = int(std::min<size_t>(n, 512));
+  std::vector<double> ax(targets), ay(targets), az(targets);
+  GravityTiles best;
+  double bestTime = 1e300;
+  // one untimed run first to warm the caches
+  directTiles(targets, int(n), x, y, z, m, 1.0, eps, ax.data(), ay.data(),
+              az.data(), best, executor);
+  for (int tileTargets : {16, 32, 64, 128}) {
+    for (int tileSources : {512, 2048, 8192}) {
+      GravityTiles tiles;
+      tiles.targets = tileTargets;
+      tiles.sources = tileSources;
+      auto start = std::chrono::steady_clock::now();
+      directTiles(targets, int(n), x, y, z, m, 1.0, eps, ax.data(), ay.data(),
+                  az.data(), tiles, executor);
+      double time = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+      if (time < bestTime) {
+        bestTime = time;
+        best = tiles;
+      }
+    }
+  }
+  return best;
+}
+
+namespace {
+
+template <FloatSum S>
+void directPacked(size_t n, const float *x, const float *y, const float *z,
+                  const float *m, float G, float eps, float *ax, float *ay,
+                  float *az, const Executor &executor) {
+#if defined(__AVX512F__)
+  typedef Vec3x16 Vec;
+#else
+  typedef Vec3x8 Vec;
+#endif
+  typedef Vec::Float Float;
+  const int count = int(n);
+  const float eps2 = eps * eps;
+
+  const size_t packets = (n + Vec::lanes - 1) / Vec::lanes;
+  executor.forRange(packets, 4, [&](size_t begin, size_t end) {
+    for (int i = int(begin) * Vec::lanes; i < int(end) * Vec::lanes;
+         i += Vec::lanes) {
+      // the last packet may be short; its spare lanes are masked off
+      const int active = std::min(Vec::lanes, count - i);
+      Vec position = Vec::load(x + i, y + i, z + i, active);
+      Summed<S, Float> sx, sy, sz;
+      for (int j = 0; j < count; ++j) {
+        Vec diff = Vec(x[j], y[j], z[j]) - position;
+        Float r2 = diff.lengthSquared() + eps2;
+        // the body itself sits at r2 == 0 and adds nothing
+        Float inv = select(r2 > 0.0f, 1.0f / sqrtPacket(r2), Float{});
+        Float s = m[j] * inv * inv * inv;
+        sx.add(diff.x * s);
+        sy.add(diff.y * s);
+        sz.add(diff.z * s);
+      }
+      Vec acceleration(sx.value(), sy.value(), sz.value());
+      (acceleration * G).store(ax + i, ay + i, az + i, active);
+    }
+  });
+}
+
+} // namespace
+
+void gravityDirectPacked(size_t n, const float *x, const float *y,
+                         const float *z, const float *m, float G, float eps,
+                         float *ax, float *ay, float *az, FloatSum sum,
+                         const Executor &executor) {
+  switch (sum) {
+  case FloatSum::Plain:
+    directPacked<FloatSum::Plain>(n, x, y, z, m, G, eps, ax, ay, az,
+                                  executor);
+    break;
+  case FloatSum::Kahan:
+    directPacked<FloatSum::Kahan>(n, x, y, z, m, G, eps, ax, ay, az,
+                                  executor);
+    break;
+  case FloatSum::Neumaier:
+    directPacked<FloatSum::Neumaier>(n, x, y, z, m, G, eps, ax, ay, az,
+                                     executor);
+    break;
+  case FloatSum::FloatFloat:
+    directPacked<FloatSum::FloatFloat>(n, x, y, z, m, G, eps, ax, ay, az,
+                                       executor);
+    break;
+  }
+}
+
+void gravityShortRange(size_t n, const double *x, const double *y,
+                       const double *z, const double *m, double G, double eps,
+                       double cutoff, double *ax, double *ay, double *az,
+                       const Executor &executor) {
+  std::fill(ax, ax + n, 0.0);
+  std::fill(ay, ay + n, 0.0);
+  std::fill(az, az + n, 0.0);
+  if (n == 0 || !(cutoff > 0.0))
+    return;
+
+  // Bodies sorted by cell. Cell coordinates wrap at 2^21; cells that wrap
+  // onto each other share a key, which only costs extra distance tests.
+  double lo[3] = {x[0], y[0], z[0]};
+  for (size_t i = 1; i < n; ++i) {
+    lo[0] = std::min(lo[0], x[i]);
+    lo[1] = std::min(lo[1], y[i]);
+    lo[2] = std::min(lo[2], z[i]);
+  }
+  const double inv = 1.0 / cutoff;
+  const uint64_t mask = (uint64_t(1) << 21) - 1;
+  auto cellOf = [&](size_t i, uint64_t c[3]) {
+    c[0] = uint64_t((x[i] - lo[0]) * inv) & mask;
+    c[1] = uint64_t((y[i] - lo[1]) * inv) & mask;
+    c[2] = uint64_t((z[i] - lo[2]) * inv) & mask;
+  };
+  auto keyOf = [](const uint64_t c[3]) {
+    return c[0] | c[1] << 21 | c[2] << 42;
+  };
+  std::vector<uint64_t> keys(n);
+  std::vector<int> order(n);
+  for (size_t i = 0; i < n; ++i) {
+    uint64_t c[3];
+    cellOf(i, c);
+    keys[i] = keyOf(c);
+    order[i] = int(i);
+  }
+  std::sort(order.begin(), order.end(),
+            [&](int a, int b) { return keys[a] < keys[b]; });
+  std::vector<double> sx(n), sy(n), sz(n), sm(n);
+  for (size_t k = 0; k < n; ++k) {
+    sx[k] = x[order[k]];
+    sy[k] = y[order[k]];
+    sz[k] = z[order[k]];
+    sm[k] = m[order[k]];
+  }
+  // each occupied cell's first body and the one past its last
+  std::vector<size_t> firsts;
+  std::unordered_map<uint64_t, std::pair<size_t, size_t>> cells;
+  for (size_t k = 0; k < n; ++k) {
+    if (k == 0 || keys[order[k]] != keys[order[k - 1]]) {
+      firsts.push_back(k);
+      cells[keys[order[k]]] = {k, k};
+    }
+    cells[keys[order[k]]].second = k + 1;
+  }
+
+  const double eps2 = eps * eps, cutoff2 = cutoff * cutoff;
+  // the switch runs over r^2 from cutoff^2 / 4 to cutoff^2
+  const double inner2 = 0.25 * cutoff2, invSpan = 1.0 / (cutoff2 - inner2);
+  executor.forRange(firsts.size(), 8, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c) {
+      const size_t first = firsts[c];
+      const auto [b0, b1] = cells.at(keys[order[first]]);
+      uint64_t cell[3];
+      cellOf(size_t(order[first]), cell);
+      for (int dz = -1; dz <= 1; ++dz)
+        for (int dy = -1; dy <= 1; ++dy)
+          for (int dx = -1; dx <= 1; ++dx) {
+            uint64_t near[3] = {(cell[0] + dx) & mask, (cell[1] + dy) & mask,
+                                (cell[2] + dz) & mask};
+            auto found = cells.find(keyOf(near));
+            if (found == cells.end())
+              continue;
+            const size_t s0 = found->second.first, s1 = found->second.second;
+            for (size_t i = b0; i < b1; ++i) {
+              const double xi = sx[i], yi = sy[i], zi = sz[i];
+              double gx = 0.0, gy = 0.0, gz = 0.0;
+#pragma omp simd reduction(+ : gx, gy, gz)
+              for (size_t j = s0; j < s1; ++j) {
+                double ex = sx[j] - xi, ey = sy[j] - yi, ez = sz[j] - zi;
+                double d2 = ex * ex + ey * ey + ez * ez;
+                double r2 = d2 + eps2;
+                // the body itself (r2 == 0) and pairs past cutoff add nothing
+                double inv1 = r2 > 0.0 ? 1.0 / std::sqrt(r2) : 0.0;
+                double u = std::max((d2 - inner2) * invSpan, 0.0);
+                double weight = d2 < cutoff2 ? 1.0 - u * u * (3.0 - 2.0 * u)
+                                             : 0.0;
+                double f = sm[j] * inv1 * inv1 * inv1 * weight;
+                gx += ex * f;
+                gy += ey * f;
+                gz += ez * f;
+              }
+              const int k = order[i];
+              ax[k] += G * gx;
+              ay[k] += G * gy;
+              az[k] += G * gz;
+            }
+          }
+    }
+  });
+}
+
+void GravityTree::build(size_t n, const double *x, const double *y,
+                        const double *z, const double *m) {
+  nodes.clear();
+  leaves.clear();
+  order.resize(n);
+  for (size_t i = 0; i < n; ++i)
+    order[i] = int(i);
+  bx.assign(x, x + n);
+  by.assign(y, y + n);
+  bz.assign(z, z + n);
+  bm.assign(m, m + n);
+  if (n == 0)
+    return;
+
+  // smallest cube around everything
+  double lo[3] = {x[0], y[0], z[0]}, hi[3] = {x[0], y[0], z[0]};
+  for (size_t i = 1; i < n; ++i) {
+    lo[0] = std::min(lo[0], x[i]);
+    lo[1] = std::min(lo[1], y[i]);
+    lo[2] = std::min(lo[2], z[i]);
+    hi[0] = std::max(hi[0], x[i]);
+    hi[1] = std::max(hi[1], y[i]);
+    hi[2] = std::max(hi[2], z[i]);
+  }
+  double size = std::max({hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2]});
+  size = std::max(size * 1.0001, 1e-300);
+
+  Node root;
+  root.begin = 0;
+  root.end = int(n);
+  nodes.push_back(root);
+  split(0, lo[0], lo[1], lo[2], size, 0);
+
+  // lay the bodies out in tree order so leaves are contiguous
+  for (size_t k = 0; k < n; ++k) {
+    bx[k] = x[order[k]];
+    by[k] = y[order[k]];
+    bz[k] = z[order[k]];
+    bm[k] = m[order[k]];
+  }
+}
+
+void GravityTree::placeOnNodes(const std::vector<int> &split) {
+  for (BigVector<double> *v : {&bx, &by, &bz, &bm})
+    ::placeOnNodes(v->data(), v->size(), sizeof(double), split);
+}
+
+void GravityTree::split(int node, double ox, double oy, double oz,
+                        double size, int depth) {
+  constexpr int leafSize = 16;
+  constexpr int maxDepth = 48; // coincident bodies stop splitting here
+  nodes[node].ox = ox;
+  nodes[node].oy = oy;
+  nodes[node].oz = oz;
+  nodes[node].size = size;
+  const int begin = nodes[node].begin, end = nodes[node].end;
+
+  if (end - begin <= leafSize || depth >= maxDepth) {
+    leaves.push_back(node);
+    double mass = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+    for (int k = begin; k < end; ++k) {
+      int i = order[k];
+      mass += bm[i];
+      cx += bm[i] * bx[i];
+      cy += bm[i] * by[i];
+      cz += bm[i] * bz[i];
+    }
+    Node &leaf = nodes[node];
+    leaf.mass = mass;
+    double inv = mass > 0.0 ? 1.0 / mass : 0.0;
+    leaf.cx = cx * inv;
+    leaf.cy = cy * inv;
+    leaf.cz = cz * inv;
+    return;
+  }
+
+  // counting sort of this node's bodies into its eight octants
+  const double half = 0.5 * size;
+  const double mx = ox + half, my = oy + half, mz = oz + half;
+  auto octant = [&](int i) {
+    return (bx[i] >= mx ? 1 : 0) | (by[i] >= my ? 2 : 0) |
+           (bz[i] >= mz ? 4 : 0);
+  };
+  int counts[8] = {};
+  for (int k = begin; k < end; ++k)
+    ++counts[octant(order[k])];
+  int offsets[9];
+  offsets[0] = begin;
+  for (int o = 0; o < 8; ++o)
+    offsets[o + 1] = offsets[o] + counts[o];
+  std::vector<int> sorted(end - begin);
+  int fill[8];
+  std::copy(offsets, offsets + 8, fill);
+  for (int k = begin; k < end; ++k) {
+    int i = order[k];
+    sorted[fill[octant(i)]++ - begin] = i;
+  }
+  std::copy(sorted.begin(), sorted.end(), order.begin() + begin);
+
+  // children of a node are stored next to each other
+  const int first = int(nodes.size());
+  int childCount = 0;
+  for (int o = 0; o < 8; ++o) {
+    if (counts[o] == 0)
+      continue;
+    Node child;
+    child.begin = offsets[o];
+    child.end = offsets[o + 1];
+    nodes.push_back(child);
+    ++childCount;
+  }
+  nodes[node].firstChild = first;
+  nodes[node].childCount = childCount;
+
+  int c = first;
+  for (int o = 0; o < 8; ++o) {
+    if (counts[o] == 0)
+      continue;
+    split(c++, ox + (o & 1 ? half : 0.0), oy + (o & 2 ? half : 0.0),
+          oz + (o & 4 ? half : 0.0), half, depth + 1);
+  }
+
+  double mass = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+  for (int k = first; k < first + childCount; ++k) {
+    const Node &child = nodes[k];
+    mass += child.mass;
+    cx += child.mass * child.cx;
+    cy += child.mass * child.cy;
+    cz += child.mass * child.cz;
+  }
+  Node &self = nodes[node];
+  self.mass = mass;
+  double inv = mass > 0.0 ? 1.0 / mass : 0.0;
+  self.cx = cx * inv;
+  self.cy = cy * inv;
+  self.cz = cz * inv;
+}
+
+void GravityTree::accelerations(double G, double eps, double theta,
+                                double *ax, double *ay, double *az,
+                                const Executor &executor) const {
+  const int leafCount = int(leaves.size());
+  const double eps2 = eps * eps;
+  const double theta2 = theta * theta;
+
+  executor.forRange(leafCount, 16, [&](size_t first, size_t last) {
+    // interaction list for the current leaf
+    std::vector<double> lx, ly, lz, lm;
+    std::vector<int> stack;
+
+    for (int l = int(first); l < int(last); ++l) {
+      const Node &leaf = nodes[leaves[l]];
+      const double lo[3] = {leaf.ox, leaf.oy, leaf.oz};
+      const double hi[3] = {leaf.ox + leaf.size, leaf.oy + leaf.size,
+                            leaf.oz + leaf.size};
+      lx.clear();
+      ly.clear();
+      lz.clear();
+      lm.clear();
+
+      // Accept a cell only if it is far enough from every point of the
+      // leaf's box, so the list is good for all of the leaf's bodies.
+      stack.assign(1, 0);
+      while (!stack.empty()) {
+        const Node &node = nodes[stack.back()];
+        stack.pop_back();
+        double dx = std::max({lo[0] - node.cx, 0.0, node.cx - hi[0]});
+        double dy = std::max({lo[1] - node.cy, 0.0, node.cy - hi[1]});
+        double dz = std::max({lo[2] - node.cz, 0.0, node.cz - hi[2]});
+        double d2 = dx * dx + dy * dy + dz * dz;
+
+        if (node.size * node.size < theta2 * d2) {
+          lx.push_back(node.cx);
+          ly.push_back(node.cy);
+          lz.push_back(node.cz);
+          lm.push_back(node.mass);
+        } else if (node.childCount == 0) {
+          lx.insert(lx.end(), bx.begin() + node.begin, bx.begin() + node.end);
+          ly.insert(ly.end(), by.begin() + node.begin, by.begin() + node.end);
+          lz.insert(lz.end(), bz.begin() + node.begin, bz.begin() + node.end);
+          lm.insert(lm.end(), bm.begin() + node.begin, bm.begin() + node.end);
+        } else {
+          for (int c = 0; c < node.childCount; ++c)
+            stack.push_back(node.firstChild + c);
+        }
+      }
+
+      const int count = int(lx.size());
+      const double *px = lx.data(), *py = ly.data(), *pz = lz.data(),
+                   *pm = lm.data();
+      for (int k = leaf.begin; k < leaf.end; ++k) {
+        const double xi = bx[k], yi = by[k], zi = bz[k];
+        double sx = 0.0, sy = 0.0, sz = 0.0;
+        // the body itself is on the list, at r2 == 0, and adds nothing
+#pragma omp simd reduction(+ : sx, sy, sz)
+        for (int j = 0; j < count; ++j) {
+          double ex = px[j] - xi, ey = py[j] - yi, ez = pz[j] - zi;
+          double r2 = ex * ex + ey * ey + ez * ez + eps2;
+          double inv = r2 > 0.0 ? 1.0 / std::sqrt(r2) : 0.0;
+          double s = pm[j] * inv * inv * inv;
+          sx += ex * s;
+          sy += ey * s;
+          sz += ez * s;
+        }
+        const int i = order[k];
+        ax[i] = G * sx;
+        ay[i] = G * sy;
+        az[i] = G * sz;
+      }
+    }
+  });
+}
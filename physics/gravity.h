@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "compensated.h"
+#include "execution.h"
+#include "hugepages.h"
+
+// Newtonian gravity between point masses stored as structure-of-arrays.
+// Forces are softened as 1 / (r^2 + eps^2) so close encounters stay finite;
+// pass eps = 0 for exact gravity. Accelerations are written (not added) to
+// ax, ay, az. The double precision solvers spread their bodies over the
+// given executor (OpenMP by default).
+
+// Every pair, O(n^2). Exact apart from rounding, and the fastest choice up to
+// a few thousand bodies.
+void gravityDirect(size_t n, const double *x, const double *y, const double *z,
+                   const double *m, double G, double eps, double *ax,
+                   double *ay, double *az,
+                   const Executor &executor = Executor());
+
+// Tile sizes for gravityDirectTiled. A tile of targets is summed against one
+// tile of sources at a time, so those sources stay in cache while every
+// target in the tile reuses them.
+struct GravityTiles {
+  int targets = 64;   // rounded up to a multiple of 4, at most 256
+  int sources = 2048; // x, y, z and m of 2048 sources: 64 KB, about L2
+};
+
+// gravityDirect in cache-sized tiles, four targets at a time against each
+// source. The plain loop streams every source from memory once per target
+// and slows down once the bodies outgrow the caches (around 10^4); this one
+// stays compute bound.
+void gravityDirectTiled(size_t n, const double *x, const double *y,
+                        const double *z, const double *m, double G,
+                        double eps, double *ax, double *ay, double *az,
+                        const GravityTiles &tiles = GravityTiles(),
+                        const Executor &executor = Executor());
+
+// Times a dozen tile sizes on up to the first 512 targets against all n
+// sources and returns the fastest. That costs about a tenth of a full sum
+// at n = 10^5, so it pays off when the same n is summed many times.
+GravityTiles tuneGravityTiles(size_t n, const double *x, const double *y,
+                              const double *z, const double *m, double eps,
+                              const Executor &executor = Executor());
+
+// The same sum in single precision, written Vec3 style (like test.cpp's
+// pair loop) on Vec3x8 / Vec3x16 packets so 8 or 16 bodies are pulled per
+// instruction. Uses 16 lanes when built with AVX-512, 8 otherwise. sum
+// picks how each body's n terms are added up (see compensated.h); the
+// compensated ones win back most of what float loses to double.
+void gravityDirectPacked(size_t n, const float *x, const float *y,
+                         const float *z, const float *m, float G, float eps,
+                         float *ax, float *ay, float *az,
+                         FloatSum sum = defaultFloatSum,
+                         const Executor &executor = Executor());
+
+// The short-range part of the force for a split like r-RESPA's: each pair's
+// force weighed by a switch that is 1 out to cutoff / 2 and falls smoothly
+// (a cubic in r^2 with zero slope at both ends) to 0 at cutoff. Only pairs
+// closer than cutoff are visited, through a grid of cells cutoff wide, so
+// the cost grows with the neighbours per body rather than n. The full force minus
+// this is the smooth long-range part.
+void gravityShortRange(size_t n, const double *x, const double *y,
+                       const double *z, const double *m, double G, double eps,
+                       double cutoff, double *ax, double *ay, double *az,
+                       const Executor &executor = Executor());
+
+// Barnes-Hut octree, O(n log n). Cells that look smaller than theta radians
+// from a body act as a single mass at their centre of mass; theta = 0.5 keeps
+// typical force errors around a tenth of a percent.
+//
+// The tree is walked once per leaf rather than once per body: the walk
+// gathers everything that acts on the leaf's whole box into one interaction
+// list, and each body in the leaf then sums that list in a SIMD loop.
+class GravityTree {
+public:
+  void build(size_t n, const double *x, const double *y, const double *z,
+             const double *m);
+  void accelerations(double G, double eps, double theta, double *ax,
+                     double *ay, double *az,
+                     const Executor &executor = Executor()) const;
+
+  size_t nodeCount() const { return nodes.size(); }
+
+  // Puts each NUMA node's share of the tree-ordered bodies in its memory,
+  // split as Executor::nodeSplit. Leaves are walked in tree order, which is
+  // spatial order, so a node's threads walk its own region of space.
+  void placeOnNodes(const std::vector<int> &split);
+
+private:
+  struct Node {
+    double cx, cy, cz; // centre of mass
+    double mass;
+    double ox, oy, oz; // lowest corner of the cell
+    double size;       // edge length of the cell
+    int firstChild = -1, childCount = 0;
+    int begin = 0, end = 0; // bodies order[begin] .. order[end - 1]
+  };
+
+  void split(int node, double ox, double oy, double oz, double size,
+             int depth);
+
+  // bodies copied in tree order, so every leaf is a contiguous run
+  BigVector<double> bx, by, bz, bm;
+  BigVector<int> order;
+  BigVector<Node> nodes;
+  std::vector<int> leaves;
+};
@@ -0,0 +1,70 @@
+#include "hugepages.h"
+
+#include <atomic>
+#include <cstdint>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+std::atomic<HugePages> mode{HugePages::Transparent};
+
+constexpr size_t hugePage = size_t(2) << 20;
+
+size_t roundUp(size_t bytes) {
+  return (bytes + hugePage - 1) / hugePage * hugePage;
+}
+
+} // namespace
+
+void setHugePages(HugePages m) { mode = m; }
+HugePages hugePages() { return mode; }
+
+void *allocateHuge(size_t bytes) {
+#ifdef __linux__
+  const size_t length = roundUp(bytes);
+  const HugePages m = mode;
+#ifdef MAP_HUGETLB
+  if (m == HugePages::Explicit) {
+    void *p = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED)
+      return p;
+    // no pool reserved (vm.nr_hugepages) or it is used up
+  }
+#endif
+  // map a huge page more than needed and trim it to a 2 MB boundary, so
+  // every 2 MB of the array can become one huge page
+  void *raw = mmap(nullptr, length + hugePage, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED)
+    throw std::bad_alloc();
+  const uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+  const uintptr_t aligned = (start + hugePage - 1) / hugePage * hugePage;
+  if (aligned > start)
+    munmap(raw, aligned - start);
+  munmap(reinterpret_cast<void *>(aligned + length),
+         hugePage - (aligned - start));
+  void *p = reinterpret_cast<void *>(aligned);
+#ifdef MADV_HUGEPAGE
+  // fails harmlessly where transparent huge pages are off
+  if (m != HugePages::Off)
+    madvise(p, length, MADV_HUGEPAGE);
+#endif
+  return p;
+#else
+  return ::operator new(bytes);
+#endif
+}
+
+void freeHuge(void *p, size_t bytes) {
+#ifdef __linux__
+  // explicit and transparent mappings are both released with munmap
+  munmap(p, roundUp(bytes));
+#else
+  (void)bytes;
+  ::operator delete(p);
+#endif
+}
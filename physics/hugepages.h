@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Large body arrays and tree pools are walked in an order unrelated to
+// their layout, so with 4 KB pages nearly every access needs its own TLB
+// entry. Backing them with 2 MB pages cuts the entries needed by 512.
+enum class HugePages {
+  Off,         // ordinary pages
+  Transparent, // madvise(MADV_HUGEPAGE) and let the kernel promote them
+  Explicit,    // MAP_HUGETLB from the reserved pool, else Transparent
+};
+
+// Applies to allocations made after the call. Transparent by default.
+void setHugePages(HugePages mode);
+HugePages hugePages();
+
+// Allocations from this size up go to their own 2 MB-aligned mapping and
+// get huge pages; smaller ones come from operator new as usual.
+constexpr size_t hugePageThreshold = size_t(2) << 20;
+
+// Never returns null: falls back to ordinary pages, then throws bad_alloc.
+void *allocateHuge(size_t bytes);
+void freeHuge(void *p, size_t bytes);
+
+template <typename T> struct HugePageAllocator {
+  typedef T value_type;
+
+  HugePageAllocator() = default;
+  template <typename U> HugePageAllocator(const HugePageAllocator<U> &) {}
+
+  T *allocate(size_t n) {
+    if (n * sizeof(T) < hugePageThreshold)
+      return static_cast<T *>(::operator new(n * sizeof(T)));
+    return static_cast<T *>(allocateHuge(n * sizeof(T)));
+  }
+  void deallocate(T *p, size_t n) {
+    if (n * sizeof(T) < hugePageThreshold)
+      ::operator delete(p);
+    else
+      freeHuge(p, n * sizeof(T));
+  }
+
+  template <typename U> bool operator==(const HugePageAllocator<U> &) const {
+    return true;
+  }
+  template <typename U> bool operator!=(const HugePageAllocator<U> &) const {
+    return false;
+  }
+};
+
+// The array type for anything sized by the number of bodies.
+template <typename T> using BigVector = std::vector<T, HugePageAllocator<T>>;
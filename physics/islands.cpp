@@ -0,0 +1,139 @@
+#include "islands.h"
+
+#include <algorithm>
+#include <limits>
+
+void UnionFind::reset(size_t count) {
+  parent.resize(count);
+  setSize.assign(count, 1);
+  for (size_t i = 0; i < count; ++i)
+    parent[i] = int(i);
+}
+
+int UnionFind::find(int i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+void UnionFind::unite(int a, int b) {
+  a = find(a);
+  b = find(b);
+  if (a == b)
+    return;
+  if (setSize[a] < setSize[b])
+    std::swap(a, b);
+  parent[b] = a;
+  setSize[a] += setSize[b];
+}
+
+void SleepIslands::addBody(bool dynamic) {
+  int body = int(state.size());
+  state.push_back(dynamic ? awakeState : staticState);
+  restTime.push_back(0.0f);
+  if (dynamic)
+    awake.push_back(body);
+  setsReady = false;
+}
+
+void SleepIslands::clear() {
+  state.clear();
+  restTime.clear();
+  awake.clear();
+  sleeping.clear();
+  freeIslands.clear();
+  awakeDirty = false;
+  setsReady = false;
+}
+
+const std::vector<int> &SleepIslands::awakeBodies() {
+  if (awakeDirty) {
+    std::sort(awake.begin(), awake.end());
+    awakeDirty = false;
+  }
+  return awake;
+}
+
+bool SleepIslands::wake(int body) {
+  if (!isSleeping(body))
+    return false;
+  int island = state[body];
+  for (int b : sleeping[island]) {
+    state[b] = awakeState;
+    restTime[b] = 0.0f;
+    awake.push_back(b);
+  }
+  sleeping[island].clear();
+  freeIslands.push_back(island);
+  awakeDirty = true;
+  return true;
+}
+
+void SleepIslands::wakeAll() {
+  for (size_t island = 0; island < sleeping.size(); ++island) {
+    if (!sleeping[island].empty())
+      wake(sleeping[island].front());
+  }
+}
+
+void SleepIslands::rest(int body, bool resting, float dt) {
+  restTime[body] = resting ? restTime[body] + dt : 0.0f;
+}
+
+void SleepIslands::link(int a, int b) {
+  if (!setsReady) {
+    sets.reset(state.size());
+    setsReady = true;
+  }
+  if (isAwake(a) && isAwake(b))
+    sets.unite(a, b);
+}
+
+size_t SleepIslands::sleepIslands(const SleepSettings &settings) {
+  if (!setsReady) {
+    sets.reset(state.size());
+    setsReady = true;
+  }
+  setsReady = false;
+  if (!settings.enabled)
+    return 0;
+
+  const std::vector<int> &bodies = awakeBodies();
+
+  // the slowest-to-settle body decides for its whole island
+  std::vector<float> islandRest(state.size(),
+                                std::numeric_limits<float>::max());
+  for (int b : bodies) {
+    int root = sets.find(b);
+    islandRest[root] = std::min(islandRest[root], restTime[b]);
+  }
+
+  std::vector<int> islandOf(state.size(), -1);
+  size_t slept = 0;
+  for (int b : bodies) {
+    int root = sets.find(b);
+    if (islandRest[root] < settings.timeToSleep)
+      continue;
+    if (islandOf[root] < 0) {
+      if (freeIslands.empty()) {
+        islandOf[root] = int(sleeping.size());
+        sleeping.emplace_back();
+      } else {
+        islandOf[root] = freeIslands.back();
+        freeIslands.pop_back();
+      }
+    }
+    state[b] = islandOf[root];
+    sleeping[islandOf[root]].push_back(b);
+    ++slept;
+  }
+
+  if (slept > 0) {
+    awake.erase(std::remove_if(awake.begin(), awake.end(),
+                               [&](int b) { return !isAwake(b); }),
+                awake.end());
+  }
+  return slept;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Disjoint sets with path halving and union by size.
+class UnionFind {
+public:
+  void reset(size_t count);
+  int find(int i);
+  void unite(int a, int b);
+
+private:
+  std::vector<int> parent;
+  std::vector<int> setSize;
+};
+
+struct SleepSettings {
+  bool enabled = true;
+  float linearTolerance = 0.01f;  // bodies slower than this count as resting
+  float angularTolerance = 0.1f;  // rad/s
+  float timeToSleep = 0.5f;       // seconds an island must rest to sleep
+};
+
+// Tracks which bodies are awake, independent of any one engine. Awake bodies
+// that touch are joined into islands each step (union-find over the contact
+// pairs the engine reports); once every body in an island has rested for
+// timeToSleep the whole island goes to sleep, and it only wakes again as a
+// whole when something touches one of its bodies.
+//
+// Each step the engine should:
+//   1. wake() any sleeping body an awake body comes close to,
+//   2. integrate and solve only awakeBodies(),
+//   3. rest() every awake body and link() every contact between two
+//      dynamic bodies, then call sleepIslands().
+class SleepIslands {
+public:
+  // New bodies start awake; static bodies never move and never sleep.
+  void addBody(bool dynamic);
+  void clear();
+  size_t size() const { return state.size(); }
+
+  bool isAwake(int body) const { return state[body] == awakeState; }
+  bool isSleeping(int body) const { return state[body] >= 0; }
+  bool isStatic(int body) const { return state[body] == staticState; }
+
+  // Dynamic awake bodies in ascending order.
+  const std::vector<int> &awakeBodies();
+
+  // Wakes the island a sleeping body belongs to. Returns false if the body
+  // wasn't asleep.
+  bool wake(int body);
+  void wakeAll();
+
+  void rest(int body, bool resting, float dt);
+  void link(int a, int b);
+
+  // Puts islands that have rested long enough to sleep and returns how many
+  // bodies fell asleep.
+  size_t sleepIslands(const SleepSettings &settings);
+
+private:
+  static constexpr int awakeState = -1;
+  static constexpr int staticState = -2;
+
+  // awakeState, staticState, or the sleeping island the body belongs to
+  std::vector<int> state;
+  std::vector<float> restTime;
+  std::vector<int> awake;
+  bool awakeDirty = false;
+
+  UnionFind sets;
+  bool setsReady = false;
+
+  std::vector<std::vector<int>> sleeping; // bodies per sleeping island
+  std::vector<int> freeIslands;
+};
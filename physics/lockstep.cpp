@@ -0,0 +1,402 @@
+#include "lockstep.h"
+
+#include <algorithm>
+
+template <typename F>
+FixedCircleWorld<F>::FixedCircleWorld(const FixedCircleWorldParams<F> &params)
+    : params(params) {}
+
+template <typename F>
+int FixedCircleWorld<F>::addCircle(F px, F py, F pvx, F pvy, F r, F mass) {
+  x.push_back(px);
+  y.push_back(py);
+  vx.push_back(pvx);
+  vy.push_back(pvy);
+  spin.push_back(F());
+  radius.push_back(r);
+  invMass.push_back(mass > F() ? F::fromInt(1) / mass : F());
+  maxRadius = fixedMax(maxRadius, r);
+  return int(x.size()) - 1;
+}
+
+template <typename F> void FixedCircleWorld<F>::clear() {
+  x.clear();
+  y.clear();
+  vx.clear();
+  vy.clear();
+  spin.clear();
+  radius.clear();
+  invMass.clear();
+  current.clear();
+  previous.clear();
+  maxRadius = F();
+  accumulator = 0.0f;
+  steps = 0;
+}
+
+template <typename F>
+void FixedCircleWorld<F>::applyInputs(std::vector<LockstepInput> inputs) {
+  std::sort(inputs.begin(), inputs.end(),
+            [](const LockstepInput &l, const LockstepInput &r) {
+              return l.peer != r.peer ? l.peer < r.peer
+                                      : l.sequence < r.sequence;
+            });
+  using Raw = typename F::RawType;
+  for (const LockstepInput &in : inputs) {
+    switch (in.kind) {
+    case LockstepInput::AddCircle:
+      addCircle(F::fromRaw(Raw(in.x)), F::fromRaw(Raw(in.y)),
+                F::fromRaw(Raw(in.vx)), F::fromRaw(Raw(in.vy)),
+                F::fromRaw(Raw(in.radius)));
+      break;
+    case LockstepInput::Push:
+      // static circles stay put, whatever a peer sends
+      if (in.body >= 0 && in.body < int(size()) && invMass[in.body] > F()) {
+        vx[in.body] += F::fromRaw(Raw(in.vx));
+        vy[in.body] += F::fromRaw(Raw(in.vy));
+      }
+      break;
+    }
+  }
+}
+
+template <typename F> int FixedCircleWorld<F>::update(float frameTime) {
+  const float dt = params.fixedDt.toFloat();
+  accumulator += frameTime;
+  int taken = 0;
+  while (accumulator >= dt && taken < params.maxSubSteps) {
+    step();
+    accumulator -= dt;
+    ++taken;
+  }
+  if (taken == params.maxSubSteps)
+    accumulator = std::min(accumulator, dt);
+  return taken;
+}
+
+template <typename F> void FixedCircleWorld<F>::step() {
+  ++steps;
+  buildGrid();
+  findContacts();
+  prepareContacts();
+
+  const int subSteps = std::max(1, params.solverSubSteps);
+  const F h = params.fixedDt / F::fromInt(subSteps);
+  const int n = int(size());
+
+  // same spring as CircleWorld::solveContacts(), worked out once per step
+  Softness soft;
+  F hertz = fixedMin(params.contactHertz, F::fromRatio(1, 4) / h);
+  F omega = F::fromRatio(2 * 314159265, 100000000) * hertz;
+  F a1 = F::fromInt(2) * params.contactDampingRatio + h * omega;
+  F a2 = h * omega * a1;
+  F a3 = F::fromInt(1) / (F::fromInt(1) + a2);
+  soft.biasRate = omega / a1;
+  soft.massScale = a2 * a3;
+  soft.impulseScale = a3;
+
+  const F gx = params.gravityX * h;
+  const F gy = params.gravityY * h;
+  for (int sub = 0; sub < subSteps; ++sub) {
+    for (int i = 0; i < n; ++i) {
+      if (invMass[i] > F()) {
+        vx[i] += gx;
+        vy[i] += gy;
+      }
+    }
+    warmStart();
+    for (FixedCircleContact<F> &c : current)
+      solveContact(c, h, true, soft);
+    for (int i = 0; i < n; ++i) {
+      if (invMass[i] > F()) {
+        x[i] += vx[i] * h;
+        y[i] += vy[i] * h;
+      }
+    }
+    for (FixedCircleContact<F> &c : current)
+      solveContact(c, h, false, soft);
+  }
+  applyRestitution();
+}
+
+template <typename F> uint64_t FixedCircleWorld<F>::checksum() const {
+  uint64_t hash = 14695981039346656037ull;
+  auto mix = [&](const std::vector<F> &values) {
+    for (F v : values) {
+      uint64_t bits = uint64_t(v.raw);
+      for (size_t byte = 0; byte < sizeof(v.raw); ++byte) {
+        hash ^= (bits >> (8 * byte)) & 0xff;
+        hash *= 1099511628211ull;
+      }
+    }
+  };
+  mix(x);
+  mix(y);
+  mix(vx);
+  mix(vy);
+  mix(spin);
+  return hash;
+}
+
+template <typename F> int FixedCircleWorld<F>::cellOf(F px, F py) const {
+  // integer part of the cell coordinate
+  int cx = int(((px - params.minX) / cellSize).raw >> F::fracBits);
+  int cy = int(((py - params.minY) / cellSize).raw >> F::fracBits);
+  cx = std::clamp(cx, 0, gridW - 1);
+  cy = std::clamp(cy, 0, gridH - 1);
+  return cy * gridW + cx;
+}
+
+template <typename F> void FixedCircleWorld<F>::buildGrid() {
+  const int n = int(size());
+  cellSize = fixedMax(F::fromInt(2) * maxRadius *
+                          (F::fromInt(1) + params.speculativeMargin),
+                      F::fromRaw(1));
+  auto cellsAcross = [&](F extent) {
+    F cells = extent / cellSize;
+    return std::max(1, int(cells.raw >> F::fracBits) + 1);
+  };
+  gridW = cellsAcross(params.maxX - params.minX);
+  gridH = cellsAcross(params.maxY - params.minY);
+  const int cells = gridW * gridH;
+
+  cellStart.assign(cells + 1, 0);
+  bodyCell.resize(n);
+  for (int i = 0; i < n; ++i) {
+    bodyCell[i] = cellOf(x[i], y[i]);
+    ++cellStart[bodyCell[i] + 1];
+  }
+  for (int c = 0; c < cells; ++c)
+    cellStart[c + 1] += cellStart[c];
+
+  // filled in body order, so each cell lists its bodies ascending
+  cellBodies.resize(n);
+  std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+  for (int i = 0; i < n; ++i)
+    cellBodies[fill[bodyCell[i]]++] = i;
+}
+
+template <typename F> void FixedCircleWorld<F>::findContacts() {
+  const int n = int(size());
+  const F margin = F::fromInt(1) + params.speculativeMargin;
+  const FixedCircleWorldParams<F> &p = params;
+
+  previous.swap(current);
+  current.clear();
+  std::vector<int> near;
+
+  for (int i = 0; i < n; ++i) {
+    if (invMass[i] == F())
+      continue;
+    const int cx = bodyCell[i] % gridW, cy = bodyCell[i] / gridW;
+
+    // dynamic neighbours pair up once, from the lower index; static ones
+    // only ever pair from the dynamic side
+    near.clear();
+    for (int ny = std::max(cy - 1, 0); ny <= std::min(cy + 1, gridH - 1); ++ny) {
+      for (int nx = std::max(cx - 1, 0); nx <= std::min(cx + 1, gridW - 1);
+           ++nx) {
+        int nc = ny * gridW + nx;
+        for (int k = cellStart[nc]; k < cellStart[nc + 1]; ++k) {
+          int j = cellBodies[k];
+          if (j == i || (j < i && invMass[j] > F()))
+            continue;
+          near.push_back(j);
+        }
+      }
+    }
+    std::sort(near.begin(), near.end());
+
+    for (int j : near) {
+      F dx = x[j] - x[i];
+      F dy = y[j] - y[i];
+      F reach = (radius[i] + radius[j]) * margin;
+      if (fixedLengthSquaredRaw(dx, dy) >= fixedLengthSquaredRaw(reach, F()))
+        continue;
+      FixedCircleContact<F> c{};
+      c.a = std::min(i, j);
+      c.b = std::max(i, j);
+      if (j < i) {
+        dx = -dx;
+        dy = -dy;
+      }
+      F d = fixedLength(dx, dy);
+      if (d > F()) {
+        c.nx = dx / d;
+        c.ny = dy / d;
+      } else {
+        c.ny = F::fromInt(1);
+      }
+      current.push_back(c);
+    }
+
+    // walls in key order, as in CircleWorld::findContacts()
+    auto wall = [&](int id, F nx, F ny) {
+      FixedCircleContact<F> c{};
+      c.a = i;
+      c.b = -1 - id;
+      c.nx = nx;
+      c.ny = ny;
+      current.push_back(c);
+    };
+    const F one = F::fromInt(1);
+    F reach = radius[i] * margin;
+    if (y[i] + reach > p.maxY)
+      wall(3, F(), one);
+    if (y[i] - reach < p.minY)
+      wall(2, F(), -one);
+    if (x[i] + reach > p.maxX)
+      wall(1, one, F());
+    if (x[i] - reach < p.minX)
+      wall(0, -one, F());
+  }
+
+  // a static circle below i pairs as (static, i), which can land out of
+  // order; everything else is already sorted
+  auto byKey = [](const FixedCircleContact<F> &l,
+                  const FixedCircleContact<F> &r) { return l.key() < r.key(); };
+  if (!std::is_sorted(current.begin(), current.end(), byKey))
+    std::sort(current.begin(), current.end(), byKey);
+
+  // carry impulses over from last step's matching contacts
+  size_t j = 0;
+  for (FixedCircleContact<F> &c : current) {
+    uint64_t k = c.key();
+    while (j < previous.size() && previous[j].key() < k)
+      ++j;
+    if (j < previous.size() && previous[j].key() == k) {
+      c.normalImpulse = previous[j].normalImpulse;
+      c.tangentImpulse = previous[j].tangentImpulse;
+    }
+  }
+}
+
+template <typename F> void FixedCircleWorld<F>::prepareContacts() {
+  for (FixedCircleContact<F> &c : current) {
+    F imb, vbx, vby;
+    if (c.b >= 0) {
+      imb = invMass[c.b];
+      vbx = vx[c.b];
+      vby = vy[c.b];
+    }
+    // For a disc the tangential impulse changes surface speed by twice what
+    // it changes velocity, so the tangent mass is a third of the normal one.
+    F kn = invMass[c.a] + imb;
+    F kt = F::fromInt(3) * kn;
+    c.normalMass = kn > F() ? F::fromInt(1) / kn : F();
+    c.tangentMass = kt > F() ? F::fromInt(1) / kt : F();
+    c.approachSpeed = (vbx - vx[c.a]) * c.nx + (vby - vy[c.a]) * c.ny;
+  }
+}
+
+template <typename F> void FixedCircleWorld<F>::warmStart() {
+  const F two = F::fromInt(2);
+  for (const FixedCircleContact<F> &c : current) {
+    F tx = -c.ny, ty = c.nx;
+    F px = c.nx * c.normalImpulse + tx * c.tangentImpulse;
+    F py = c.ny * c.normalImpulse + ty * c.tangentImpulse;
+    vx[c.a] -= invMass[c.a] * px;
+    vy[c.a] -= invMass[c.a] * py;
+    spin[c.a] -= two * invMass[c.a] * c.tangentImpulse;
+    if (c.b >= 0) {
+      vx[c.b] += invMass[c.b] * px;
+      vy[c.b] += invMass[c.b] * py;
+      spin[c.b] -= two * invMass[c.b] * c.tangentImpulse;
+    }
+  }
+}
+
+template <typename F>
+void FixedCircleWorld<F>::solveContact(FixedCircleContact<F> &c, F h,
+                                       bool useBias, const Softness &soft) {
+  const int a = c.a, b = c.b;
+  const F nx = c.nx, ny = c.ny;
+  const F tx = -ny, ty = nx;
+  const F ima = invMass[a];
+  const F two = F::fromInt(2);
+  const FixedCircleWorldParams<F> &p = params;
+
+  F imb, vbx, vby, sb;
+  F separation;
+  if (b >= 0) {
+    imb = invMass[b];
+    vbx = vx[b];
+    vby = vy[b];
+    sb = spin[b];
+    separation = (x[b] - x[a]) * nx + (y[b] - y[a]) * ny - radius[a] -
+                 radius[b];
+  } else {
+    F wallPos[4] = {-p.minX, p.maxX, -p.minY, p.maxY};
+    separation = wallPos[-1 - b] - (x[a] * nx + y[a] * ny) - radius[a];
+  }
+  F vax = vx[a], vay = vy[a], sa = spin[a];
+
+  F bias, massScale = F::fromInt(1), impulseScale;
+  if (separation > F()) {
+    bias = separation / h;
+  } else if (useBias) {
+    bias = fixedMax(soft.biasRate * separation, -p.maxPushout);
+    massScale = soft.massScale;
+    impulseScale = soft.impulseScale;
+  }
+
+  F vn = (vbx - vax) * nx + (vby - vay) * ny;
+  F jn = -c.normalMass * massScale * (vn + bias) -
+         impulseScale * c.normalImpulse;
+  F oldN = c.normalImpulse;
+  c.normalImpulse = fixedMax(oldN + jn, F());
+  jn = c.normalImpulse - oldN;
+
+  vax -= ima * nx * jn;
+  vay -= ima * ny * jn;
+  vbx += imb * nx * jn;
+  vby += imb * ny * jn;
+
+  F vt = (vbx - vax) * tx + (vby - vay) * ty - sb - sa;
+  F jt = -vt * c.tangentMass;
+  F maxFriction = p.friction * c.normalImpulse;
+  F oldT = c.tangentImpulse;
+  c.tangentImpulse = fixedClamp(oldT + jt, -maxFriction, maxFriction);
+  jt = c.tangentImpulse - oldT;
+
+  vx[a] = vax - ima * tx * jt;
+  vy[a] = vay - ima * ty * jt;
+  spin[a] = sa - two * ima * jt;
+  if (b >= 0) {
+    vx[b] = vbx + imb * tx * jt;
+    vy[b] = vby + imb * ty * jt;
+    spin[b] = sb - two * imb * jt;
+  }
+}
+
+template <typename F> void FixedCircleWorld<F>::applyRestitution() {
+  const F e = params.restitution;
+  if (e == F())
+    return;
+  for (FixedCircleContact<F> &c : current) {
+    if (c.approachSpeed > -params.restitutionThreshold ||
+        c.normalImpulse == F())
+      continue;
+    const int a = c.a, b = c.b;
+    F imb, vbx, vby;
+    if (b >= 0) {
+      imb = invMass[b];
+      vbx = vx[b];
+      vby = vy[b];
+    }
+    F vn = (vbx - vx[a]) * c.nx + (vby - vy[a]) * c.ny;
+    F jn = -c.normalMass * (vn + e * c.approachSpeed);
+    F oldN = c.normalImpulse;
+    c.normalImpulse = fixedMax(oldN + jn, F());
+    jn = c.normalImpulse - oldN;
+    vx[a] -= invMass[a] * c.nx * jn;
+    vy[a] -= invMass[a] * c.ny * jn;
+    if (b >= 0) {
+      vx[b] += imb * c.nx * jn;
+      vy[b] += imb * c.ny * jn;
+    }
+  }
+}
+
+template class FixedCircleWorld<Fixed16>;
+template class FixedCircleWorld<Fixed32>;
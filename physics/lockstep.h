@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "fixed.h"
+
+// Settings for a FixedCircleWorld, with the same meaning and defaults as
+// CircleWorldParams. Written as ratios so every peer builds bit-identical
+// values.
+template <typename F> struct FixedCircleWorldParams {
+  F gravityX = F();
+  F gravityY = F::fromInt(-1);
+
+  F minX = F::fromRatio(-17, 10);
+  F maxX = F::fromRatio(17, 10);
+  F minY = F::fromInt(-1);
+  F maxY = F::fromInt(1);
+
+  F fixedDt = F::fromRatio(1, 60);
+  int maxSubSteps = 4;
+  int solverSubSteps = 4;
+
+  F friction = F::fromRatio(2, 5);
+  F restitution = F::fromRatio(1, 5);
+  F restitutionThreshold = F::fromRatio(1, 20);
+
+  F contactHertz = F::fromInt(60);
+  F contactDampingRatio = F::fromInt(10);
+  F maxPushout = F::fromRatio(1, 2);
+  F speculativeMargin = F::fromRatio(1, 10);
+};
+
+template <typename F> struct FixedCircleContact {
+  int a, b; // b < 0 is a wall, -1 - wall index, as in CircleContact
+  F nx, ny;
+
+  F normalImpulse, tangentImpulse;
+  F normalMass, tangentMass;
+  F approachSpeed;
+
+  uint64_t key() const {
+    return (uint64_t(uint32_t(a)) << 32) | uint64_t(uint32_t(b));
+  }
+};
+
+// Something a peer did during one frame. Lockstep peers only send each other
+// these; every peer applies the same inputs before the same step and so
+// computes the same world. Values are raw fixed-point numbers in the world's
+// format so they go over the wire as plain integers.
+struct LockstepInput {
+  enum Kind : uint8_t { AddCircle, Push };
+
+  // inputs for a frame are applied in (peer, sequence) order, whatever order
+  // they arrived in
+  uint32_t peer = 0;
+  uint32_t sequence = 0;
+  Kind kind = AddCircle;
+
+  int32_t body = -1; // circle to push
+  int64_t x = 0, y = 0;
+  int64_t vx = 0, vy = 0; // initial velocity, or the change for a push
+  int64_t radius = 0;
+};
+
+// The circle engine of circles.h in fixed-point, for lockstep sessions where
+// several processes simulate the same scene. All maths is integer, every loop
+// runs in a fixed order on one thread and there is no floating point anywhere
+// in a step, so two worlds that start equal and see the same inputs stay
+// bit-identical on any compiler or machine; checksum() lets peers confirm it.
+//
+// It keeps the speculative contacts, warm-started soft-step solver and
+// restitution pass of CircleWorld but leaves out sleeping, continuous
+// collision and threading. Circles carry a mass instead of a density, which
+// keeps the numbers in a comfortable range for Q16.16, and spin is stored as
+// surface speed (angular velocity times radius) for the same reason.
+template <typename F> class FixedCircleWorld {
+public:
+  explicit FixedCircleWorld(
+      const FixedCircleWorldParams<F> &params = FixedCircleWorldParams<F>());
+
+  // mass <= 0 makes a static circle
+  int addCircle(F x, F y, F vx, F vy, F radius, F mass = F::fromInt(1));
+  size_t size() const { return x.size(); }
+  void clear();
+
+  // Applies one frame's inputs from all peers. Call before that frame's
+  // step() on every peer.
+  void applyInputs(std::vector<LockstepInput> inputs);
+
+  // Fixed steps for drawing at the screen's frame rate. The step count is
+  // decided by the (float) frame time and so differs between peers; only
+  // stepCount() and the state after it are shared.
+  int update(float frameTime);
+  void step();
+  uint64_t stepCount() const { return steps; }
+
+  // FNV-1a over the raw state; peers that compare equal are in sync
+  uint64_t checksum() const;
+
+  FixedCircleWorldParams<F> params;
+
+  std::vector<F> x, y;
+  std::vector<F> vx, vy;
+  std::vector<F> spin; // angular velocity times radius
+  std::vector<F> radius;
+  std::vector<F> invMass;
+
+  const std::vector<FixedCircleContact<F>> &contacts() const {
+    return current;
+  }
+
+private:
+  struct Softness {
+    F biasRate, massScale, impulseScale;
+  };
+
+  void buildGrid();
+  int cellOf(F px, F py) const;
+  void findContacts();
+  void prepareContacts();
+  void warmStart();
+  void solveContact(FixedCircleContact<F> &c, F h, bool useBias,
+                    const Softness &soft);
+  void applyRestitution();
+
+  float accumulator = 0.0f;
+  uint64_t steps = 0;
+  F maxRadius;
+
+  F cellSize;
+  int gridW = 0, gridH = 0;
+  std::vector<int> cellStart;
+  std::vector<int> cellBodies;
+  std::vector<int> bodyCell;
+
+  // both sorted by key, for carrying impulses over
+  std::vector<FixedCircleContact<F>> current, previous;
+};
+
+extern template class FixedCircleWorld<Fixed16>;
+extern template class FixedCircleWorld<Fixed32>;
@@ -0,0 +1,55 @@
+#include "models.h"
+
+#include <cmath>
+
+void addPlummerSphere(BodyStore &bodies, size_t n, double mass, double radius,
+                      double G, uint32_t seed) {
+  uint32_t state = seed ? seed : 1;
+  auto random = [&]() {
+    // xorshift32, uniform in (0, 1)
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (double(state) + 0.5) / 4294967296.0;
+  };
+  auto direction = [&](double length, double &x, double &y, double &z) {
+    double cosTheta = 2.0 * random() - 1.0;
+    double sinTheta = std::sqrt(1.0 - cosTheta * cosTheta);
+    double phi = 2.0 * 3.14159265358979323846 * random();
+    x = length * sinTheta * std::cos(phi);
+    y = length * sinTheta * std::sin(phi);
+    z = length * cosTheta;
+  };
+
+  const double m = n ? mass / double(n) : 0.0;
+  const double speedScale = std::sqrt(G * mass / radius);
+  for (size_t i = 0; i < n; ++i) {
+    // radius from the cumulative mass profile, cut off at 10 scale radii
+    double r;
+    do {
+      r = 1.0 / std::sqrt(std::pow(random(), -2.0 / 3.0) - 1.0);
+    } while (r > 10.0);
+
+    // speed by rejection from g(q) = q^2 (1 - q^2)^(7/2), q = v / v_escape
+    double q, g;
+    do {
+      q = random();
+      g = 0.1 * random();
+    } while (g > q * q * std::pow(1.0 - q * q, 3.5));
+    double speed = q * std::sqrt(2.0) * std::pow(1.0 + r * r, -0.25);
+
+    double x, y, z, vx, vy, vz;
+    direction(r * radius, x, y, z);
+    direction(speed * speedScale, vx, vy, vz);
+    bodies.add(x, y, z, vx, vy, vz, m);
+  }
+}
+
+void addThreeBodies(BodyStore &bodies, double mass, double scale, double G) {
+  // test.cpp launches its outer bodies at 0.87 of the speed of a circular
+  // orbit around the middle one
+  double speed = 0.8655 * std::sqrt(G * mass / (2.0 * scale));
+  bodies.add(0.0, 0.0, 0.0, 0.0, 0.0, 0.0, mass, 0.1 * scale);
+  bodies.add(2.0 * scale, 0.0, 0.0, 0.0, speed, 0.0, mass, 0.1 * scale);
+  bodies.add(0.0, 2.0 * scale, 0.0, 0.0, -speed, 0.0, mass, 0.1 * scale);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "nbody.h"
+
+// Ready-made initial conditions for the runner, benchmarks and viewers.
+
+// A Plummer sphere in virial equilibrium: n bodies of total mass with the
+// given scale radius, positions and velocities drawn as in Aarseth, Henon &
+// Wielen (1974). Same seed, same sphere.
+void addPlummerSphere(BodyStore &bodies, size_t n, double mass, double radius,
+                      double G, uint32_t seed = 1);
+
+// test.cpp's three equal masses, scaled: one at rest at the origin and two
+// at distance 2 * scale moving sideways.
+void addThreeBodies(BodyStore &bodies, double mass, double scale, double G);
@@ -0,0 +1,321 @@
+#include "nbody.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+int BodyStore::add(double px, double py, double pz, double pvx, double pvy,
+                   double pvz, double m, double r) {
+  x.push_back(px);
+  y.push_back(py);
+  z.push_back(pz);
+  vx.push_back(pvx);
+  vy.push_back(pvy);
+  vz.push_back(pvz);
+  mass.push_back(m);
+  radius.push_back(r);
+  return int(x.size()) - 1;
+}
+
+void BodyStore::clear() {
+  for (auto *v : {&x, &y, &z, &vx, &vy, &vz, &mass, &radius})
+    v->clear();
+}
+
+namespace {
+
+// Spreads the low 21 bits of v out to every third bit.
+uint64_t spreadBits(uint64_t v) {
+  v &= 0x1fffff;
+  v = (v | v << 32) & 0x1f00000000ffffull;
+  v = (v | v << 16) & 0x1f0000ff0000ffull;
+  v = (v | v << 8) & 0x100f00f00f00f00full;
+  v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+  v = (v | v << 2) & 0x1249249249249249ull;
+  return v;
+}
+
+} // namespace
+
+std::vector<uint64_t> spatialKeys(size_t n, const double *x, const double *y,
+                                  const double *z) {
+  std::vector<uint64_t> key(n);
+  if (n == 0)
+    return key;
+  double lo[3] = {x[0], y[0], z[0]}, hi[3] = {x[0], y[0], z[0]};
+  for (size_t i = 1; i < n; ++i) {
+    lo[0] = std::min(lo[0], x[i]);
+    lo[1] = std::min(lo[1], y[i]);
+    lo[2] = std::min(lo[2], z[i]);
+    hi[0] = std::max(hi[0], x[i]);
+    hi[1] = std::max(hi[1], y[i]);
+    hi[2] = std::max(hi[2], z[i]);
+  }
+  const double size =
+      std::max({hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2], 1e-300});
+  const double scale = double(0x1fffff) / size;
+  for (size_t i = 0; i < n; ++i)
+    key[i] = spreadBits(uint64_t((x[i] - lo[0]) * scale)) |
+             spreadBits(uint64_t((y[i] - lo[1]) * scale)) << 1 |
+             spreadBits(uint64_t((z[i] - lo[2]) * scale)) << 2;
+  return key;
+}
+
+std::vector<int> spatialOrder(size_t n, const double *x, const double *y,
+                              const double *z) {
+  const std::vector<uint64_t> key = spatialKeys(n, x, y, z);
+  std::vector<int> order(n);
+  for (size_t i = 0; i < n; ++i)
+    order[i] = int(i);
+  std::sort(order.begin(), order.end(),
+            [&](int a, int b) { return key[a] < key[b]; });
+  return order;
+}
+
+std::vector<int> BodyStore::sortBySpatialKey() {
+  const size_t n = size();
+  std::vector<int> order = spatialOrder(n, x.data(), y.data(), z.data());
+  std::vector<double> sorted(n);
+  for (auto *v : {&x, &y, &z, &vx, &vy, &vz, &mass, &radius}) {
+    for (size_t i = 0; i < n; ++i)
+      sorted[i] = (*v)[order[i]];
+    // copy back rather than swap, so the arrays keep their memory (and
+    // the C API's pointers into it)
+    std::copy(sorted.begin(), sorted.end(), v->begin());
+  }
+  return order;
+}
+
+NBodySystem::NBodySystem(const NBodyParams &params) : params(params) {}
+
+int NBodySystem::addBody(double x, double y, double z, double vx, double vy,
+                         double vz, double mass, double radius) {
+  return bodies.add(x, y, z, vx, vy, vz, mass, radius);
+}
+
+void NBodySystem::computeAccelerations() {
+  const size_t n = size();
+  ax.resize(n);
+  ay.resize(n);
+  az.resize(n);
+  if (n == 0)
+    return;
+
+  bool direct = params.solver == GravitySolver::Direct ||
+                (params.solver == GravitySolver::Auto &&
+                 n < params.directLimit);
+  const BodyStore &b = bodies;
+  const Executor &executor = currentExecutor();
+  if (direct) {
+    gravityDirectTiled(n, b.x.data(), b.y.data(), b.z.data(), b.mass.data(),
+                       params.G, params.softening, ax.data(), ay.data(),
+                       az.data(), params.tiles, executor);
+  } else {
+    tree.build(n, b.x.data(), b.y.data(), b.z.data(), b.mass.data());
+    if (executor.numaAware() && placedTree != n) {
+      tree.placeOnNodes(executor.nodeSplit());
+      placedTree = n;
+    }
+    tree.accelerations(params.G, params.softening, params.theta, ax.data(),
+                       ay.data(), az.data(), executor);
+  }
+}
+
+const Executor &NBodySystem::refreshedExecutor() const {
+  // params may have been changed since the last step
+  if (executor.backend() != params.backend ||
+      executor.requestedThreads() != params.threads ||
+      executor.numaAware() != (params.numa &&
+                               params.backend == Backend::ThreadPool)) {
+    executor = Executor(params.backend, params.threads, params.numa);
+    placedBodies = placedTree = 0;
+  }
+  return executor;
+}
+
+const Executor &NBodySystem::currentExecutor() {
+  refreshedExecutor();
+  // Each node's threads drift, kick and write forces for the same slice of
+  // bodies every step, so their pages belong in that node's memory.
+  if (executor.numaAware() && placedBodies != size()) {
+    const std::vector<int> split = executor.nodeSplit();
+    BodyStore &b = bodies;
+    ax.resize(size());
+    ay.resize(size());
+    az.resize(size());
+    for (BigVector<double> *v :
+         {&b.x, &b.y, &b.z, &b.vx, &b.vy, &b.vz, &b.mass, &ax, &ay, &az})
+      placeOnNodes(v->data(), v->size(), sizeof(double), split);
+    placedBodies = size();
+  }
+  return executor;
+}
+
+void NBodySystem::drift(double dt) {
+  double *x = bodies.x.data(), *y = bodies.y.data(), *z = bodies.z.data();
+  const double *vx = bodies.vx.data(), *vy = bodies.vy.data(),
+               *vz = bodies.vz.data();
+  currentExecutor().forRange(size(), 4096, [&](size_t begin, size_t end) {
+#pragma omp simd
+    for (size_t i = begin; i < end; ++i) {
+      x[i] += vx[i] * dt;
+      y[i] += vy[i] * dt;
+      z[i] += vz[i] * dt;
+    }
+  });
+}
+
+void NBodySystem::kick(double dt) { kick(dt, ax, ay, az); }
+
+void NBodySystem::kick(double dt, const BigVector<double> &fx,
+                       const BigVector<double> &fy,
+                       const BigVector<double> &fz) {
+  double *vx = bodies.vx.data(), *vy = bodies.vy.data(),
+         *vz = bodies.vz.data();
+  const double *gx = fx.data(), *gy = fy.data(), *gz = fz.data();
+  currentExecutor().forRange(size(), 4096, [&](size_t begin, size_t end) {
+#pragma omp simd
+    for (size_t i = begin; i < end; ++i) {
+      vx[i] += gx[i] * dt;
+      vy[i] += gy[i] * dt;
+      vz[i] += gz[i] * dt;
+    }
+  });
+}
+
+void NBodySystem::step(double dt) {
+  // Forces are always taken at the current positions, so callers are free
+  // to move, add or reweigh bodies between steps.
+  switch (params.integrator) {
+  case Integrator::Euler:
+    computeAccelerations();
+    kick(dt);
+    drift(dt);
+    break;
+  case Integrator::Leapfrog: {
+    // one stage for the plain leapfrog; the half drifts between stages
+    // merge
+    const CompositionWeights c = compositionWeights(params.composition);
+    drift(0.5 * c.w[0] * dt);
+    for (int k = 0; k < c.stages; ++k) {
+      computeAccelerations();
+      kick(c.w[k] * dt);
+      drift(0.5 * (c.w[k] + (k + 1 < c.stages ? c.w[k + 1] : 0.0)) * dt);
+    }
+    break;
+  }
+  case Integrator::Respa:
+    stepRespa(dt);
+    break;
+  }
+  time += dt;
+}
+
+double NBodySystem::respaRadius() const {
+  if (params.respaCutoff > 0.0)
+    return params.respaCutoff;
+  const BodyStore &b = bodies;
+  const size_t n = size();
+  double mass = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    mass += b.mass[i];
+    cx += b.mass[i] * b.x[i];
+    cy += b.mass[i] * b.y[i];
+    cz += b.mass[i] * b.z[i];
+  }
+  if (mass > 0.0)
+    cx /= mass, cy /= mass, cz /= mass;
+  std::vector<double> r2(n);
+  for (size_t i = 0; i < n; ++i) {
+    double dx = b.x[i] - cx, dy = b.y[i] - cy, dz = b.z[i] - cz;
+    r2[i] = dx * dx + dy * dy + dz * dz;
+  }
+  std::nth_element(r2.begin(), r2.begin() + n / 2, r2.end());
+  // n / 2 bodies within the median radius, so 32 within
+  // median * (32 / (n / 2))^(1/3) on average
+  return std::sqrt(r2[n / 2]) * std::cbrt(64.0 / double(n));
+}
+
+void NBodySystem::stepRespa(double dt) {
+  const size_t n = size();
+  if (n == 0)
+    return;
+  const int substeps = std::max(params.respaSubsteps, 1);
+  const double h = dt / substeps;
+  const BodyStore &b = bodies;
+  // first step, or the bodies or time changed since the last one
+  const bool fresh = longTime != time || longX.size() != n;
+  for (BigVector<double> *v : {&shortX, &shortY, &shortZ, &longX, &longY,
+                               &longZ, &ax, &ay, &az})
+    v->resize(n);
+  auto shortRange = [&] {
+    gravityShortRange(n, b.x.data(), b.y.data(), b.z.data(), b.mass.data(),
+                      params.G, params.softening, cutoff, shortX.data(),
+                      shortY.data(), shortZ.data(), currentExecutor());
+  };
+  // the full force minus the short part just taken, at the same positions
+  auto longRange = [&](double at) {
+    computeAccelerations();
+    for (size_t i = 0; i < n; ++i) {
+      longX[i] = ax[i] - shortX[i];
+      longY[i] = ay[i] - shortY[i];
+      longZ[i] = az[i] - shortZ[i];
+    }
+    longTime = at;
+  };
+
+  if (fresh) {
+    cutoff = respaRadius();
+    shortRange();
+    longRange(time);
+  }
+  kick(0.5 * dt, longX, longY, longZ);
+  for (int k = 0; k < substeps; ++k) {
+    kick(0.5 * h, shortX, shortY, shortZ);
+    drift(h);
+    shortRange();
+    kick(0.5 * h, shortX, shortY, shortZ);
+  }
+  longRange(time + dt); // step() advances time
+  kick(0.5 * dt, longX, longY, longZ);
+}
+
+double NBodySystem::kineticEnergy() const {
+  const BodyStore &b = bodies;
+  double sum = 0.0;
+  for (size_t i = 0; i < size(); ++i)
+    sum += 0.5 * b.mass[i] *
+           (b.vx[i] * b.vx[i] + b.vy[i] * b.vy[i] + b.vz[i] * b.vz[i]);
+  return sum;
+}
+
+double NBodySystem::potentialEnergy() const {
+  const BodyStore &b = bodies;
+  const int n = int(size());
+  const double eps2 = params.softening * params.softening;
+  // on the executor the next step will use, kept for it; only reads, so
+  // the bodies needn't be placed on nodes first
+  const Executor &current = refreshedExecutor();
+
+  // one sum per chunk of rows, added up in order, so every backend and
+  // thread count gives the same bits
+  const size_t grain = 16;
+  std::vector<double> sums((size_t(n) + grain - 1) / grain, 0.0);
+  current.forRange(size_t(n), grain, [&](size_t begin, size_t end) {
+    double sum = 0.0;
+    for (int i = int(begin); i < int(end); ++i) {
+      double partial = 0.0;
+      for (int j = i + 1; j < n; ++j) {
+        double dx = b.x[j] - b.x[i], dy = b.y[j] - b.y[i],
+               dz = b.z[j] - b.z[i];
+        partial += b.mass[j] / std::sqrt(dx * dx + dy * dy + dz * dz + eps2);
+      }
+      sum += b.mass[i] * partial;
+    }
+    sums[begin / grain] = sum;
+  });
+  double sum = 0.0;
+  for (double s : sums)
+    sum += s;
+  return -params.G * sum;
+}
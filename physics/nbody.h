@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "composition.h"
+#include "gravity.h"
+#include "hugepages.h"
+
+// Point masses as structure-of-arrays, so solvers can stream through each
+// coordinate on its own. Index i is the same body in every array.
+struct BodyStore {
+  BigVector<double> x, y, z;
+  BigVector<double> vx, vy, vz;
+  BigVector<double> mass;
+  BigVector<double> radius; // only used by callers for drawing/collisions
+
+  int add(double px, double py, double pz, double pvx, double pvy, double pvz,
+          double m, double r = 0.0);
+  void clear();
+  // Reorders the bodies along a Morton curve, so bodies close in space are
+  // close in the arrays and any run of indices is a compact region. Returns
+  // the old index of each body's new slot.
+  std::vector<int> sortBySpatialKey();
+  size_t size() const { return x.size(); }
+};
+
+// Indices 0 .. n - 1 sorted along a Morton (Z-order) space-filling curve
+// through the bodies' bounding cube.
+std::vector<int> spatialOrder(size_t n, const double *x, const double *y,
+                              const double *z);
+// The keys spatialOrder sorts by: bodies whose keys share their top 3 k of
+// 63 bits lie in one of the 8^k cubes the bounding cube splits into.
+std::vector<uint64_t> spatialKeys(size_t n, const double *x, const double *y,
+                                  const double *z);
+
+enum class GravitySolver {
+  Auto,   // Direct below NBodyParams::directLimit bodies, Tree above
+  Direct, // gravityDirectTiled, exact, O(n^2)
+  Tree,   // GravityTree, O(n log n)
+};
+
+enum class Integrator {
+  Euler,    // semi-implicit Euler: kick then drift, first order
+  Leapfrog, // drift-kick-drift, second order and time reversible; composed
+            // to higher orders with NBodyParams::composition
+  // r-RESPA: the force split at NBodyParams::respaCutoff. The short-range
+  // part, from near neighbours only, drives respaSubsteps kick-drift-kick
+  // leapfrog substeps; the long-range rest comes from the full solver once
+  // per step, as half kicks either side of them. Close encounters get a
+  // fine step while the far field, which changes slowly, is evaluated
+  // respaSubsteps times less often. The long-range force is kept from the
+  // end of one step for the start of the next, so bodies moved between
+  // steps keep their old far field for one half kick.
+  Respa,
+};
+
+struct NBodyParams {
+  double G = 6.6743e-11; // m^3 kg^-1 s^-2
+  double softening = 0.0;
+  GravitySolver solver = GravitySolver::Auto;
+  double theta = 0.5;
+  size_t directLimit = 2048;
+  GravityTiles tiles; // for the direct sum; see tuneGravityTiles
+  Backend backend = Backend::OpenMP; // runs the force pass, drift and kick
+  int threads = 0;                   // 0: every hardware thread
+  // ThreadPool only: pin threads node by node and keep each node's share of
+  // the bodies in its own memory (see sortBySpatialKey)
+  bool numa = false;
+  Integrator integrator = Integrator::Leapfrog;
+  // Leapfrog only: compose its step into a 4th, 6th or 8th order one
+  Composition composition = Composition::Leapfrog;
+  int respaSubsteps = 4;
+  // 0 picks the radius that holds about 32 bodies at the mean density
+  // inside the half-mass radius
+  double respaCutoff = 0.0;
+};
+
+// Self-gravitating point masses: a body store, a gravity solver and an
+// integrator. This is the shared core the viewers, the headless runner and
+// the benchmarks all step.
+class NBodySystem {
+public:
+  explicit NBodySystem(const NBodyParams &params = NBodyParams());
+
+  int addBody(double x, double y, double z, double vx, double vy, double vz,
+              double mass, double radius = 0.0);
+  size_t size() const { return bodies.size(); }
+
+  // Accelerations for the current positions into ax, ay, az.
+  void computeAccelerations();
+  void step(double dt);
+
+  double kineticEnergy() const;
+  double potentialEnergy() const; // softened, summed over every pair
+  double energy() const { return kineticEnergy() + potentialEnergy(); }
+
+  // what the last step or energy ran on, for its thread count and per-node
+  // stats
+  const Executor &lastExecutor() const { return executor; }
+
+  NBodyParams params;
+  BodyStore bodies;
+  BigVector<double> ax, ay, az;
+  double time = 0.0;
+
+private:
+  void drift(double dt);
+  void kick(double dt);
+  void kick(double dt, const BigVector<double> &gx,
+            const BigVector<double> &gy, const BigVector<double> &gz);
+  void stepRespa(double dt);
+  double respaRadius() const;
+  // the executor for params.backend, params.threads and params.numa, rebuilt
+  // only when they change; currentExecutor also places the bodies on nodes
+  const Executor &refreshedExecutor() const;
+  const Executor &currentExecutor();
+
+  GravityTree tree;
+  mutable Executor executor;
+  // Respa's short- and long-range parts, and when the long part was taken
+  BigVector<double> shortX, shortY, shortZ, longX, longY, longZ;
+  double longTime = -1.0;
+  double cutoff = 0.0;
+  mutable size_t placedBodies = 0, placedTree = 0; // last placed on nodes
+};
@@ -0,0 +1,114 @@
+#include "numa.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// "0-3,8-11" style lists
+std::vector<int> parseCpuList(const std::string &text) {
+  std::vector<int> cpus;
+  std::stringstream in(text);
+  std::string part;
+  while (std::getline(in, part, ',')) {
+    int lo, hi;
+    int fields = std::sscanf(part.c_str(), "%d-%d", &lo, &hi);
+    if (fields == 1)
+      hi = lo;
+    if (fields < 1)
+      continue;
+    for (int c = lo; c <= hi; ++c)
+      cpus.push_back(c);
+  }
+  return cpus;
+}
+
+NumaTopology detect() {
+  NumaTopology topology;
+  for (int node = 0;; ++node) {
+    std::ifstream list("/sys/devices/system/node/node" +
+                       std::to_string(node) + "/cpulist");
+    if (!list)
+      break;
+    std::string text;
+    std::getline(list, text);
+    std::vector<int> cpus = parseCpuList(text);
+    // memory-only nodes have no threads to give work to
+    if (!cpus.empty()) {
+      topology.cpus.push_back(cpus);
+      topology.ids.push_back(node);
+    }
+  }
+  if (topology.cpus.empty()) {
+    std::vector<int> all;
+    for (unsigned c = 0; c < std::max(1u, std::thread::hardware_concurrency());
+         ++c)
+      all.push_back(int(c));
+    topology.cpus.push_back(all);
+    topology.ids.push_back(0);
+  }
+  return topology;
+}
+
+} // namespace
+
+const NumaTopology &NumaTopology::get() {
+  static const NumaTopology topology = detect();
+  return topology;
+}
+
+bool pinThread(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+void placeOnNodes(void *data, size_t count, size_t elementSize,
+                  const std::vector<int> &first) {
+  const int nodes = int(first.size()) - 1;
+  if (nodes < 2 || count == 0)
+    return;
+#ifdef __linux__
+  const size_t page = size_t(sysconf(_SC_PAGESIZE));
+  const size_t total = size_t(first.back());
+  const size_t base = reinterpret_cast<size_t>(data);
+  const std::vector<int> &ids = NumaTopology::get().ids;
+  for (int k = 0; k < nodes && k < int(ids.size()); ++k) {
+    size_t begin = count * first[k] / total * elementSize + base;
+    size_t end = count * first[k + 1] / total * elementSize + base;
+    // whole pages only
+    begin = (begin + page - 1) / page * page;
+    end = end / page * page;
+    if (end <= begin)
+      continue;
+    if (ids[k] >= 64)
+      continue;
+    // preferred rather than bound, so a full node spills over instead of
+    // failing the allocation
+    unsigned long mask = 1ul << ids[k];
+    syscall(SYS_mbind, begin, end - begin, MPOL_PREFERRED, &mask,
+            sizeof(mask) * 8, MPOL_MF_MOVE);
+  }
+#else
+  (void)data;
+  (void)elementSize;
+#endif
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// The machine's NUMA nodes (sockets, usually) and the CPUs in each, as Linux
+// reports them under /sys/devices/system/node. Elsewhere, or when that is
+// missing, the whole machine is one node.
+struct NumaTopology {
+  std::vector<std::vector<int>> cpus; // cpus[node]
+  std::vector<int> ids;               // the system's number for each node
+
+  static const NumaTopology &get();
+  int nodes() const { return int(cpus.size()); }
+};
+
+// Keeps the calling thread on one CPU. False where that is not supported.
+bool pinThread(int cpu);
+
+// Moves the pages of data to the nodes that will use them: element i of
+// count goes to the node whose share of 0 .. count - 1 contains it, with
+// node k owning [count * first[k] / total, count * first[k + 1] / total).
+// first has nodes + 1 entries, the thread split of a NUMA-aware executor.
+// Pages a boundary runs through stay where they are. Does nothing on a
+// single node or where mbind is unavailable.
+void placeOnNodes(void *data, size_t count, size_t elementSize,
+                  const std::vector<int> &first);
+
+// How the chunks of a NUMA-aware executor's loops were spread over nodes.
+struct NodeStats {
+  int threads = 0;          // the caller counts as one of node 0's
+  size_t chunks = 0;        // chunks its threads ran
+  size_t stolen = 0;        // of those, chunks that belonged to another node
+  double busySeconds = 0.0; // summed over its threads
+};
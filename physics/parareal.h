@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "execution.h"
+#include "fewbody.h"
+
+// Parareal: parallel in time for one few-body trajectory, which has too few
+// bodies to split. The run is cut into slices. A coarse leapfrog with a few
+// large steps per slice guesses the state at every slice boundary; then
+// each iteration runs the fine leapfrog over every slice at once, from the
+// current guesses, and sweeps the coarse one through again, correcting it
+// by how far fine and coarse disagreed last time:
+//
+//   U[k+1] = coarse(U[k]) + fine(U_old[k]) - coarse(U_old[k])
+//
+// After iteration j the first j slices are exact, so it never takes more
+// than slices iterations, and it stops early once no boundary moves by more
+// than tolerance. With K iterations on P slices the fine work costs about
+// K/P of a serial run in wall-clock time, given P cores; a smooth orbit
+// converges in a few iterations, a chaotic close encounter may need many.
+struct PararealParams {
+  int slices = 8;
+  long fineSteps = 1000;  // leapfrog steps per slice, the accuracy wanted
+  long coarseSteps = 10;  // leapfrog steps per slice for the guesses
+  int maxIterations = 0;  // 0 for slices
+  double tolerance = 1e-9; // relative to the largest position or velocity
+};
+
+struct PararealStats {
+  int iterations = 0;
+  double change = 0.0; // largest relative boundary change, last iteration
+};
+
+namespace parareal {
+
+template <int N>
+inline void correct(FewBodyState<N> &u, const FewBodyState<N> &fine,
+                    const FewBodyState<N> &coarse) {
+  for (int i = 0; i < N; ++i) {
+    u.x[i] += fine.x[i] - coarse.x[i];
+    u.y[i] += fine.y[i] - coarse.y[i];
+    u.z[i] += fine.z[i] - coarse.z[i];
+    u.vx[i] += fine.vx[i] - coarse.vx[i];
+    u.vy[i] += fine.vy[i] - coarse.vy[i];
+    u.vz[i] += fine.vz[i] - coarse.vz[i];
+  }
+}
+
+// the largest change from a to b, positions and velocities each relative
+// to their largest component in b
+template <int N>
+inline double change(const FewBodyState<N> &a, const FewBodyState<N> &b) {
+  double dr = 0.0, dv = 0.0, r = 0.0, v = 0.0;
+  for (int i = 0; i < N; ++i) {
+    dr = std::max({dr, std::fabs(b.x[i] - a.x[i]), std::fabs(b.y[i] - a.y[i]),
+                   std::fabs(b.z[i] - a.z[i])});
+    dv = std::max({dv, std::fabs(b.vx[i] - a.vx[i]),
+                   std::fabs(b.vy[i] - a.vy[i]),
+                   std::fabs(b.vz[i] - a.vz[i])});
+    r = std::max({r, std::fabs(b.x[i]), std::fabs(b.y[i]), std::fabs(b.z[i])});
+    v = std::max(
+        {v, std::fabs(b.vx[i]), std::fabs(b.vy[i]), std::fabs(b.vz[i])});
+  }
+  return std::max(r > 0.0 ? dr / r : dr, v > 0.0 ? dv / v : dv);
+}
+
+} // namespace parareal
+
+// Advances s by duration with Parareal; the slices' fine runs go to
+// executor. The answer matches fineSteps * slices serial leapfrog steps to
+// within tolerance (exactly, up to rounding, if it runs all slices
+// iterations).
+template <int N>
+PararealStats runParareal(FewBodyState<N> &s, double G, double eps2,
+                          double duration, const PararealParams &params,
+                          const Executor &executor = Executor()) {
+  const int slices = std::max(params.slices, 1);
+  const int iterations =
+      params.maxIterations > 0 ? std::min(params.maxIterations, slices) : slices;
+  const double length = duration / slices;
+  const long fineSteps = std::max(params.fineSteps, 1L);
+  const long coarseSteps = std::max(params.coarseSteps, 1L);
+  auto coarse = [&](FewBodyState<N> u) {
+    stepFewBody(u, G, eps2, length / coarseSteps, coarseSteps);
+    return u;
+  };
+
+  // u[k] is the guess at the start of slice k, guess[k] the coarse run of
+  // slice k from it
+  std::vector<FewBodyState<N>> u(slices + 1), guess(slices), fine(slices);
+  u[0] = s;
+  for (int k = 0; k < slices; ++k) {
+    guess[k] = coarse(u[k]);
+    u[k + 1] = guess[k];
+  }
+
+  PararealStats stats;
+  for (int j = 0; j < iterations; ++j) {
+    // slices before j start from exact states and were refined already
+    executor.forRange(size_t(slices - j), 1, [&](size_t begin, size_t end) {
+      for (size_t k = begin + j; k < end + j; ++k) {
+        fine[k] = u[k];
+        stepFewBody(fine[k], G, eps2, length / fineSteps, fineSteps);
+      }
+    });
+
+    stats.iterations = j + 1;
+    stats.change = parareal::change(u[j + 1], fine[j]);
+    u[j + 1] = fine[j];
+    for (int k = j + 1; k < slices; ++k) {
+      FewBodyState<N> next = coarse(u[k]);
+      FewBodyState<N> updated = next;
+      parareal::correct(updated, fine[k], guess[k]);
+      guess[k] = next;
+      stats.change = std::max(stats.change, parareal::change(u[k + 1], updated));
+      u[k + 1] = updated;
+    }
+    if (stats.change <= params.tolerance)
+      break;
+  }
+  s = u[slices];
+  return stats;
+}
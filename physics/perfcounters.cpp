@@ -0,0 +1,97 @@
+#include "perfcounters.h"
+
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef __linux__
+int openEvent(uint32_t type, uint64_t config) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+uint64_t cacheMisses(uint64_t cache) {
+  return cache | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+         PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+}
+#endif
+
+} // namespace
+
+PerfCounters::PerfCounters() {
+  for (int e = 0; e < EventCount; ++e) {
+    fds[e] = -1;
+    counts[e] = -1;
+  }
+#ifdef __linux__
+  fds[DtlbLoadMisses] =
+      openEvent(PERF_TYPE_HW_CACHE, cacheMisses(PERF_COUNT_HW_CACHE_DTLB));
+  fds[ItlbMisses] =
+      openEvent(PERF_TYPE_HW_CACHE, cacheMisses(PERF_COUNT_HW_CACHE_ITLB));
+  fds[PageFaults] = openEvent(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+  for (int fd : fds)
+    if (fd >= 0)
+      close(fd);
+#endif
+}
+
+void PerfCounters::start() {
+#ifdef __linux__
+  for (int fd : fds) {
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+#endif
+}
+
+void PerfCounters::stop() {
+#ifdef __linux__
+  for (int e = 0; e < EventCount; ++e) {
+    if (fds[e] < 0)
+      continue;
+    ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t value = 0;
+    counts[e] = read(fds[e], &value, sizeof(value)) == sizeof(value)
+                    ? int64_t(value)
+                    : -1;
+  }
+#endif
+}
+
+int64_t PerfCounters::count(Event event) const { return counts[event]; }
+
+const char *PerfCounters::name(Event event) {
+  switch (event) {
+  case DtlbLoadMisses:
+    return "dTLB load misses";
+  case ItlbMisses:
+    return "iTLB misses";
+  case PageFaults:
+    return "page faults";
+  case EventCount:
+    break;
+  }
+  return "?";
+}
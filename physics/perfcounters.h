@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+// Hardware and kernel event counts over a stretch of code, read through
+// Linux perf_event_open: TLB misses to check what huge pages buy, and page
+// faults, which every 4 KB (or 2 MB) page costs on first touch.
+//
+// Counts the calling thread and threads it starts afterwards, in user space
+// only. Events the machine or its permissions don't allow (virtual machines
+// often hide the hardware ones) read as -1.
+class PerfCounters {
+public:
+  enum Event { DtlbLoadMisses, ItlbMisses, PageFaults, EventCount };
+
+  PerfCounters();
+  ~PerfCounters();
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  void start(); // zero and count
+  void stop();
+
+  // the count between start and stop, or -1 if unavailable
+  int64_t count(Event event) const;
+  bool available(Event event) const { return fds[event] >= 0; }
+  static const char *name(Event event);
+
+private:
+  int fds[EventCount];
+  int64_t counts[EventCount];
+};
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "denseoutput.h"
+#include "fewbody.h"
+
+// Experimental gravity with a finite speed c: body i feels body j where j
+// was when its pull set out, at the retarded time t - |x_i(t) - x_j(t_r)| /
+// c, instead of where j is now. Each body keeps a ring of its past states,
+// one per step, and a lookup takes the cubic Hermite curve between the two
+// samples around t_r. Nothing holds the retarded force to Newton's third
+// law, so momentum and energy drift, and orbits slowly widen at a rate
+// that grows as c falls; that is the point of the experiment, not a fault
+// of the integrator.
+
+// A run's recent past, at a fixed step dt. Memory is N states per step of
+// the longest light travel time between bodies, rounded up to a power of
+// two, whatever the run's length; each body's states are contiguous, and a
+// lookup reads two neighbouring ones found by index, not by search. The
+// ring starts at the span given to reset() and doubles, as often as it
+// takes, once lookups reach back over half of it, before it drops the
+// states they need; any that still reach past it, after a jump of more
+// than that in one step, are counted in clipped() and extrapolated, which
+// is no longer retarded gravity.
+template <int N> class RetardedHistory {
+public:
+  // Forgets everything, then keeps s as the newest state, with room for
+  // span of history to begin with. Before s the bodies are taken to have
+  // moved in straight lines.
+  void reset(const FewBodyState<N> &s, double dt, double span) {
+    step = dt;
+    capacity = 2;
+    while (capacity < span / dt + 2.0 && capacity < maxCapacity)
+      capacity *= 2;
+    states.assign(size_t(N) * capacity, Sample());
+    newest = 0;
+    count = 0;
+    deepest = 0.0;
+    dropped = 0;
+    overwritten = false;
+    push(s);
+  }
+
+  // The state one step after the newest.
+  void push(const FewBodyState<N> &s) {
+    if (count == capacity && 2.0 * deepest > (capacity - 2) * step) {
+      int to = capacity;
+      while (2.0 * deepest > (to - 2) * step && to < maxCapacity)
+        to *= 2;
+      grow(to);
+    }
+    newest = (newest + 1) & (capacity - 1);
+    if (count < capacity)
+      ++count;
+    else
+      overwritten = true;
+    for (int i = 0; i < N; ++i)
+      states[slot(i, newest)] = {s.x[i],  s.y[i],  s.z[i],
+                                 s.vx[i], s.vy[i], s.vz[i]};
+  }
+
+  // The newest state's velocities, once the step that made it has finished
+  // its last kick.
+  void settle(const FewBodyState<N> &s) {
+    for (int i = 0; i < N; ++i) {
+      Sample &a = states[slot(i, newest)];
+      a.vx = s.vx[i], a.vy = s.vy[i], a.vz = s.vz[i];
+    }
+  }
+
+  // body j's position back in time before the newest state, back >= 0
+  void position(int j, double back, double p[3]) const {
+    deepest = std::max(deepest, back);
+    const double steps = back / step;
+    const int oldest = count - 1;
+    if (steps >= double(oldest)) {
+      // before the oldest state: carry it back in a straight line
+      const Sample &s = states[slot(j, newest - oldest)];
+      const double before = back - oldest * step;
+      p[0] = s.x - s.vx * before;
+      p[1] = s.y - s.vy * before;
+      p[2] = s.z - s.vz * before;
+      if (overwritten)
+        ++dropped;
+      return;
+    }
+    const int k = int(steps);
+    const Sample &late = states[slot(j, newest - k)];
+    const Sample &early = states[slot(j, newest - k - 1)];
+    const double tau = 1.0 - (steps - k);
+    p[0] = hermitePosition(early.x, early.vx, late.x, late.vx, step, tau);
+    p[1] = hermitePosition(early.y, early.vy, late.y, late.vy, step, tau);
+    p[2] = hermitePosition(early.z, early.vz, late.z, late.vz, step, tau);
+  }
+
+  double dt() const { return step; }
+  // the time the ring covers, capacity - 1 steps once full
+  double span() const { return (count - 1) * step; }
+  size_t bytes() const { return states.size() * sizeof(Sample); }
+  // lookups that wanted states the ring had already dropped
+  long clipped() const { return dropped; }
+
+private:
+  struct Sample {
+    double x, y, z, vx, vy, vz;
+  };
+
+  static constexpr int maxCapacity = 1 << 30;
+
+  size_t slot(int body, int k) const {
+    return size_t(body) * capacity + size_t(k & (capacity - 1));
+  }
+
+  // room for to states, with every kept one where slot() now looks for it
+  void grow(int to) {
+    std::vector<Sample> old(states.size() / capacity * to);
+    old.swap(states);
+    const int was = capacity;
+    capacity = to;
+    for (int i = 0; i < N; ++i)
+      for (int age = 0; age < count; ++age)
+        states[slot(i, newest - age)] =
+            old[size_t(i) * was + size_t((newest - age) & (was - 1))];
+  }
+
+  std::vector<Sample> states; // body by body, capacity each
+  double step = 0.0;
+  int capacity = 2, newest = 0, count = 0;
+  bool overwritten = false; // whether any state has been dropped
+  mutable double deepest = 0.0; // the furthest back any lookup has asked
+  mutable long dropped = 0;
+};
+
+namespace retarded {
+
+// The retarded accelerations over G at the history's newest time, where
+// the bodies are s. Light travel time is found by fixed point iteration,
+// which gains a factor of v / c each round; three rounds is plenty for
+// anything slower than a tenth of c.
+template <int N>
+inline fewbody::Accelerations<N>
+accelerations(const FewBodyState<N> &s, const RetardedHistory<N> &history,
+              double eps2, double c) {
+  fewbody::Accelerations<N> a = {};
+  for (int i = 0; i < N; ++i) {
+    for (int j = 0; j < N; ++j) {
+      if (j == i)
+        continue;
+      double p[3] = {s.x[j], s.y[j], s.z[j]};
+      double dx, dy, dz, r2;
+      for (int round = 0;; ++round) {
+        dx = p[0] - s.x[i], dy = p[1] - s.y[i], dz = p[2] - s.z[i];
+        r2 = dx * dx + dy * dy + dz * dz;
+        if (round == 3)
+          break;
+        history.position(j, std::sqrt(r2) / c, p);
+      }
+      double inv = 1.0 / std::sqrt(r2 + eps2);
+      double f = s.mass[j] * inv * inv * inv;
+      a.x[i] += dx * f;
+      a.y[i] += dy * f;
+      a.z[i] += dz * f;
+    }
+  }
+  return a;
+}
+
+} // namespace retarded
+
+// steps kick-drift-kick steps of history.dt() with retarded gravity.
+// history's newest state must be s, as reset() or a previous call leaves
+// it.
+template <int N>
+inline void stepRetarded(FewBodyState<N> &s, RetardedHistory<N> &history,
+                         double G, double eps2, double c, long steps) {
+  constexpr auto bodies = std::make_index_sequence<N>();
+  const double dt = history.dt();
+  fewbody::Accelerations<N> a = retarded::accelerations(s, history, eps2, c);
+  for (long k = 0; k < steps; ++k) {
+    fewbody::kick(s, a, 0.5 * G * dt, bodies);
+    fewbody::drift(s, dt, bodies);
+    // the half kicked velocities stand in for the new state's until its
+    // own kick, for the few lookups that land inside this step
+    history.push(s);
+    a = retarded::accelerations(s, history, eps2, c);
+    fewbody::kick(s, a, 0.5 * G * dt, bodies);
+    history.settle(s);
+  }
+}
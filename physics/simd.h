@@ -0,0 +1,205 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__AVX__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+// Packets of 8 or 16 floats, one per body, so physics written against
+// test.cpp's Vec3 can run on 8 or 16 bodies at once: swap Vec3 for Vec3x8
+// (one AVX register per coordinate) or Vec3x16 (one AVX-512 register) and
+// the same +, -, * and length() now work lane by lane.
+//
+// Packets are GCC/Clang vector extensions, so they compile on any target;
+// built with -mavx / -mavx512f each one is a single register and the masked
+// loads, stores and square roots use the AVX instructions directly.
+
+// Passing these by value without AVX enabled is fine inside one program;
+// GCC only warns that the ABI differs from an AVX build.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+typedef float Floatx8 __attribute__((vector_size(32)));
+typedef float Floatx16 __attribute__((vector_size(64)));
+typedef int Maskx8 __attribute__((vector_size(32)));
+typedef int Maskx16 __attribute__((vector_size(64)));
+
+template <int Lanes> struct PacketTraits;
+template <> struct PacketTraits<8> {
+  typedef Floatx8 Float;
+  typedef Maskx8 Mask;
+};
+template <> struct PacketTraits<16> {
+  typedef Floatx16 Float;
+  typedef Maskx16 Mask;
+};
+
+// All lanes below count set; comparisons give the same kind of mask.
+template <int Lanes>
+inline typename PacketTraits<Lanes>::Mask tailMask(int count) {
+  typename PacketTraits<Lanes>::Mask lane;
+  for (int i = 0; i < Lanes; ++i)
+    lane[i] = i;
+  return lane < count;
+}
+
+// Lanes below count from p, the rest zero. Never reads past p[count - 1].
+template <int Lanes>
+inline typename PacketTraits<Lanes>::Float loadPacket(const float *p,
+                                                      int count = Lanes) {
+  typedef typename PacketTraits<Lanes>::Float Float;
+  if (count >= Lanes) {
+    Float v;
+    __builtin_memcpy(&v, p, sizeof(v));
+    return v;
+  }
+#if defined(__AVX512F__)
+  if constexpr (Lanes == 16)
+    return (Float)_mm512_maskz_loadu_ps(__mmask16((1u << count) - 1u), p);
+#endif
+#if defined(__AVX__)
+  if constexpr (Lanes == 8)
+    return (Float)_mm256_maskload_ps(p, (__m256i)tailMask<8>(count));
+#endif
+  Float v = {};
+  for (int i = 0; i < count; ++i)
+    v[i] = p[i];
+  return v;
+}
+
+// Writes the lanes below count to p and leaves the rest of memory alone.
+template <int Lanes>
+inline void storePacket(float *p, typename PacketTraits<Lanes>::Float v,
+                        int count = Lanes) {
+  if (count >= Lanes) {
+    __builtin_memcpy(p, &v, sizeof(v));
+    return;
+  }
+#if defined(__AVX512F__)
+  if constexpr (Lanes == 16) {
+    _mm512_mask_storeu_ps(p, __mmask16((1u << count) - 1u), (__m512)v);
+    return;
+  }
+#endif
+#if defined(__AVX__)
+  if constexpr (Lanes == 8) {
+    _mm256_maskstore_ps(p, (__m256i)tailMask<8>(count), (__m256)v);
+    return;
+  }
+#endif
+  for (int i = 0; i < count; ++i)
+    p[i] = v[i];
+}
+
+inline Floatx8 sqrtPacket(Floatx8 v) {
+#if defined(__AVX__)
+  return (Floatx8)_mm256_sqrt_ps((__m256)v);
+#else
+  for (int i = 0; i < 8; ++i)
+    v[i] = std::sqrt(v[i]);
+  return v;
+#endif
+}
+
+inline Floatx16 sqrtPacket(Floatx16 v) {
+#if defined(__AVX512F__)
+  // the zero-masking form; the plain one trips a GCC 12 uninitialised
+  // warning inside its own header
+  return (Floatx16)_mm512_maskz_sqrt_ps(__mmask16(0xffff), (__m512)v);
+#else
+  for (int i = 0; i < 16; ++i)
+    v[i] = std::sqrt(v[i]);
+  return v;
+#endif
+}
+
+template <typename Float> inline float reduceAdd(Float v) {
+  float sum = 0.0f;
+  for (size_t i = 0; i < sizeof(Float) / sizeof(float); ++i)
+    sum += v[i];
+  return sum;
+}
+
+// mask ? a : b, lane by lane
+template <typename Mask, typename Float>
+inline Float select(Mask mask, Float a, Float b) {
+  return mask ? a : b;
+}
+
+// Vec3 with a packet in each coordinate. Lane i of x, y and z is one
+// body's vector.
+template <int Lanes> struct Vec3Packet {
+  typedef typename PacketTraits<Lanes>::Float Float;
+  typedef typename PacketTraits<Lanes>::Mask Mask;
+  static constexpr int lanes = Lanes;
+
+  Float x, y, z;
+
+  Vec3Packet() : x(), y(), z() {}
+  Vec3Packet(Float x, Float y, Float z) : x(x), y(y), z(z) {}
+  // the same vector in every lane
+  Vec3Packet(float sx, float sy, float sz)
+      : x(Float{} + sx), y(Float{} + sy), z(Float{} + sz) {}
+
+  // count bodies from structure-of-arrays coordinates, unused lanes zero
+  static Vec3Packet load(const float *px, const float *py, const float *pz,
+                         int count = Lanes) {
+    return Vec3Packet(loadPacket<Lanes>(px, count),
+                      loadPacket<Lanes>(py, count),
+                      loadPacket<Lanes>(pz, count));
+  }
+  void store(float *px, float *py, float *pz, int count = Lanes) const {
+    storePacket<Lanes>(px, x, count);
+    storePacket<Lanes>(py, y, count);
+    storePacket<Lanes>(pz, z, count);
+  }
+
+  Vec3Packet operator+(const Vec3Packet &o) const {
+    return Vec3Packet(x + o.x, y + o.y, z + o.z);
+  }
+  Vec3Packet operator-(const Vec3Packet &o) const {
+    return Vec3Packet(x - o.x, y - o.y, z - o.z);
+  }
+  Vec3Packet operator*(float s) const {
+    return Vec3Packet(x * s, y * s, z * s);
+  }
+  // a different scale in each lane
+  Vec3Packet operator*(Float s) const {
+    return Vec3Packet(x * s, y * s, z * s);
+  }
+  Vec3Packet &operator+=(const Vec3Packet &o) { return *this = *this + o; }
+  Vec3Packet &operator-=(const Vec3Packet &o) { return *this = *this - o; }
+
+  Float lengthSquared() const { return x * x + y * y + z * z; }
+  Float length() const { return sqrtPacket(lengthSquared()); }
+  Vec3Packet normalize() const {
+    Float len = length();
+    // lanes of zero length stay as they are, like Vec3::normalize
+    Float scale = select(len > 0.0f, 1.0f / len, Float{} + 1.0f);
+    return *this * scale;
+  }
+
+  // lanes where mask is set from a, the others from b
+  static Vec3Packet blend(Mask mask, const Vec3Packet &a,
+                          const Vec3Packet &b) {
+    return Vec3Packet(select(mask, a.x, b.x), select(mask, a.y, b.y),
+                      select(mask, a.z, b.z));
+  }
+};
+
+typedef Vec3Packet<8> Vec3x8;
+typedef Vec3Packet<16> Vec3x16;
+
+template <int Lanes>
+inline typename Vec3Packet<Lanes>::Float dot(const Vec3Packet<Lanes> &a,
+                                             const Vec3Packet<Lanes> &b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
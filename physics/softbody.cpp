@@ -0,0 +1,408 @@
+#include "softbody.h"
+
+#include <algorithm>
+#include <cmath>
+
+SoftBodySystem::SoftBodySystem(const SoftBodyParams &params)
+    : params(params) {}
+
+int SoftBodySystem::addParticle(float px, float py, float pz, float mass) {
+  x.push_back(px);
+  y.push_back(py);
+  z.push_back(pz);
+  vx.push_back(0.0f);
+  vy.push_back(0.0f);
+  vz.push_back(0.0f);
+  invMass.push_back(mass > 0.0f ? 1.0f / mass : 0.0f);
+  return int(x.size()) - 1;
+}
+
+void SoftBodySystem::addDistance(int a, int b, float c) {
+  float dx = x[a] - x[b], dy = y[a] - y[b], dz = z[a] - z[b];
+  dA.push_back(a);
+  dB.push_back(b);
+  restLength.push_back(std::sqrt(dx * dx + dy * dy + dz * dz));
+  compliance.push_back(c);
+  batchesDirty = true;
+}
+
+int SoftBodySystem::addRope(float x0, float y0, float z0, float x1, float y1,
+                            float z1, int segments, float mass, float c,
+                            bool pinStart) {
+  segments = std::max(segments, 1);
+  const float m = mass / float(segments + 1);
+  const int first = int(size());
+  for (int i = 0; i <= segments; ++i) {
+    float t = float(i) / float(segments);
+    addParticle(x0 + (x1 - x0) * t, y0 + (y1 - y0) * t, z0 + (z1 - z0) * t,
+                pinStart && i == 0 ? 0.0f : m);
+    if (i > 0)
+      addDistance(first + i - 1, first + i, c);
+  }
+  return first;
+}
+
+int SoftBodySystem::addCloth(float ox, float oy, float oz, float ux, float uy,
+                             float uz, float vx, float vy, float vz,
+                             int columns, int rows, float mass, float c,
+                             bool pinTop) {
+  columns = std::max(columns, 2);
+  rows = std::max(rows, 2);
+  const float m = mass / float(columns * rows);
+  const int first = int(size());
+  for (int j = 0; j < rows; ++j) {
+    float t = float(j) / float(rows - 1);
+    for (int i = 0; i < columns; ++i) {
+      float s = float(i) / float(columns - 1);
+      bool pinned = pinTop && j == rows - 1 && (i == 0 || i == columns - 1);
+      addParticle(ox + ux * s + vx * t, oy + uy * s + vy * t,
+                  oz + uz * s + vz * t, pinned ? 0.0f : m);
+    }
+  }
+
+  auto at = [&](int i, int j) { return first + j * columns + i; };
+  for (int j = 0; j < rows; ++j) {
+    for (int i = 0; i < columns; ++i) {
+      // stretch along both edges, shear across both diagonals
+      if (i + 1 < columns)
+        addDistance(at(i, j), at(i + 1, j), c);
+      if (j + 1 < rows)
+        addDistance(at(i, j), at(i, j + 1), c);
+      if (i + 1 < columns && j + 1 < rows) {
+        addDistance(at(i, j), at(i + 1, j + 1), c);
+        addDistance(at(i + 1, j), at(i, j + 1), c);
+      }
+    }
+  }
+  return first;
+}
+
+int SoftBodySystem::addBlob(float cx, float cy, float cz, float r, int across,
+                            float mass, float stiffness) {
+  across = std::max(across, 2);
+  const int first = int(size());
+  const float spacing = 2.0f * r / float(across - 1);
+
+  ShapeCluster cluster;
+  for (int k = 0; k < across; ++k) {
+    for (int j = 0; j < across; ++j) {
+      for (int i = 0; i < across; ++i) {
+        float ox = -r + spacing * i, oy = -r + spacing * j,
+              oz = -r + spacing * k;
+        if (ox * ox + oy * oy + oz * oz > r * r * 1.0001f)
+          continue;
+        cluster.restX.push_back(ox);
+        cluster.restY.push_back(oy);
+        cluster.restZ.push_back(oz);
+      }
+    }
+  }
+  cluster.first = first;
+  cluster.count = int(cluster.restX.size());
+  cluster.stiffness = stiffness;
+
+  // the lattice is symmetric, so its centroid is already the centre
+  const float m = mass / float(cluster.count);
+  for (int i = 0; i < cluster.count; ++i)
+    addParticle(cx + cluster.restX[i], cy + cluster.restY[i],
+                cz + cluster.restZ[i], m);
+  clusters.push_back(std::move(cluster));
+  return first;
+}
+
+void SoftBodySystem::clear() {
+  x.clear();
+  y.clear();
+  z.clear();
+  vx.clear();
+  vy.clear();
+  vz.clear();
+  invMass.clear();
+  dA.clear();
+  dB.clear();
+  restLength.clear();
+  compliance.clear();
+  clusters.clear();
+  batchesDirty = true;
+}
+
+void SoftBodySystem::prepare() {
+  if (!batchesDirty)
+    return;
+  batchesDirty = false;
+
+  // Pinned particles are never written by the solve, so constraints may
+  // share them freely.
+  colorConstraints(
+      dA.size(), size(),
+      [&](size_t k) {
+        int a = invMass[dA[k]] > 0.0f ? dA[k] : -1;
+        int b = invMass[dB[k]] > 0.0f ? dB[k] : -1;
+        return std::make_pair(a, b);
+      },
+      batches);
+
+  // Store the constraints in batch order so each batch is a contiguous run
+  // the solver can stream through with SIMD.
+  auto permute = [&](auto &values) {
+    auto sorted = values;
+    for (size_t k = 0; k < batches.order.size(); ++k)
+      sorted[k] = values[batches.order[k]];
+    values.swap(sorted);
+  };
+  permute(dA);
+  permute(dB);
+  permute(restLength);
+  permute(compliance);
+  for (size_t k = 0; k < batches.order.size(); ++k)
+    batches.order[k] = int(k);
+}
+
+void SoftBodySystem::step(float dt) {
+  prepare();
+  const int subSteps = std::max(1, params.subSteps);
+  const float h = dt / float(subSteps);
+  prevX.resize(size());
+  prevY.resize(size());
+  prevZ.resize(size());
+
+  for (int sub = 0; sub < subSteps; ++sub) {
+    predict(h);
+    solveDistances(h);
+    solveShapes();
+    collide();
+    updateVelocities(h);
+  }
+}
+
+void SoftBodySystem::predict(float h) {
+  const int n = int(size());
+  const float gx = params.gravityX * h, gy = params.gravityY * h,
+              gz = params.gravityZ * h;
+  const float eps2 = params.softening * params.softening;
+  const float keep = std::pow(params.damping, h);
+
+  // One sweep per attractor keeps each loop free of inner loops, so every
+  // one of them vectorises across particles.
+#pragma omp parallel
+  {
+#pragma omp for simd schedule(simd : static)
+    for (int i = 0; i < n; ++i) {
+      prevX[i] = x[i];
+      prevY[i] = y[i];
+      prevZ[i] = z[i];
+      if (invMass[i] == 0.0f)
+        continue;
+      vx[i] += gx;
+      vy[i] += gy;
+      vz[i] += gz;
+    }
+
+    for (const SoftAttractor &at : attractors) {
+      const float pull = at.gm * h;
+#pragma omp for simd schedule(simd : static)
+      for (int i = 0; i < n; ++i) {
+        if (invMass[i] == 0.0f)
+          continue;
+        float dx = at.x - x[i], dy = at.y - y[i], dz = at.z - z[i];
+        float inv = 1.0f / std::sqrt(dx * dx + dy * dy + dz * dz + eps2);
+        float s = pull * inv * inv * inv;
+        vx[i] += dx * s;
+        vy[i] += dy * s;
+        vz[i] += dz * s;
+      }
+    }
+
+#pragma omp for simd schedule(simd : static)
+    for (int i = 0; i < n; ++i) {
+      if (invMass[i] == 0.0f)
+        continue;
+      vx[i] *= keep;
+      vy[i] *= keep;
+      vz[i] *= keep;
+      x[i] += vx[i] * h;
+      y[i] += vy[i] * h;
+      z[i] += vz[i] * h;
+    }
+  }
+}
+
+// Moves the two ends of distance constraint k towards its rest length. With
+// one pass per substep the accumulated multiplier always starts at zero, so
+// the projection is a single closed-form step.
+static inline void projectDistance(int k, float *px, float *py, float *pz,
+                                   const float *w, const int *ia,
+                                   const int *ib, const float *rest,
+                                   const float *comp, float invH2) {
+  const int a = ia[k], b = ib[k];
+  float dx = px[a] - px[b], dy = py[a] - py[b], dz = pz[a] - pz[b];
+  float len = std::sqrt(dx * dx + dy * dy + dz * dz);
+  float denom = (w[a] + w[b] + comp[k] * invH2) * len;
+  float s = denom > 1e-12f ? (len - rest[k]) / denom : 0.0f;
+  // pinned ends may be shared within a batch, so they are never written
+  if (w[a] > 0.0f) {
+    px[a] -= w[a] * s * dx;
+    py[a] -= w[a] * s * dy;
+    pz[a] -= w[a] * s * dz;
+  }
+  if (w[b] > 0.0f) {
+    px[b] += w[b] * s * dx;
+    py[b] += w[b] * s * dy;
+    pz[b] += w[b] * s * dz;
+  }
+}
+
+void SoftBodySystem::solveDistances(float h) {
+  const float invH2 = 1.0f / (h * h);
+  float *px = x.data(), *py = y.data(), *pz = z.data();
+  const float *w = invMass.data();
+  const int *ia = dA.data(), *ib = dB.data();
+  const float *rest = restLength.data(), *comp = compliance.data();
+
+  // No two constraints in a batch share a particle, so a batch can be
+  // spread across both threads and SIMD lanes.
+#pragma omp parallel
+  for (int k = 0; k < batches.count(); ++k) {
+    const int begin = batches.start[k], end = batches.start[k + 1];
+    if (k == batches.serialBatch) {
+#pragma omp single
+      for (int i = begin; i < end; ++i)
+        projectDistance(i, px, py, pz, w, ia, ib, rest, comp, invH2);
+    } else {
+#pragma omp for simd schedule(simd : static)
+      for (int i = begin; i < end; ++i)
+        projectDistance(i, px, py, pz, w, ia, ib, rest, comp, invH2);
+    }
+  }
+}
+
+// Quaternion helpers for the shape matching rotation fit, (w, x, y, z).
+static void quatToMatrix(const float q[4], float m[3][3]) {
+  float w = q[0], a = q[1], b = q[2], c = q[3];
+  m[0][0] = 1 - 2 * (b * b + c * c);
+  m[0][1] = 2 * (a * b - w * c);
+  m[0][2] = 2 * (a * c + w * b);
+  m[1][0] = 2 * (a * b + w * c);
+  m[1][1] = 1 - 2 * (a * a + c * c);
+  m[1][2] = 2 * (b * c - w * a);
+  m[2][0] = 2 * (a * c - w * b);
+  m[2][1] = 2 * (b * c + w * a);
+  m[2][2] = 1 - 2 * (a * a + b * b);
+}
+
+// The rotation closest to A, by rotating towards it a few times starting
+// from last step's answer (Mueller et al., "A Robust Method to Extract the
+// Rotational Part of Deformations"). Cheaper and better behaved than a
+// polar decomposition for nearly-rigid blobs.
+static void fitRotation(const float A[3][3], float q[4]) {
+  for (int iter = 0; iter < 8; ++iter) {
+    float R[3][3];
+    quatToMatrix(q, R);
+    float ox = 0.0f, oy = 0.0f, oz = 0.0f, dot = 0.0f;
+    for (int c = 0; c < 3; ++c) {
+      // column c of R crossed with column c of A
+      float rx = R[0][c], ry = R[1][c], rz = R[2][c];
+      float ax = A[0][c], ay = A[1][c], az = A[2][c];
+      ox += ry * az - rz * ay;
+      oy += rz * ax - rx * az;
+      oz += rx * ay - ry * ax;
+      dot += rx * ax + ry * ay + rz * az;
+    }
+    float scale = 1.0f / (std::abs(dot) + 1e-9f);
+    ox *= scale;
+    oy *= scale;
+    oz *= scale;
+    float angle = std::sqrt(ox * ox + oy * oy + oz * oz);
+    if (angle < 1e-6f)
+      break;
+    float s = std::sin(0.5f * angle) / angle, c = std::cos(0.5f * angle);
+    float r[4] = {c, ox * s, oy * s, oz * s};
+    float n[4] = {r[0] * q[0] - r[1] * q[1] - r[2] * q[2] - r[3] * q[3],
+                  r[0] * q[1] + r[1] * q[0] + r[2] * q[3] - r[3] * q[2],
+                  r[0] * q[2] - r[1] * q[3] + r[2] * q[0] + r[3] * q[1],
+                  r[0] * q[3] + r[1] * q[2] - r[2] * q[1] + r[3] * q[0]};
+    float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2] + n[3] * n[3]);
+    for (int k = 0; k < 4; ++k)
+      q[k] = n[k] / len;
+  }
+}
+
+void SoftBodySystem::solveShapes() {
+  const int count = int(clusters.size());
+
+#pragma omp parallel for schedule(dynamic)
+  for (int k = 0; k < count; ++k) {
+    ShapeCluster &sc = clusters[k];
+    const int first = sc.first, n = sc.count;
+
+    // blob particles all weigh the same, so the centroid is a plain mean
+    float cx = 0.0f, cy = 0.0f, cz = 0.0f;
+    for (int i = 0; i < n; ++i) {
+      cx += x[first + i];
+      cy += y[first + i];
+      cz += z[first + i];
+    }
+    cx /= float(n);
+    cy /= float(n);
+    cz /= float(n);
+
+    // A = sum (p - c) rest^T
+    float A[3][3] = {};
+    for (int i = 0; i < n; ++i) {
+      float p[3] = {x[first + i] - cx, y[first + i] - cy, z[first + i] - cz};
+      float r[3] = {sc.restX[i], sc.restY[i], sc.restZ[i]};
+      for (int row = 0; row < 3; ++row)
+        for (int col = 0; col < 3; ++col)
+          A[row][col] += p[row] * r[col];
+    }
+    fitRotation(A, sc.q);
+    float R[3][3];
+    quatToMatrix(sc.q, R);
+
+    for (int i = 0; i < n; ++i) {
+      const int j = first + i;
+      if (invMass[j] == 0.0f)
+        continue;
+      float rx = sc.restX[i], ry = sc.restY[i], rz = sc.restZ[i];
+      float gx = cx + R[0][0] * rx + R[0][1] * ry + R[0][2] * rz;
+      float gy = cy + R[1][0] * rx + R[1][1] * ry + R[1][2] * rz;
+      float gz = cz + R[2][0] * rx + R[2][1] * ry + R[2][2] * rz;
+      x[j] += sc.stiffness * (gx - x[j]);
+      y[j] += sc.stiffness * (gy - y[j]);
+      z[j] += sc.stiffness * (gz - z[j]);
+    }
+  }
+}
+
+void SoftBodySystem::collide() {
+  const int n = int(size());
+
+  // push particles that ended up inside an attractor back to its surface
+#pragma omp parallel
+  for (const SoftAttractor &at : attractors) {
+    const float r2 = at.radius * at.radius;
+#pragma omp for simd schedule(simd : static)
+    for (int i = 0; i < n; ++i) {
+      float dx = x[i] - at.x, dy = y[i] - at.y, dz = z[i] - at.z;
+      float d2 = dx * dx + dy * dy + dz * dz;
+      if (d2 >= r2 || d2 == 0.0f || invMass[i] == 0.0f)
+        continue;
+      float s = at.radius / std::sqrt(d2);
+      x[i] = at.x + dx * s;
+      y[i] = at.y + dy * s;
+      z[i] = at.z + dz * s;
+    }
+  }
+}
+
+void SoftBodySystem::updateVelocities(float h) {
+  const int n = int(size());
+  const float invH = 1.0f / h;
+
+#pragma omp parallel for simd schedule(simd : static)
+  for (int i = 0; i < n; ++i) {
+    vx[i] = (x[i] - prevX[i]) * invH;
+    vy[i] = (y[i] - prevY[i]) * invH;
+    vz[i] = (z[i] - prevZ[i]) * invH;
+  }
+}
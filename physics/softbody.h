@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "coloring.h"
+
+// A gravitating sphere the particles fall towards and can't pass through,
+// such as one of gravity.cpp's bodies. gm is G times its mass in the
+// system's units.
+struct SoftAttractor {
+  float x, y, z;
+  float gm;
+  float radius;
+};
+
+struct SoftBodyParams {
+  float gravityX = 0.0f, gravityY = 0.0f, gravityZ = 0.0f;
+  int subSteps = 8;
+  // velocity kept per second, 1 = no damping
+  float damping = 0.99f;
+  // Attraction is 1 / (d^2 + softening^2) so particles grazing an attractor
+  // don't get flung off.
+  float softening = 0.0f;
+};
+
+// Position-based dynamics for cloth, rope and soft blobs (extended PBD with
+// many small substeps and one constraint pass each). Particles are stored as
+// structure-of-arrays in 3D; 2D scenes leave z at zero.
+//
+// Distance constraints are coloured into batches that share no particles
+// and laid out back to back per batch, so each batch is projected with one
+// vectorised and threaded loop. Soft blobs are kept in shape by shape
+// matching: each blob pulls its particles towards its rest shape, rotated and
+// moved to best fit where they are now.
+class SoftBodySystem {
+public:
+  explicit SoftBodySystem(const SoftBodyParams &params = SoftBodyParams());
+
+  // mass <= 0 pins the particle in place
+  int addParticle(float x, float y, float z, float mass);
+  // compliance is inverse stiffness (0 is rigid); the rest length is the
+  // current distance
+  void addDistance(int a, int b, float compliance = 0.0f);
+
+  // A chain of segments + 1 particles from (x0, y0, z0) to (x1, y1, z1).
+  // Returns the first particle; the chain is contiguous.
+  int addRope(float x0, float y0, float z0, float x1, float y1, float z1,
+              int segments, float mass, float compliance = 0.0f,
+              bool pinStart = true);
+
+  // A (columns x rows) sheet spanned by edge vectors u and v from the
+  // origin, with stretch and shear constraints. Particle (i, j) is
+  // first + j * columns + i. pinTop pins both corners of the last row.
+  int addCloth(float ox, float oy, float oz, float ux, float uy, float uz,
+               float vx, float vy, float vz, int columns, int rows,
+               float mass, float compliance = 0.0f, bool pinTop = true);
+
+  // A ball of particles on a lattice inside the given radius, held together
+  // by shape matching with the given stiffness (0..1 per substep).
+  int addBlob(float cx, float cy, float cz, float radius, int across,
+              float mass, float stiffness);
+
+  void clear();
+  size_t size() const { return x.size(); }
+  size_t distanceCount() const { return dA.size(); }
+
+  void step(float dt);
+
+  SoftBodyParams params;
+  std::vector<SoftAttractor> attractors;
+
+  // per particle state
+  std::vector<float> x, y, z;
+  std::vector<float> vx, vy, vz;
+  std::vector<float> invMass;
+
+  // Distance constraint endpoints in solve order (by batch); handy for
+  // drawing cloth and rope as lines.
+  const std::vector<int> &distanceA() {
+    prepare();
+    return dA;
+  }
+  const std::vector<int> &distanceB() {
+    prepare();
+    return dB;
+  }
+
+private:
+  // Particles first + 0 .. count-1 matched to their rest offsets.
+  struct ShapeCluster {
+    int first, count;
+    float stiffness;
+    std::vector<float> restX, restY, restZ; // offsets from the rest centroid
+    float q[4] = {1.0f, 0.0f, 0.0f, 0.0f};  // last fitted rotation (w, x, y, z)
+  };
+
+  void prepare();
+  void predict(float h);
+  void solveDistances(float h);
+  void solveShapes();
+  void collide();
+  void updateVelocities(float h);
+
+  // distance constraints, structure-of-arrays
+  std::vector<int> dA, dB;
+  std::vector<float> restLength, compliance;
+  ConstraintBatches batches;
+  bool batchesDirty = false;
+
+  std::vector<ShapeCluster> clusters;
+  std::vector<float> prevX, prevY, prevZ;
+};
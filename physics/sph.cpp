@@ -0,0 +1,430 @@
+#include "sph.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Cubic spline (M4) kernel with support 2h: W = w(r / h) / (pi h^3).
+inline double kernel(double q) {
+  double t = 2.0 - q;
+  return q < 1.0 ? 1.0 - 1.5 * q * q + 0.75 * q * q * q
+                 : (q < 2.0 ? 0.25 * t * t * t : 0.0);
+}
+
+// w'(q) / q, so grad W = slope(r / h) / (pi h^5) * (r_i - r_j). Takes 1 / q
+// as well so the pair loop shares one division between both kernels.
+inline double kernelSlope(double q, double invQ) {
+  double t = 2.0 - q;
+  return q < 1.0 ? -3.0 + 2.25 * q : (q < 2.0 ? -0.75 * t * t * invQ : 0.0);
+}
+
+template <typename T>
+void reorder(std::vector<T> &v, const std::vector<int> &order,
+             std::vector<T> &scratch) {
+  scratch.resize(v.size());
+  for (size_t k = 0; k < v.size(); ++k)
+    scratch[k] = v[order[k]];
+  v.swap(scratch);
+}
+
+} // namespace
+
+SphGas::SphGas(const SphParams &params) : params(params) {}
+
+void SphGas::addParticle(double px, double py, double pz, double pvx,
+                         double pvy, double pvz, double m, double energy) {
+  id.push_back(uint32_t(x.size()));
+  x.push_back(px);
+  y.push_back(py);
+  z.push_back(pz);
+  vx.push_back(pvx);
+  vy.push_back(pvy);
+  vz.push_back(pvz);
+  mass.push_back(m);
+  u.push_back(energy);
+  h.push_back(0.0); // guessed from the spacing on the first step
+  forcesValid = false;
+}
+
+void SphGas::addCloud(double cx, double cy, double cz, double radius,
+                      size_t count, double totalMass, double energy,
+                      double omega, uint32_t seed) {
+  uint32_t state = seed ? seed : 1;
+  auto random = [&]() {
+    // xorshift32, uniform in [-1, 1)
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return double(state) / 2147483648.0 - 1.0;
+  };
+
+  const double m = count ? totalMass / double(count) : 0.0;
+  for (size_t n = 0; n < count;) {
+    double px = random(), py = random(), pz = random();
+    if (px * px + py * py + pz * pz >= 1.0)
+      continue;
+    px *= radius;
+    py *= radius;
+    pz *= radius;
+    addParticle(cx + px, cy + py, cz + pz, -omega * py, omega * px, 0.0, m,
+                energy);
+    ++n;
+  }
+}
+
+void SphGas::clear() {
+  for (auto *v : {&x, &y, &z, &vx, &vy, &vz, &mass, &u, &h})
+    v->clear();
+  id.clear();
+  forcesValid = false;
+}
+
+void SphGas::sortIntoCells() {
+  const size_t n = size();
+  double lo[3] = {x[0], y[0], z[0]}, hi[3] = {x[0], y[0], z[0]};
+  for (size_t i = 0; i < n; ++i) {
+    lo[0] = std::min(lo[0], x[i]);
+    lo[1] = std::min(lo[1], y[i]);
+    lo[2] = std::min(lo[2], z[i]);
+    hi[0] = std::max(hi[0], x[i]);
+    hi[1] = std::max(hi[1], y[i]);
+    hi[2] = std::max(hi[2], z[i]);
+  }
+
+  // Cells are 2h wide for a typical particle, so most search only the 27
+  // cells around them; particles with larger h reach further out.
+  const double extent =
+      std::max({hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2], 1e-300});
+  std::vector<double> sorted(h);
+  std::nth_element(sorted.begin(), sorted.begin() + n / 2, sorted.end());
+  cellSize = std::max(2.0 * sorted[n / 2], extent * 1e-6);
+  auto cellsAlong = [&](int axis) {
+    return std::max(1, int((hi[axis] - lo[axis]) / cellSize) + 1);
+  };
+  // keep empty cells from dominating when a few particles wander off
+  const double maxCells = 2.0 * double(n) + 64.0;
+  while (double(cellsAlong(0)) * cellsAlong(1) * cellsAlong(2) > maxCells)
+    cellSize *= 1.25;
+  cellsX = cellsAlong(0);
+  cellsY = cellsAlong(1);
+  cellsZ = cellsAlong(2);
+  originX = lo[0];
+  originY = lo[1];
+  originZ = lo[2];
+
+  // counting sort by cell
+  std::vector<int> cell(n);
+  cellStart.assign(size_t(cellsX) * cellsY * cellsZ + 1, 0);
+  for (size_t i = 0; i < n; ++i) {
+    cell[i] = cellOf(i);
+    ++cellStart[cell[i] + 1];
+  }
+  for (size_t c = 1; c < cellStart.size(); ++c)
+    cellStart[c] += cellStart[c - 1];
+  order.resize(n);
+  std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+  for (size_t i = 0; i < n; ++i)
+    order[fill[cell[i]]++] = int(i);
+
+  std::vector<double> scratch;
+  for (auto *v : {&x, &y, &z, &vx, &vy, &vz, &mass, &u, &h, &ax, &ay, &az,
+                  &dudt})
+    if (v->size() == n)
+      reorder(*v, order, scratch);
+  std::vector<uint32_t> idScratch;
+  reorder(id, order, idScratch);
+
+  // A pair interacts out to twice the larger of their smoothing lengths, so
+  // a particle in cell c must also search as far as any particle that can
+  // reach c. Stamp each cell's reach onto the cells around it.
+  const int cellCount = cellsX * cellsY * cellsZ;
+  std::vector<int> ownReach(cellCount, 0);
+  for (size_t i = 0; i < n; ++i)
+    ownReach[cell[order[i]]] =
+        std::max(ownReach[cell[order[i]]], reachOf(h[i]));
+  cellReach.assign(cellCount, 1);
+  for (int c = 0; c < cellCount; ++c) {
+    const int k = ownReach[c];
+    if (k <= 1)
+      continue;
+    const int ix = c % cellsX, iy = (c / cellsX) % cellsY,
+              iz = c / (cellsX * cellsY);
+    for (int cz = std::max(iz - k, 0); cz <= std::min(iz + k, cellsZ - 1); ++cz)
+      for (int cy = std::max(iy - k, 0); cy <= std::min(iy + k, cellsY - 1);
+           ++cy)
+        for (int cx = std::max(ix - k, 0); cx <= std::min(ix + k, cellsX - 1);
+             ++cx) {
+          int &reach = cellReach[(cz * cellsY + cy) * cellsX + cx];
+          reach = std::max(reach, k);
+        }
+  }
+}
+
+int SphGas::reachOf(double smoothing) const {
+  // particles d cells apart are more than (d - 1) cells apart
+  return std::max(1, int(std::ceil(2.0 * smoothing / cellSize)));
+}
+
+int SphGas::cellOf(size_t i) const {
+  const int ix = std::min(int((x[i] - originX) / cellSize), cellsX - 1);
+  const int iy = std::min(int((y[i] - originY) / cellSize), cellsY - 1);
+  const int iz = std::min(int((z[i] - originZ) / cellSize), cellsZ - 1);
+  return (iz * cellsY + iy) * cellsX + ix;
+}
+
+// Calls run(begin, end) for each run of particles within reach cells of
+// particle i: each row of cells along x is contiguous in the arrays.
+template <typename F>
+void SphGas::forNeighbourRuns(size_t i, int reach, F &&run) const {
+  const int c = cellOf(i);
+  const int ix = c % cellsX, iy = (c / cellsX) % cellsY,
+            iz = c / (cellsX * cellsY);
+  const int x0 = std::max(ix - reach, 0),
+            x1 = std::min(ix + reach, cellsX - 1);
+  for (int cz = std::max(iz - reach, 0);
+       cz <= std::min(iz + reach, cellsZ - 1); ++cz) {
+    for (int cy = std::max(iy - reach, 0);
+         cy <= std::min(iy + reach, cellsY - 1); ++cy) {
+      const int row = (cz * cellsY + cy) * cellsX;
+      run(cellStart[row + x0], cellStart[row + x1 + 1]);
+    }
+  }
+}
+
+void SphGas::computeDensity() {
+  const int n = int(size());
+  rho.resize(n);
+  pressure.resize(n);
+  soundSpeed.resize(n);
+  pressureTerm.resize(n);
+  const double *px = x.data(), *py = y.data(), *pz = z.data(),
+               *pm = mass.data();
+  const double gamma = params.gamma;
+
+#pragma omp parallel for schedule(dynamic, 64)
+  for (int i = 0; i < n; ++i) {
+    const double xi = px[i], yi = py[i], zi = pz[i];
+    const double invH = 1.0 / h[i];
+    double sum = 0.0;
+    forNeighbourRuns(i, reachOf(h[i]), [&](int begin, int end) {
+#pragma omp simd reduction(+ : sum)
+      for (int j = begin; j < end; ++j) {
+        double dx = xi - px[j], dy = yi - py[j], dz = zi - pz[j];
+        double q = std::sqrt(dx * dx + dy * dy + dz * dz) * invH;
+        sum += pm[j] * kernel(q);
+      }
+    });
+    const double density = sum * invH * invH * invH / kPi;
+    rho[i] = density;
+    pressure[i] = (gamma - 1.0) * density * u[i];
+    soundSpeed[i] = std::sqrt(gamma * (gamma - 1.0) * u[i]);
+    pressureTerm[i] = pressure[i] / (density * density);
+  }
+}
+
+void SphGas::computeForces() {
+  const int n = int(size());
+  ax.resize(n);
+  ay.resize(n);
+  az.resize(n);
+  dudt.resize(n);
+  signalSpeed.resize(n);
+  const double *px = x.data(), *py = y.data(), *pz = z.data();
+  const double *pvx = vx.data(), *pvy = vy.data(), *pvz = vz.data();
+  const double *pm = mass.data(), *ph = h.data(), *prho = rho.data(),
+               *pc = soundSpeed.data(), *pterm = pressureTerm.data();
+  const double alpha = params.alpha, beta = params.beta;
+
+  // per particle 1 / h and 1 / (pi h^5), to keep divisions out of the pairs
+  invH.resize(n);
+  gradScale.resize(n);
+#pragma omp parallel for simd
+  for (int i = 0; i < n; ++i) {
+    double inv = 1.0 / ph[i];
+    invH[i] = inv;
+    gradScale[i] = inv * inv * inv * inv * inv / kPi;
+  }
+  const double *pinvH = invH.data(), *pscale = gradScale.data();
+
+#pragma omp parallel for schedule(dynamic, 64)
+  for (int i = 0; i < n; ++i) {
+    const double xi = px[i], yi = py[i], zi = pz[i];
+    const double vxi = pvx[i], vyi = pvy[i], vzi = pvz[i];
+    const double hi = ph[i], rhoi = prho[i], ci = pc[i], termi = pterm[i];
+    const double invHi = pinvH[i], scaleI = pscale[i];
+    double sx = 0.0, sy = 0.0, sz = 0.0, work = 0.0, vsig = 2.0 * ci;
+    const int reach = std::max(reachOf(hi), cellReach[cellOf(i)]);
+
+    forNeighbourRuns(i, reach, [&](int begin, int end) {
+#pragma omp simd reduction(+ : sx, sy, sz, work) reduction(max : vsig)
+      for (int j = begin; j < end; ++j) {
+        double dx = xi - px[j], dy = yi - py[j], dz = zi - pz[j];
+        double dvx = vxi - pvx[j], dvy = vyi - pvy[j], dvz = vzi - pvz[j];
+        double r2 = dx * dx + dy * dy + dz * dz;
+        double r = std::sqrt(r2);
+        double invR = r > 0.0 ? 1.0 / r : 0.0;
+        // kernel gradient averaged over both smoothing lengths keeps the
+        // pair forces equal and opposite
+        double g = 0.5 * (kernelSlope(r * invHi, hi * invR) * scaleI +
+                          kernelSlope(r * pinvH[j], ph[j] * invR) * pscale[j]);
+
+        // viscosity only between particles closing on each other
+        double vr = dvx * dx + dvy * dy + dvz * dz;
+        double hij = 0.5 * (hi + ph[j]);
+        double mu = vr < 0.0 ? hij * vr / (r2 + 0.01 * hij * hij) : 0.0;
+        double cij = 0.5 * (ci + pc[j]);
+        double visc = (-alpha * cij * mu + beta * mu * mu) /
+                      (0.5 * (rhoi + prho[j]));
+
+        double f = pm[j] * (termi + pterm[j] + visc) * g;
+        sx -= f * dx;
+        sy -= f * dy;
+        sz -= f * dz;
+        work += pm[j] * (termi + 0.5 * visc) * g * vr;
+
+        double w = vr < 0.0 ? vr * invR : 0.0;
+        double signal = ci + pc[j] - 3.0 * w;
+        vsig = std::max(vsig, g != 0.0 ? signal : 0.0);
+      }
+    });
+    ax[i] = sx;
+    ay[i] = sy;
+    az[i] = sz;
+    dudt[i] = work;
+    signalSpeed[i] = vsig;
+  }
+
+  if (!params.selfGravity)
+    return;
+  gx.resize(n);
+  gy.resize(n);
+  gz.resize(n);
+  if (size() < params.directLimit) {
+    gravityDirect(n, px, py, pz, pm, params.G, params.softening, gx.data(),
+                  gy.data(), gz.data());
+  } else {
+    tree.build(n, px, py, pz, pm);
+    tree.accelerations(params.G, params.softening, params.theta, gx.data(),
+                       gy.data(), gz.data());
+  }
+#pragma omp parallel for simd
+  for (int i = 0; i < n; ++i) {
+    ax[i] += gx[i];
+    ay[i] += gy[i];
+    az[i] += gz[i];
+  }
+}
+
+void SphGas::updateSmoothing(double maxChange) {
+  const int n = int(size());
+  const double eta = params.eta;
+#pragma omp parallel for
+  for (int i = 0; i < n; ++i) {
+    double target = eta * std::cbrt(mass[i] / rho[i]);
+    h[i] = std::clamp(target, h[i] / maxChange, h[i] * maxChange);
+  }
+}
+
+void SphGas::prime() {
+  const int n = int(size());
+  // Guess h from the mean spacing in the bounding box, then let the
+  // density settle it before the first forces.
+  double lo[3] = {x[0], y[0], z[0]}, hi[3] = {x[0], y[0], z[0]};
+  for (int i = 0; i < n; ++i) {
+    lo[0] = std::min(lo[0], x[i]);
+    lo[1] = std::min(lo[1], y[i]);
+    lo[2] = std::min(lo[2], z[i]);
+    hi[0] = std::max(hi[0], x[i]);
+    hi[1] = std::max(hi[1], y[i]);
+    hi[2] = std::max(hi[2], z[i]);
+  }
+  double volume = std::max((hi[0] - lo[0]) * (hi[1] - lo[1]) *
+                               (hi[2] - lo[2]),
+                           1e-300);
+  double guess = params.eta * std::cbrt(volume / n);
+  for (int i = 0; i < n; ++i)
+    if (h[i] <= 0.0)
+      h[i] = guess;
+  for (int pass = 0; pass < 3; ++pass) {
+    sortIntoCells();
+    computeDensity();
+    updateSmoothing(4.0);
+  }
+  sortIntoCells();
+  computeDensity();
+  computeForces();
+  forcesValid = true;
+}
+
+void SphGas::step(double dt) {
+  const int n = int(size());
+  if (n == 0)
+    return;
+
+  if (!forcesValid)
+    prime();
+
+  // kick, drift
+  const double half = 0.5 * dt, minEnergy = params.minEnergy;
+#pragma omp parallel for simd
+  for (int i = 0; i < n; ++i) {
+    vx[i] += ax[i] * half;
+    vy[i] += ay[i] * half;
+    vz[i] += az[i] * half;
+    u[i] = std::max(u[i] + dudt[i] * half, minEnergy);
+    x[i] += vx[i] * dt;
+    y[i] += vy[i] * dt;
+    z[i] += vz[i] * dt;
+  }
+
+  sortIntoCells();
+  computeDensity();
+  computeForces();
+  updateSmoothing(1.25);
+
+  // kick
+#pragma omp parallel for simd
+  for (int i = 0; i < n; ++i) {
+    vx[i] += ax[i] * half;
+    vy[i] += ay[i] * half;
+    vz[i] += az[i] * half;
+    u[i] = std::max(u[i] + dudt[i] * half, minEnergy);
+  }
+}
+
+double SphGas::stableTimestep() {
+  if (size() == 0)
+    return 0.0;
+  if (!forcesValid)
+    prime();
+
+  const int n = int(size());
+  const double courant = params.courant;
+  double dt = 1e300;
+#pragma omp parallel for reduction(min : dt)
+  for (int i = 0; i < n; ++i) {
+    // sound crossing a smoothing length, and not falling through one
+    double a = std::sqrt(ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i]);
+    double sound = signalSpeed[i] > 0.0 ? h[i] / signalSpeed[i] : 1e300;
+    double fall = a > 0.0 ? std::sqrt(h[i] / a) : 1e300;
+    dt = std::min(dt, courant * std::min(sound, fall));
+  }
+  return dt;
+}
+
+double SphGas::kineticEnergy() const {
+  double sum = 0.0;
+  for (size_t i = 0; i < size(); ++i)
+    sum += 0.5 * mass[i] * (vx[i] * vx[i] + vy[i] * vy[i] + vz[i] * vz[i]);
+  return sum;
+}
+
+double SphGas::thermalEnergy() const {
+  double sum = 0.0;
+  for (size_t i = 0; i < size(); ++i)
+    sum += mass[i] * u[i];
+  return sum;
+}
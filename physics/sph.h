@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "gravity.h"
+
+struct SphParams {
+  double gamma = 5.0 / 3.0; // ideal gas, P = (gamma - 1) rho u
+  // h = eta (m / rho)^(1/3); 1.2 gives about 58 neighbours
+  double eta = 1.2;
+
+  // Monaghan artificial viscosity, switched on only between approaching
+  // particles so shocks get a few h wide instead of ringing
+  double alpha = 1.0;
+  double beta = 2.0;
+
+  bool selfGravity = true;
+  double G = 1.0;
+  double softening = 0.01;
+  double theta = 0.5;
+  // below this many particles gravity is summed directly instead of by tree
+  size_t directLimit = 2048;
+
+  double courant = 0.3;
+  double minEnergy = 1e-10; // internal energy never drops below this
+};
+
+// Smoothed-particle hydrodynamics for self-gravitating gas clouds, in 3D and
+// in whatever units G is given in. Particles carry mass and specific internal
+// energy; density comes from the cubic spline kernel over neighbours within
+// 2h, and pressure from the ideal gas law.
+//
+// Every step the particles are sorted into a uniform grid of cells 2h wide
+// for a typical h (a counting sort), and all per-particle arrays are
+// reordered to match. Neighbours then lie in a few contiguous runs of the
+// arrays (one per row of cells), which the density and force loops sum with
+// SIMD, one thread per block of particles. Because of the reordering an index is only
+// good until the next step; id[] follows each particle around.
+//
+// Time stepping is kick-drift-kick leapfrog. Self-gravity goes through
+// GravityTree (or gravityDirect for small clouds).
+class SphGas {
+public:
+  explicit SphGas(const SphParams &params = SphParams());
+
+  void addParticle(double x, double y, double z, double vx, double vy,
+                   double vz, double mass, double energy);
+  // A uniform ball of count particles of total mass and specific internal
+  // energy u, spinning at angular velocity omega about z. Same seed, same
+  // ball.
+  void addCloud(double cx, double cy, double cz, double radius, size_t count,
+                double mass, double u, double omega = 0.0,
+                uint32_t seed = 1);
+
+  void clear();
+  size_t size() const { return x.size(); }
+
+  void step(double dt);
+  // Largest dt the Courant condition allows for the current state.
+  double stableTimestep();
+
+  double kineticEnergy() const;
+  double thermalEnergy() const;
+
+  SphParams params;
+
+  // per particle state, reordered every step
+  std::vector<double> x, y, z;
+  std::vector<double> vx, vy, vz;
+  std::vector<double> mass;
+  std::vector<double> u; // specific internal energy
+  std::vector<double> h; // smoothing length
+  std::vector<uint32_t> id;
+
+  // derived each step
+  std::vector<double> rho, pressure, soundSpeed;
+  std::vector<double> ax, ay, az, dudt;
+
+private:
+  // first h, density and forces for new particles
+  void prime();
+  void sortIntoCells();
+  void computeDensity();
+  void computeForces();
+  // new h from density, changing by at most maxChange times per call
+  void updateSmoothing(double maxChange);
+  int reachOf(double smoothing) const;
+  int cellOf(size_t i) const;
+  template <typename F>
+  void forNeighbourRuns(size_t i, int reach, F &&run) const;
+
+  // uniform grid over the particles' bounding box, x fastest
+  double originX = 0.0, originY = 0.0, originZ = 0.0;
+  double cellSize = 1.0;
+  int cellsX = 1, cellsY = 1, cellsZ = 1;
+  std::vector<int> cellStart;
+  // how many cells out a particle in each cell has to search for forces
+  std::vector<int> cellReach;
+
+  // largest signal speed seen by each particle in the last force pass
+  std::vector<double> signalSpeed;
+  std::vector<double> pressureTerm; // P / rho^2
+  std::vector<double> invH, gradScale;
+  std::vector<int> order;
+  std::vector<double> gx, gy, gz;
+  GravityTree tree;
+
+  bool forcesValid = false;
+};
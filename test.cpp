@@ -8,6 +8,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "physics/nbody.h"
 
 // Constants
 const float G = 6.67430e-11f;  // Gravitational constant
@@ -83,31 +84,14 @@ struct Body {
         : mass(m), position(pos), velocity(vel), radius(rad), r(red), g(green), b(blue) {}
 };
 
-// Function to compute the gravitational force between two bodies
-Vec3 computeGravitationalForce(const Body& body1, const Body& body2) {
-    Vec3 diff = body2.position - body1.position;
-    float dist = diff.length();
-    float forceMagnitude = (G * body1.mass * body2.mass) / (dist * dist);
-    Vec3 force = diff * (forceMagnitude / dist);  // Force vector points towards body2
-    return force;
-}
-
-// Function to update positions and velocities of bodies using basic physics
-void updatePhysics(std::vector<Body>& bodies, float dt) {
+// Function to step the bodies with the physics library. The system keeps its
+// own copy of the state, so positions and velocities are copied back for
+// drawing.
+void updatePhysics(NBodySystem& system, std::vector<Body>& bodies, float dt) {
+    system.step(dt);
     for (size_t i = 0; i < bodies.size(); ++i) {
-        Vec3 netForce(0.0f, 0.0f, 0.0f);
-        for (size_t j = 0; j < bodies.size(); ++j) {
-            if (i != j) {
-                netForce = netForce + computeGravitationalForce(bodies[i], bodies[j]);
-            }
-        }
-
-        // Update velocity based on net force (F = ma => a = F/m)
-        Vec3 acceleration = netForce * (1.0f / bodies[i].mass);
-        bodies[i].velocity = bodies[i].velocity + acceleration * dt;
-
-        // Update position based on velocity (v = ds/dt => s = s + v*dt)
-        bodies[i].position = bodies[i].position + bodies[i].velocity * dt;
+        bodies[i].position = Vec3(float(system.bodies.x[i]), float(system.bodies.y[i]), float(system.bodies.z[i]));
+        bodies[i].velocity = Vec3(float(system.bodies.vx[i]), float(system.bodies.vy[i]), float(system.bodies.vz[i]));
     }
 }
 
@@ -237,6 +221,16 @@ int main() {
     bodies.push_back(Body(1e10f, Vec3(2.0f, 0.0f, 0.0f), Vec3(0.0f, 0.5f, 0.0f), 0.1f, 0.0f, 1.0f, 0.0f));
     bodies.push_back(Body(1e10f, Vec3(0.0f, 2.0f, 0.0f), Vec3(0.0f, -0.5f, 0.0f), 0.1f, 0.0f, 0.0f, 1.0f));
 
+    // Hand the bodies to the physics library (kick then drift, like before)
+    NBodyParams params;
+    params.G = G;
+    params.integrator = Integrator::Euler;
+    NBodySystem system(params);
+    for (const Body& body : bodies) {
+        system.addBody(body.position.x, body.position.y, body.position.z,
+                       body.velocity.x, body.velocity.y, body.velocity.z, body.mass, body.radius);
+    }
+
     // Camera position
     glm::vec3 cameraPos(0.0f, 0.0f, 3.0f);
     glm::mat4 view = glm::lookAt(cameraPos, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
@@ -251,7 +245,7 @@ int main() {
         processInput(window, cameraPos, deltaTime);
 
         // Update physics
-        updatePhysics(bodies, deltaTime);
+        updatePhysics(system, bodies, deltaTime);
 
         // Clear screen
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -0,0 +1,103 @@
+/* Drives the C API the way an embedding program would: 10^5 bodies filled
+ * in through the zero-copy arrays, a short step loop, and a read back
+ * through both the arrays and the bulk copies. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "physics/cpphysics.h"
+
+#define BODIES 100000
+#define STEPS 3
+
+static unsigned state = 12345u;
+
+static double uniform(void) {
+  /* xorshift32 in [-1, 1) */
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return (double)state / 2147483648.0 - 1.0;
+}
+
+static int fail(const char *what) {
+  fprintf(stderr, "capi_test: %s\n", what);
+  return 1;
+}
+
+int main(void) {
+  cpphysics_nbody_params params;
+  cpphysics_nbody_arrays arrays, after;
+  cpphysics_nbody *nbody;
+  double *xyz;
+  double momentum[3] = {0.0, 0.0, 0.0};
+  double inward = 0.0;
+  size_t i;
+
+  cpphysics_nbody_default_params(&params);
+  params.G = 1.0;
+  params.softening = 0.01;
+  nbody = cpphysics_nbody_create(&params, BODIES);
+  if (!nbody)
+    return fail("create failed");
+  if (cpphysics_nbody_count(nbody) != BODIES)
+    return fail("wrong count");
+
+  /* a uniform ball at rest, written straight into the arrays */
+  if (cpphysics_nbody_get_arrays(nbody, &arrays) != 0 ||
+      arrays.count != BODIES)
+    return fail("arrays failed");
+  for (i = 0; i < BODIES;) {
+    double x = uniform(), y = uniform(), z = uniform();
+    if (x * x + y * y + z * z >= 1.0)
+      continue;
+    arrays.x[i] = x;
+    arrays.y[i] = y;
+    arrays.z[i] = z;
+    arrays.mass[i] = 1.0 / BODIES;
+    ++i;
+  }
+
+  if (cpphysics_nbody_step(nbody, 1e-3, STEPS) != 0)
+    return fail("step failed");
+  if (fabs(cpphysics_nbody_time(nbody) - STEPS * 1e-3) > 1e-12)
+    return fail("wrong time");
+
+  /* stepping must not move the arrays */
+  cpphysics_nbody_get_arrays(nbody, &after);
+  if (after.x != arrays.x || after.vx != arrays.vx || after.ax != arrays.ax)
+    return fail("arrays moved during step");
+
+  /* the ball starts to fall inwards, with the whole ball staying put */
+  for (i = 0; i < BODIES; ++i) {
+    if (!isfinite(after.x[i]) || !isfinite(after.vx[i]))
+      return fail("non-finite state");
+    inward -= after.vx[i] * after.x[i] + after.vy[i] * after.y[i] +
+              after.vz[i] * after.z[i];
+    momentum[0] += after.mass[i] * after.vx[i];
+    momentum[1] += after.mass[i] * after.vy[i];
+    momentum[2] += after.mass[i] * after.vz[i];
+  }
+  if (inward <= 0.0)
+    return fail("ball not collapsing");
+  if (fabs(momentum[0]) + fabs(momentum[1]) + fabs(momentum[2]) > 1e-5)
+    return fail("momentum not conserved");
+
+  /* bulk copies agree with the arrays */
+  xyz = malloc(sizeof(double) * 3 * BODIES);
+  if (!xyz)
+    return fail("out of memory");
+  if (cpphysics_nbody_get_positions(nbody, xyz, BODIES) != 0)
+    return fail("get_positions failed");
+  for (i = 0; i < BODIES; ++i)
+    if (xyz[3 * i] != after.x[i] || xyz[3 * i + 2] != after.z[i])
+      return fail("bulk copy differs from arrays");
+  if (cpphysics_nbody_get_positions(nbody, xyz, BODIES - 1) == 0)
+    return fail("size mismatch accepted");
+  free(xyz);
+
+  cpphysics_nbody_destroy(nbody);
+  printf("capi_test: %d bodies, %d steps ok\n", BODIES, STEPS);
+  return 0;
+}
@@ -0,0 +1,127 @@
+// Checks the compensated float sums against double precision, both in the
+// packed gravity sum and in FloatBodies' integrator state: plain float has
+// to come out well behind Kahan and float-float, which have to land close
+// to each other.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "physics/floatbodies.h"
+#include "physics/gravity.h"
+#include "physics/models.h"
+#include "physics/nbody.h"
+
+namespace {
+
+const FloatSum sums[] = {FloatSum::Plain, FloatSum::Kahan, FloatSum::Neumaier,
+                         FloatSum::FloatFloat};
+
+// the largest error of the packed sum's accelerations relative to the
+// largest acceleration, against the double sum of the same float inputs
+void accelerationErrors(double errors[4]) {
+  BodyStore b;
+  addPlummerSphere(b, 8192, 1.0, 1.0, 1.0);
+  const size_t n = b.size();
+  std::vector<float> x(b.x.begin(), b.x.end()), y(b.y.begin(), b.y.end()),
+      z(b.z.begin(), b.z.end()), m(b.mass.begin(), b.mass.end());
+  std::vector<double> dx(x.begin(), x.end()), dy(y.begin(), y.end()),
+      dz(z.begin(), z.end()), dm(m.begin(), m.end());
+  std::vector<double> rx(n), ry(n), rz(n);
+  gravityDirect(n, dx.data(), dy.data(), dz.data(), dm.data(), 1.0, 0.01,
+                rx.data(), ry.data(), rz.data());
+  double largest = 0.0;
+  for (size_t i = 0; i < n; ++i)
+    largest = std::max(largest, std::hypot(rx[i], ry[i], rz[i]));
+
+  std::vector<float> ax(n), ay(n), az(n);
+  for (int k = 0; k < 4; ++k) {
+    gravityDirectPacked(n, x.data(), y.data(), z.data(), m.data(), 1.0f, 0.01f,
+                        ax.data(), ay.data(), az.data(), sums[k]);
+    errors[k] = 0.0;
+    for (size_t i = 0; i < n; ++i)
+      errors[k] = std::max(errors[k], std::hypot(ax[i] - rx[i], ay[i] - ry[i],
+                                                 az[i] - rz[i]));
+    errors[k] /= largest;
+  }
+}
+
+// how far a wide binary far from the origin strays from the same leapfrog
+// in double precision. Each drift is a few ulps of the coordinates, so the
+// rounding of the state, not of the weak forces, is what shows.
+void stateErrors(double errors[4]) {
+  const long steps = 100000;
+  const float dt = 1e-4f;
+  const double start[2][6] = {{100.0, 50.0, 0.0, 1.0, 0.5, 0.0},
+                              {120.0, 50.0, 0.0, 1.0, 0.3, 0.0}};
+
+  // the reference
+  double s[2][6];
+  std::copy(&start[0][0], &start[0][0] + 12, &s[0][0]);
+  double a[2][3];
+  auto forces = [&] {
+    double d[3], r2 = 0.0;
+    for (int c = 0; c < 3; ++c) {
+      d[c] = s[1][c] - s[0][c];
+      r2 += d[c] * d[c];
+    }
+    double f = 1.0 / (r2 * std::sqrt(r2));
+    for (int c = 0; c < 3; ++c) {
+      a[0][c] = d[c] * f;
+      a[1][c] = -d[c] * f;
+    }
+  };
+  forces();
+  for (long k = 0; k < steps; ++k) {
+    for (int i = 0; i < 2; ++i)
+      for (int c = 0; c < 3; ++c) {
+        s[i][c + 3] += 0.5 * double(dt) * a[i][c];
+        s[i][c] += double(dt) * s[i][c + 3];
+      }
+    forces();
+    for (int i = 0; i < 2; ++i)
+      for (int c = 0; c < 3; ++c)
+        s[i][c + 3] += 0.5 * double(dt) * a[i][c];
+  }
+
+  for (int k = 0; k < 4; ++k) {
+    FloatBodies b(sums[k]);
+    for (int i = 0; i < 2; ++i)
+      b.add(float(start[i][0]), float(start[i][1]), float(start[i][2]),
+            float(start[i][3]), float(start[i][4]), float(start[i][5]), 1.0f);
+    stepFloatBodies(b, 1.0f, 0.0f, dt, steps, Executor(Backend::Serial));
+    errors[k] = 0.0;
+    for (int i = 0; i < 2; ++i)
+      errors[k] = std::max(errors[k], std::hypot(b.x[i] - s[i][0],
+                                                 b.y[i] - s[i][1],
+                                                 b.z[i] - s[i][2]));
+  }
+}
+
+int check(const char *what, const double errors[4]) {
+  std::printf("%s: plain %.3e, kahan %.3e, neumaier %.3e, float-float "
+              "%.3e\n",
+              what, errors[0], errors[1], errors[2], errors[3]);
+  // plain well behind, the two compensated ones within a few times of
+  // each other
+  const double kahan = errors[1], floatFloat = errors[3];
+  if (errors[0] > 4.0 * std::max(kahan, floatFloat) &&
+      std::max(kahan, floatFloat) < 4.0 * std::min(kahan, floatFloat) &&
+      errors[2] < errors[0] / 4.0)
+    return 0;
+  std::fprintf(stderr, "compensated_test: %s errors out of order\n", what);
+  return 1;
+}
+
+} // namespace
+
+int main() {
+  double errors[4];
+  int failures = 0;
+  accelerationErrors(errors);
+  failures += check("accelerations", errors);
+  stateErrors(errors);
+  failures += check("state", errors);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,55 @@
+// Checks that each composition reaches its order: a Kepler orbit run for
+// one period should come back to its start, and halving the step should
+// cut the miss by 2^order. A mistyped weight drops a method to second
+// order, or worse.
+
+#include <cmath>
+#include <cstdio>
+
+#include "physics/fewbody.h"
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+
+// how far a test particle on an e = 0.3, a = 1 orbit misses its start
+// after one period in steps steps
+double miss(const CompositionWeights &w, long steps) {
+  const double e = 0.3;
+  FewBodyState<2> s = {};
+  s.mass[0] = 1.0;
+  s.x[1] = 1.0 - e;
+  s.vy[1] = std::sqrt((1.0 + e) / (1.0 - e));
+  const FewBodyState<2> start = s;
+  stepFewBody(s, 1.0, 0.0, 2.0 * pi / steps, steps, w);
+  return std::hypot(s.x[1] - start.x[1], s.y[1] - start.y[1]);
+}
+
+} // namespace
+
+int main() {
+  // step counts in each method's asymptotic range, well above rounding
+  struct {
+    Composition method;
+    long steps;
+  } runs[] = {{Composition::Leapfrog, 256},
+              {Composition::Yoshida4, 256},
+              {Composition::Suzuki4, 128},
+              {Composition::Yoshida6, 128},
+              {Composition::Yoshida8, 128}};
+
+  int failures = 0;
+  for (const auto &run : runs) {
+    const CompositionWeights w = compositionWeights(run.method);
+    const double coarse = miss(w, run.steps), fine = miss(w, 2 * run.steps);
+    const double order = std::log2(coarse / fine);
+    std::printf("%-9s misses by %.3e, then %.3e: order %.2f\n",
+                compositionName(run.method), coarse, fine, order);
+    if (!(std::fabs(order - w.order) < 0.15)) {
+      std::fprintf(stderr, "composition_test: %s is order %.2f, not %d\n",
+                   compositionName(run.method), order, w.order);
+      ++failures;
+    }
+  }
+  return failures ? 1 : 0;
+}
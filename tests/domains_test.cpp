@@ -0,0 +1,114 @@
+// Runs a Plummer sphere split over three processes, rebalancing on the way,
+// and checks it against the same leapfrog with every pair summed in one
+// process; then checks on a bigger sphere that each process imports only
+// the others' bodies near its own and sums far fewer than all of them.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "physics/domains.h"
+#include "physics/gravity.h"
+#include "physics/models.h"
+
+namespace {
+
+const size_t bodies = 6000;
+const int steps = 12;
+const double dt = 1e-3;
+
+int fail(const char *what) {
+  std::fprintf(stderr, "domains_test: %s\n", what);
+  return 1;
+}
+
+// kick-drift-kick with the direct sum, the reference
+void leapfrog(BodyStore &b, double G, double eps) {
+  const size_t n = b.size();
+  std::vector<double> ax(n), ay(n), az(n);
+  auto forces = [&] {
+    gravityDirect(n, b.x.data(), b.y.data(), b.z.data(), b.mass.data(), G,
+                  eps, ax.data(), ay.data(), az.data());
+  };
+  forces();
+  for (int step = 0; step < steps; ++step) {
+    for (size_t i = 0; i < n; ++i) {
+      b.vx[i] += 0.5 * dt * ax[i];
+      b.vy[i] += 0.5 * dt * ay[i];
+      b.vz[i] += 0.5 * dt * az[i];
+      b.x[i] += dt * b.vx[i];
+      b.y[i] += dt * b.vy[i];
+      b.z[i] += dt * b.vz[i];
+    }
+    forces();
+    for (size_t i = 0; i < n; ++i) {
+      b.vx[i] += 0.5 * dt * ax[i];
+      b.vy[i] += 0.5 * dt * ay[i];
+      b.vz[i] += 0.5 * dt * az[i];
+    }
+  }
+}
+
+// one step of a 50000-body sphere over four processes
+int checkLocality() {
+  const size_t n = 50000;
+  BodyStore b;
+  addPlummerSphere(b, n, 1.0, 1.0, 1.0);
+  DomainParams params;
+  params.processes = 4;
+  std::vector<DomainStats> stats;
+  if (!runDomains(b, params, dt, 1, &stats))
+    return fail("runDomains failed");
+  for (const DomainStats &domain : stats) {
+    const size_t others = n - domain.bodies;
+    const double perBody = double(domain.interactions) / domain.bodies;
+    std::printf("domains_test: %zu bodies, %zu of %zu others imported, %.0f "
+                "others summed per body\n",
+                domain.bodies, domain.ghosts, others, perBody);
+    if (!(domain.ghosts < others / 2))
+      return fail("a process imported most of the others' bodies");
+    if (!(perBody < others / 10.0))
+      return fail("a process summed most of the others' bodies");
+  }
+  return 0;
+}
+
+} // namespace
+
+int main() {
+  BodyStore split, reference;
+  addPlummerSphere(split, bodies, 1.0, 1.0, 1.0);
+  reference = split;
+
+  DomainParams params;
+  params.processes = 3;
+  params.rebalanceEvery = 5;
+  std::vector<DomainStats> stats;
+  if (!runDomains(split, params, dt, steps, &stats))
+    return fail("runDomains failed");
+  leapfrog(reference, params.G, params.softening);
+
+  size_t owned = 0;
+  for (const DomainStats &domain : stats) {
+    owned += domain.bodies;
+    if (domain.bodies == 0 || domain.multipoles + domain.ghosts == 0)
+      return fail("a process got no work or saw no other process");
+  }
+  if (stats.size() != 3 || owned != bodies)
+    return fail("bodies lost between processes");
+
+  // the tree and the multipoles each cost about 1e-3 of the force, which
+  // over a few steps moves bodies by far less than this
+  double worst = 0.0;
+  for (size_t i = 0; i < bodies; ++i)
+    worst = std::max({worst, std::fabs(split.x[i] - reference.x[i]),
+                      std::fabs(split.y[i] - reference.y[i]),
+                      std::fabs(split.z[i] - reference.z[i])});
+  if (!(worst < 1e-6))
+    return fail("positions differ from the single-process run");
+
+  std::printf("domains_test: %zu bodies over 3 processes, worst %.2g ok\n",
+              bodies, worst);
+  return checkLocality();
+}
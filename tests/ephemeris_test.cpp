@@ -0,0 +1,85 @@
+// Writes a run of the figure-eight three-body orbit to an ephemeris, reads
+// it back and checks its positions against the run's own dense output, at
+// the step ends and half way through each step. The orbit is smooth, as
+// ephemerides assume; close encounters need intervals short enough to
+// follow them.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "physics/denseoutput.h"
+#include "physics/ephemeris.h"
+
+namespace {
+
+const double G = 1.0;
+const double dt = 1e-3;
+const long steps = 5000;
+const char *path = "ephemeris_test.bin";
+
+int fail(const char *what) {
+  std::fprintf(stderr, "ephemeris_test: %s\n", what);
+  std::remove(path);
+  return 1;
+}
+
+} // namespace
+
+int main() {
+  // Chenciner and Montgomery's figure eight, unit masses
+  BodyStore bodies;
+  const double x = 0.97000436, y = -0.24308753;
+  const double vx = -0.93240737, vy = -0.86473146;
+  bodies.add(x, y, 0.0, -0.5 * vx, -0.5 * vy, 0.0, 1.0, 0.1);
+  bodies.add(-x, -y, 0.0, -0.5 * vx, -0.5 * vy, 0.0, 1.0, 0.1);
+  bodies.add(0.0, 0.0, 0.0, vx, vy, 0.0, 1.0, 0.1);
+  FewBodyState<3> s = fewBodiesFrom<3>(bodies);
+
+  EphemerisWriter writer;
+  if (!writer.open(path, bodies, 0.0))
+    return fail("could not create the file");
+  std::vector<DenseStep<3>> run(steps);
+  for (long k = 0; k < steps; ++k) {
+    DenseStep<3> &step = run[k];
+    step.start = s;
+    step.t0 = k * dt;
+    step.h = dt;
+    stepFewBody(s, G, 0.0, dt, 1);
+    step.end = s;
+    copyFewBodies(s, bodies);
+    if (!writer.add(bodies, (k + 1) * dt))
+      return fail("writing failed");
+  }
+  if (!writer.close())
+    return fail("closing failed");
+
+  Ephemeris ephemeris;
+  if (!ephemeris.load(path))
+    return fail("could not read the file back");
+  std::remove(path);
+  if (ephemeris.bodies() != 3 || writer.records() == 0)
+    return fail("wrong shape");
+
+  double worst = 0.0;
+  for (const DenseStep<3> &step : run) {
+    if (step.t0 + step.h > ephemeris.end())
+      break;
+    for (double tau : {0.5, 1.0}) {
+      FewBodyState<3> want = step.at(tau);
+      for (int i = 0; i < 3; ++i) {
+        double p[3];
+        ephemeris.position(i, step.t0 + tau * step.h, p);
+        worst = std::max({worst, std::fabs(p[0] - want.x[i]),
+                          std::fabs(p[1] - want.y[i]),
+                          std::fabs(p[2] - want.z[i])});
+      }
+    }
+  }
+  std::printf("%zu records to t %g, worst position error %.3e\n",
+              writer.records(), ephemeris.end(), worst);
+  if (!(worst <= 1e-8))
+    return fail("positions stray from the dense output");
+  return 0;
+}
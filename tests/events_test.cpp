@@ -0,0 +1,63 @@
+// Callbacks that ask for a Restart without changing anything must not find
+// the same crossing again: each event below has to fire once per crossing,
+// and the run has to reach its end. Events that fall at the same time must
+// all fire.
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "physics/events.h"
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+
+int fail(const char *what) {
+  std::fprintf(stderr, "events_test: %s\n", what);
+  return 1;
+}
+
+} // namespace
+
+int main() {
+  // a light body on an ellipse around a heavy one, a = 1, e = 0.5, for ten
+  // and a quarter periods of 2 pi, starting at apocentre
+  FewBodyState<2> s = {};
+  s.mass[0] = 1.0;
+  s.mass[1] = 1e-9;
+  s.x[1] = 1.5;
+  s.vy[1] = std::sqrt(0.5 / 1.5);
+  const FewBodyState<2> start = s;
+  // the last one twice, to fall at the same times as the one before
+  const std::vector<Event> list = {{EventKind::Pericentre, 0, 1, 0.0},
+                                   {EventKind::Apocentre, 0, 1, 0.0},
+                                   {EventKind::CloseApproach, 0, 1, 1.0},
+                                   {EventKind::CloseApproach, 0, 1, 1.0}};
+
+  const double dt = 1e-3;
+  const long steps = long(std::round(20.5 * pi / dt));
+  for (EventAction action : {EventAction::Restart, EventAction::Continue}) {
+    long counts[4] = {};
+    double t = 0.0;
+    s = start;
+    bool finished = stepWithEvents(s, t, 1.0, 0.0, dt, steps, list,
+                                   [&](size_t k, double, FewBodyState<2> &) {
+                                     ++counts[k];
+                                     return action;
+                                   });
+
+    std::printf("%s: t %g, %ld pericentres, %ld apocentres, %ld and %ld "
+                "close approaches\n",
+                action == EventAction::Restart ? "restart" : "continue", t,
+                counts[0], counts[1], counts[2], counts[3]);
+    if (!finished || std::fabs(t - steps * dt) > 1e-9)
+      return fail("the run didn't reach its end");
+    // the start is an apocentre already, and isn't a crossing
+    if (counts[0] != 10 || counts[1] != 10)
+      return fail("turning points found more or less than once each");
+    if (counts[2] != 10 || counts[3] != 10)
+      return fail("close approaches found more or less than once each");
+  }
+  return 0;
+}
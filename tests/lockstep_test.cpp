@@ -0,0 +1,100 @@
+// Replays a fixed log of lockstep inputs in both fixed-point formats and
+// checks the world's checksum against values recorded once. Every build, on
+// every compiler and machine, has to land on the same bits; a changed
+// checksum means peers of different builds would fall out of sync.
+
+#include <cinttypes>
+#include <cstdio>
+#include <vector>
+
+#include "physics/lockstep.h"
+
+namespace {
+
+const int ticks = 600;
+
+// recorded from this log; update only for deliberate changes to the engine
+const uint64_t expected16 = 0x16118cc4b9a1fed5;
+const uint64_t expected32 = 0x91a4d81b8237cf0b;
+
+template <typename F> LockstepInput add(uint32_t peer, uint32_t sequence,
+                                        F x, F y, F vx, F vy, F radius) {
+  LockstepInput in;
+  in.peer = peer;
+  in.sequence = sequence;
+  in.kind = LockstepInput::AddCircle;
+  in.x = x.raw, in.y = y.raw;
+  in.vx = vx.raw, in.vy = vy.raw;
+  in.radius = radius.raw;
+  return in;
+}
+
+template <typename F>
+LockstepInput push(uint32_t peer, uint32_t sequence, int body, F vx, F vy) {
+  LockstepInput in;
+  in.peer = peer;
+  in.sequence = sequence;
+  in.kind = LockstepInput::Push;
+  in.body = body;
+  in.vx = vx.raw, in.vy = vy.raw;
+  return in;
+}
+
+// a static peg, then two peers dropping circles onto it and pushing them,
+// one push aimed at the peg
+template <typename F> uint64_t replay(const char *name) {
+  FixedCircleWorld<F> world;
+  const F pegX = F(), pegY = F::fromRatio(-1, 2);
+  world.addCircle(pegX, pegY, F(), F(), F::fromRatio(1, 5), F());
+
+  int failures = 0;
+  for (int tick = 0; tick < ticks; ++tick) {
+    std::vector<LockstepInput> inputs;
+    if (tick % 40 == 0 && tick < 400) {
+      // sent in the wrong order on purpose; applyInputs sorts them
+      uint32_t s = uint32_t(tick);
+      inputs.push_back(add<F>(1, s, F::fromRatio(tick / 40 - 5, 4),
+                              F::fromRatio(3, 5), F::fromRatio(1, 3), F(),
+                              F::fromRatio(1, 12)));
+      inputs.push_back(add<F>(0, s, F::fromRatio(5 - tick / 40, 5),
+                              F::fromRatio(4, 5), F::fromRatio(-1, 4), F(),
+                              F::fromRatio(1, 10)));
+    }
+    if (tick % 75 == 30) {
+      inputs.push_back(push<F>(0, uint32_t(tick), tick % 7 + 1,
+                               F::fromRatio(1, 2), F::fromInt(1)));
+      inputs.push_back(push<F>(1, uint32_t(tick), 0, F::fromInt(3), F()));
+    }
+    world.applyInputs(inputs);
+    world.step();
+  }
+
+  if (world.x[0].raw != pegX.raw || world.y[0].raw != pegY.raw) {
+    std::fprintf(stderr, "lockstep_test: %s: the static peg moved\n", name);
+    ++failures;
+  }
+  std::printf("%s: %zu circles after %d ticks, checksum %016" PRIx64 "\n",
+              name, world.size(), ticks, world.checksum());
+  return failures ? 0 : world.checksum();
+}
+
+} // namespace
+
+int main() {
+  int failures = 0;
+  uint64_t sum16 = replay<Fixed16>("Q16.16");
+  uint64_t sum32 = replay<Fixed32>("Q32.32");
+  if (sum16 != expected16) {
+    std::fprintf(stderr, "lockstep_test: Q16.16 checksum %016" PRIx64
+                 ", expected %016" PRIx64 "\n",
+                 sum16, expected16);
+    ++failures;
+  }
+  if (sum32 != expected32) {
+    std::fprintf(stderr, "lockstep_test: Q32.32 checksum %016" PRIx64
+                 ", expected %016" PRIx64 "\n",
+                 sum32, expected32);
+    ++failures;
+  }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,55 @@
+// Runs the three scene with Parareal, converged and to the last iteration,
+// on a serial and a threaded backend, and checks each against the same
+// leapfrog steps taken one after another.
+
+#include <cstdio>
+
+#include "physics/models.h"
+#include "physics/parareal.h"
+
+namespace {
+
+const double G = 1.0;
+const double dt = 1e-3;
+
+int check(const char *what, const FewBodyState<3> &serial,
+          FewBodyState<3> s, const PararealParams &params,
+          const Executor &executor) {
+  PararealStats stats = runParareal(s, G, 0.0,
+                                    dt * params.fineSteps * params.slices,
+                                    params, executor);
+  const double differs = parareal::change(serial, s);
+  std::printf("%s, %s backend: %d iterations, differs by %.3e\n", what,
+              backendName(executor.backend()), stats.iterations, differs);
+  if (differs > 1e-12) {
+    std::fprintf(stderr, "parareal_test: %s differs from serial by %.3e\n",
+                 what, differs);
+    return 1;
+  }
+  return 0;
+}
+
+} // namespace
+
+int main() {
+  BodyStore bodies;
+  addThreeBodies(bodies, 1.0, 1.0, G);
+  const FewBodyState<3> start = fewBodiesFrom<3>(bodies);
+
+  PararealParams params;
+  params.slices = 8;
+  params.fineSteps = 2500;
+  params.coarseSteps = 25;
+  FewBodyState<3> serial = start;
+  stepFewBody(serial, G, 0.0, dt, params.fineSteps * params.slices);
+
+  int failures = 0;
+  for (Backend backend : {Backend::Serial, Backend::ThreadPool}) {
+    const Executor executor(backend, 4);
+    failures += check("converged", serial, start, params, executor);
+    PararealParams all = params;
+    all.tolerance = 0.0;
+    failures += check("every iteration", serial, start, all, executor);
+  }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,76 @@
+// Checks retarded gravity's Newtonian limit: as c grows, the step has to
+// fall onto the few-body leapfrog it delays, and below that the orbit's
+// departure from it has to shrink as 1 / c. A history started with no room
+// has to grow into the same orbit without dropping a state it needs.
+
+#include <cmath>
+#include <cstdio>
+
+#include "physics/fewbody.h"
+#include "physics/retarded.h"
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+const double dt = 1e-3;
+const long steps = 62832; // ten circular orbits
+
+FewBodyState<2> circle() {
+  FewBodyState<2> s = {};
+  s.mass[0] = 1.0;
+  s.mass[1] = 1e-6;
+  s.x[1] = 1.0;
+  s.vy[1] = 1.0;
+  return s;
+}
+
+// how far the light body ends up from the Newtonian run's, and how many
+// lookups missed the history
+double departure(double c, long &clipped, double span) {
+  FewBodyState<2> newtonian = circle(), delayed = circle();
+  stepFewBody(newtonian, 1.0, 0.0, dt, steps);
+  RetardedHistory<2> history;
+  history.reset(delayed, dt, span);
+  stepRetarded(delayed, history, 1.0, 0.0, c, steps);
+  clipped = history.clipped();
+  return std::hypot(delayed.x[1] - newtonian.x[1],
+                    delayed.y[1] - newtonian.y[1],
+                    delayed.z[1] - newtonian.z[1]);
+}
+
+// the bodies stay about 1 apart, so a few light crossings is plenty
+double room(double c) { return 4.0 / c + 2.0 * dt; }
+
+} // namespace
+
+int main() {
+  int failures = 0;
+  long clipped = 0;
+  const double limit = departure(1e9, clipped, room(1e9));
+  std::printf("c 1e9: %.3e from newtonian after %.1f orbits\n", limit,
+              steps * dt / (2.0 * pi));
+  if (!(limit < 1e-9) || clipped) {
+    std::fprintf(stderr, "retarded_test: no newtonian limit (%.3e)\n", limit);
+    ++failures;
+  }
+  long clippedSlow = 0, clippedFast = 0;
+  const double slow = departure(100.0, clippedSlow, room(100.0));
+  const double fast = departure(1000.0, clippedFast, room(1000.0));
+  std::printf("c 100: %.3e, c 1000: %.3e, ratio %.2f\n", slow, fast,
+              slow / fast);
+  if (!(slow / fast > 8.0 && slow / fast < 12.0) || clippedSlow ||
+      clippedFast) {
+    std::fprintf(stderr, "retarded_test: departure doesn't go as 1 / c\n");
+    ++failures;
+  }
+  // the lookups reach 10 steps back, so the ring doubles from 2 to 32
+  long clippedGrown = 0;
+  const double grown = departure(100.0, clippedGrown, 0.0);
+  std::printf("c 100 from an empty history: %.3e, %ld lookups past it\n",
+              grown, clippedGrown);
+  if (grown != slow || clippedGrown) {
+    std::fprintf(stderr, "retarded_test: the history lost states growing\n");
+    ++failures;
+  }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,608 @@
+// Headless runner: steps a scene without a window and prints energy and
+// timing, for long runs and for profiling the physics on its own.
+//
+//   nbody-run [--scene plummer|three|cloud] [--bodies N] [--steps S]
+//             [--dt DT] [--solver auto|direct|tree]
+//             [--integrator euler|leapfrog|respa] [--substeps K]
+//             [--cutoff R] [--composition leapfrog|yoshida4|suzuki4|
+//             yoshida6|yoshida8] [--every K]
+//             [--tiles auto|TARGETSxSOURCES]
+//             [--backend serial|openmp|stl|pool] [--threads T]
+//             [--numa on|off] [--hugepages off|thp|explicit]
+//             [--processes P] [--parareal SLICES] [--coarse STEPS]
+//             [--events on|off] [--ephemeris FILE] [--light-speed C]
+//             [--retarded on|off]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "physics/domains.h"
+#include "physics/ephemeris.h"
+#include "physics/events.h"
+#include "physics/fewbody.h"
+#include "physics/models.h"
+#include "physics/nbody.h"
+#include "physics/parareal.h"
+#include "physics/perfcounters.h"
+#include "physics/retarded.h"
+#include "physics/sph.h"
+
+namespace {
+
+struct Options {
+  std::string scene = "plummer";
+  size_t bodies = 10000;
+  int steps = 100;
+  double dt = 0.0; // 0 picks a default for the scene
+  std::string solver = "auto";
+  std::string integrator = "leapfrog";
+  int substeps = 4;    // respa's short-range substeps per step
+  double cutoff = 0.0; // respa's split radius, 0 to pick one
+  std::string composition = "leapfrog"; // leapfrog's order
+  int every = 10;
+  std::string tiles; // direct-sum tile sizes, "auto" to time a few
+  std::string backend = "openmp";
+  int threads = 0;
+  bool numa = false; // pinned, node-local thread pool
+  std::string hugePages = "thp";
+  int processes = 1; // above 1, split the plummer scene over processes
+  int slices = 0;    // above 0, run the three scene with Parareal
+  long coarse = 0;   // coarse steps per slice, 0 for 1 per 100 fine steps
+  bool events = false; // log the three scene's encounters and collisions
+  std::string ephemeris; // write the run's trajectories to this file
+  double lightSpeed = 0.0; // above 0, add 1PN terms to the three scene
+  bool retarded = false;   // or delay its gravity by light travel time
+};
+
+bool parse(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value)
+      return false;
+    if (!std::strcmp(arg, "--scene"))
+      options.scene = value;
+    else if (!std::strcmp(arg, "--bodies"))
+      options.bodies = std::strtoull(value, nullptr, 10);
+    else if (!std::strcmp(arg, "--steps"))
+      options.steps = std::atoi(value);
+    else if (!std::strcmp(arg, "--dt"))
+      options.dt = std::atof(value);
+    else if (!std::strcmp(arg, "--solver"))
+      options.solver = value;
+    else if (!std::strcmp(arg, "--integrator"))
+      options.integrator = value;
+    else if (!std::strcmp(arg, "--substeps"))
+      options.substeps = std::max(1, std::atoi(value));
+    else if (!std::strcmp(arg, "--cutoff"))
+      options.cutoff = std::atof(value);
+    else if (!std::strcmp(arg, "--composition"))
+      options.composition = value;
+    else if (!std::strcmp(arg, "--every"))
+      options.every = std::max(1, std::atoi(value));
+    else if (!std::strcmp(arg, "--tiles"))
+      options.tiles = value;
+    else if (!std::strcmp(arg, "--backend"))
+      options.backend = value;
+    else if (!std::strcmp(arg, "--threads"))
+      options.threads = std::max(0, std::atoi(value));
+    else if (!std::strcmp(arg, "--numa"))
+      options.numa = !std::strcmp(value, "on");
+    else if (!std::strcmp(arg, "--hugepages"))
+      options.hugePages = value;
+    else if (!std::strcmp(arg, "--processes"))
+      options.processes = std::max(1, std::atoi(value));
+    else if (!std::strcmp(arg, "--parareal"))
+      options.slices = std::max(0, std::atoi(value));
+    else if (!std::strcmp(arg, "--coarse"))
+      options.coarse = std::max(0L, std::atol(value));
+    else if (!std::strcmp(arg, "--ephemeris"))
+      options.ephemeris = value;
+    else if (!std::strcmp(arg, "--events"))
+      options.events = !std::strcmp(value, "on");
+    else if (!std::strcmp(arg, "--light-speed"))
+      options.lightSpeed = std::max(0.0, std::atof(value));
+    else if (!std::strcmp(arg, "--retarded"))
+      options.retarded = !std::strcmp(value, "on");
+    else
+      return false;
+    ++i;
+  }
+  return true;
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Reads back what --ephemeris wrote and compares it with the positions
+// kept at the report steps.
+bool reportEphemeris(EphemerisWriter &writer, const std::string &path,
+                     const std::vector<double> &times,
+                     const std::vector<double> &positions) {
+  const size_t records = writer.records();
+  Ephemeris ephemeris;
+  if (!writer.close() || !ephemeris.load(path)) {
+    std::fprintf(stderr, "could not write %s (runs shorter than one "
+                 "interval have no records)\n",
+                 path.c_str());
+    return false;
+  }
+  const size_t n = ephemeris.bodies();
+  double worst = 0.0;
+  for (size_t k = 0; k < times.size(); ++k) {
+    if (times[k] > ephemeris.end())
+      break;
+    const double *at = &positions[k * 3 * n];
+    for (size_t i = 0; i < n; ++i) {
+      double p[3];
+      ephemeris.position(i, times[k], p);
+      for (int c = 0; c < 3; ++c)
+        worst = std::max(worst, std::fabs(p[c] - at[c * n + i]));
+    }
+  }
+  const size_t queries = 1000000;
+  volatile double sink = 0.0; // keeps the queries from being optimised out
+  auto start = std::chrono::steady_clock::now();
+  for (size_t q = 0; q < queries; ++q) {
+    double p[3];
+    double t = ephemeris.start() +
+               (ephemeris.end() - ephemeris.start()) * double(q) / queries;
+    ephemeris.position(q % n, t, p);
+    sink = p[0];
+  }
+  const double ns = millisecondsSince(start) * 1e6 / queries;
+  (void)sink;
+  std::printf("ephemeris: %zu records to t %g, worst position error %.3e, "
+              "%.1f ns per query\n",
+              records, ephemeris.end(), worst, ns);
+  return true;
+}
+
+int runGravity(const Options &options) {
+  NBodyParams params;
+  if (options.solver == "direct")
+    params.solver = GravitySolver::Direct;
+  else if (options.solver == "tree")
+    params.solver = GravitySolver::Tree;
+  if (options.integrator == "euler")
+    params.integrator = Integrator::Euler;
+  else if (options.integrator == "respa")
+    params.integrator = Integrator::Respa;
+  if (!parseComposition(options.composition.c_str(), params.composition)) {
+    std::fprintf(stderr, "unknown composition '%s'\n",
+                 options.composition.c_str());
+    return 2;
+  }
+  params.respaSubsteps = options.substeps;
+  params.respaCutoff = options.cutoff;
+  if (!parseBackend(options.backend.c_str(), params.backend)) {
+    std::fprintf(stderr, "unknown backend '%s'\n", options.backend.c_str());
+    return 2;
+  }
+  params.threads = options.threads;
+  if (options.numa) {
+    // only the pool knows about nodes
+    params.backend = Backend::ThreadPool;
+    params.numa = true;
+  }
+
+  double dt = options.dt;
+  NBodySystem system(params);
+  if (options.scene == "three") {
+    // test.cpp's bodies and units
+    addThreeBodies(system.bodies, 1e10, 1.0, params.G);
+    if (dt <= 0.0)
+      dt = 1e-3;
+  } else {
+    // N-body units: G = M = a = 1, crossing time about 1
+    system.params.G = 1.0;
+    system.params.softening = 0.01;
+    addPlummerSphere(system.bodies, options.bodies, 1.0, 1.0, 1.0);
+    if (dt <= 0.0)
+      dt = 1e-3;
+  }
+
+  if (params.numa) {
+    // spatially compact index ranges, so each node's slice of the bodies
+    // is one region of space
+    system.bodies.sortBySpatialKey();
+  }
+  const BodyStore &b = system.bodies;
+  const Executor executor(params.backend, params.threads);
+  if (options.tiles == "auto") {
+    system.params.tiles =
+        tuneGravityTiles(b.size(), b.x.data(), b.y.data(), b.z.data(),
+                         b.mass.data(), system.params.softening, executor);
+    std::printf("tiles %d targets x %d sources\n", system.params.tiles.targets,
+                system.params.tiles.sources);
+  } else if (!options.tiles.empty()) {
+    std::sscanf(options.tiles.c_str(), "%dx%d", &system.params.tiles.targets,
+                &system.params.tiles.sources);
+  }
+
+  // what the step loop costs in TLB misses and page faults, which is what
+  // --hugepages changes
+  PerfCounters counters;
+  counters.start();
+
+  // with --ephemeris, positions at the report steps to check the file by
+  EphemerisWriter writer;
+  std::vector<double> checkTimes, checkPositions;
+  if (!options.ephemeris.empty()) {
+    EphemerisParams fit;
+    fit.interval = 20.0 * dt;
+    if (!writer.open(options.ephemeris, system.bodies, system.time, fit)) {
+      std::fprintf(stderr, "could not write %s\n", options.ephemeris.c_str());
+      return 1;
+    }
+  }
+
+  const double e0 = system.energy();
+  std::printf("%zu bodies, dt %g, energy %.9g, %s backend on %d threads\n",
+              system.size(), dt, e0, backendName(params.backend),
+              executor.threads());
+  double total = 0.0;
+  for (int step = 1; step <= options.steps; ++step) {
+    auto start = std::chrono::steady_clock::now();
+    system.step(dt);
+    total += millisecondsSince(start);
+    if (!options.ephemeris.empty())
+      writer.add(system.bodies, system.time);
+    if (step % options.every == 0 || step == options.steps) {
+      if (!options.ephemeris.empty()) {
+        checkTimes.push_back(system.time);
+        for (const auto *a : {&b.x, &b.y, &b.z})
+          checkPositions.insert(checkPositions.end(), a->begin(), a->end());
+      }
+      double e = system.energy();
+      std::printf("step %6d  t %-10.4g  energy %.9g  drift %+.3e  %.2f ms/step\n",
+                  step, system.time, e, (e - e0) / std::fabs(e0),
+                  total / step);
+    }
+  }
+
+  counters.stop();
+  if (!options.ephemeris.empty() &&
+      !reportEphemeris(writer, options.ephemeris, checkTimes, checkPositions))
+    return 1;
+  for (int e = 0; e < PerfCounters::EventCount; ++e) {
+    auto event = PerfCounters::Event(e);
+    if (counters.available(event))
+      std::printf("%s: %.4g per step\n", PerfCounters::name(event),
+                  double(counters.count(event)) / options.steps);
+    else
+      std::printf("%s: not available\n", PerfCounters::name(event));
+  }
+
+  const std::vector<NodeStats> nodes = system.lastExecutor().nodeStats();
+  for (size_t k = 0; params.numa && k < nodes.size(); ++k)
+    std::printf("node %zu: %d threads, %zu chunks (%zu stolen), %.2f s busy\n",
+                k, nodes[k].threads, nodes[k].chunks, nodes[k].stolen,
+                nodes[k].busySeconds);
+  return 0;
+}
+
+int runSplit(const Options &options) {
+  // the processes last the whole run and stop every --every steps while
+  // this one measures the energy, so cuts move by measured force time
+  NBodyParams params;
+  params.G = 1.0;
+  params.softening = 0.01;
+  NBodySystem system(params);
+  addPlummerSphere(system.bodies, options.bodies, 1.0, 1.0, 1.0);
+  const double dt = options.dt > 0.0 ? options.dt : 1e-3;
+  DomainParams split;
+  split.processes = options.processes;
+  split.G = params.G;
+  split.softening = params.softening;
+  split.reportEvery = options.every;
+  split.numa = options.numa;
+
+  const double e0 = system.energy();
+  std::printf("%zu bodies, dt %g, energy %.9g, %d processes\n", system.size(),
+              dt, e0, options.processes);
+  std::vector<DomainStats> stats;
+  auto start = std::chrono::steady_clock::now();
+  double paused = 0.0; // spent on the energy, not the steps
+  auto report = [&](int step) {
+    const double total = millisecondsSince(start) - paused;
+    auto measuring = std::chrono::steady_clock::now();
+    double e = system.energy();
+    std::printf("step %6d  t %-10.4g  energy %.9g  drift %+.3e  %.2f ms/step\n",
+                step, step * dt, e, (e - e0) / std::fabs(e0), total / step);
+    paused += millisecondsSince(measuring);
+  };
+  if (!runDomains(system.bodies, split, dt, options.steps, &stats, report)) {
+    std::fprintf(stderr, "could not run the processes\n");
+    return 1;
+  }
+  for (size_t p = 0; p < stats.size(); ++p)
+    std::printf("process %zu: %zu bodies, %zu ghosts, %zu multipoles, "
+                "%.0f others per body, %.2f s in forces\n",
+                p, stats[p].bodies, stats[p].ghosts, stats[p].multipoles,
+                double(stats[p].interactions) /
+                    double(std::max<size_t>(1, stats[p].bodies)),
+                stats[p].forceSeconds);
+  return 0;
+}
+
+int runParallelInTime(const Options &options) {
+  // the three scene's bodies, stepped serially and then with Parareal over
+  // the same steps, to compare answer and wall-clock time
+  NBodyParams params;
+  NBodySystem system(params);
+  addThreeBodies(system.bodies, 1e10, 1.0, params.G);
+  const double dt = options.dt > 0.0 ? options.dt : 1e-3;
+  const double eps2 = params.softening * params.softening;
+  PararealParams parallel;
+  parallel.slices = options.slices;
+  parallel.fineSteps = std::max(1L, long(options.steps) / options.slices);
+  parallel.coarseSteps = options.coarse > 0
+                             ? options.coarse
+                             : std::max(1L, parallel.fineSteps / 100);
+  const long steps = parallel.fineSteps * parallel.slices;
+  Backend backend;
+  if (!parseBackend(options.backend.c_str(), backend)) {
+    std::fprintf(stderr, "unknown backend '%s'\n", options.backend.c_str());
+    return 2;
+  }
+  const Executor executor(backend, options.threads);
+
+  FewBodyState<3> serial = fewBodiesFrom<3>(system.bodies);
+  FewBodyState<3> sliced = serial;
+  auto start = std::chrono::steady_clock::now();
+  stepFewBody(serial, params.G, eps2, dt, steps);
+  const double serialMs = millisecondsSince(start);
+  start = std::chrono::steady_clock::now();
+  PararealStats stats =
+      runParareal(sliced, params.G, eps2, steps * dt, parallel, executor);
+  const double slicedMs = millisecondsSince(start);
+
+  std::printf("%ld steps of %g in %d slices, %ld coarse steps each, %s "
+              "backend on %d threads\n",
+              steps, dt, parallel.slices, parallel.coarseSteps,
+              backendName(backend), executor.threads());
+  std::printf("serial %.2f ms, parareal %.2f ms in %d iterations (last "
+              "change %.3e), differs by %.3e\n",
+              serialMs, slicedMs, stats.iterations, stats.change,
+              parareal::change(serial, sliced));
+  return 0;
+}
+
+int runPostNewtonian(const Options &options) {
+  // the three scene's bodies, stepped with Newtonian gravity and with the
+  // 1PN terms for a light speed of options.lightSpeed in the scene's units
+  NBodyParams params;
+  NBodySystem system(params);
+  addThreeBodies(system.bodies, 1e10, 1.0, params.G);
+  const double dt = options.dt > 0.0 ? options.dt : 1e-3;
+  const double c = options.lightSpeed;
+
+  FewBodyState<3> newtonian = fewBodiesFrom<3>(system.bodies);
+  FewBodyState<3> relativistic = newtonian;
+  auto start = std::chrono::steady_clock::now();
+  stepFewBody<3, false>(newtonian, params.G, 0.0, dt, options.steps, c);
+  const double newtonianMs = millisecondsSince(start);
+  start = std::chrono::steady_clock::now();
+  stepFewBody<3, true>(relativistic, params.G, 0.0, dt, options.steps, c);
+  const double relativisticMs = millisecondsSince(start);
+
+  double apart = 0.0;
+  for (int i = 0; i < 3; ++i) {
+    double dx = relativistic.x[i] - newtonian.x[i];
+    double dy = relativistic.y[i] - newtonian.y[i];
+    double dz = relativistic.z[i] - newtonian.z[i];
+    apart = std::max(apart, std::sqrt(dx * dx + dy * dy + dz * dz));
+  }
+  std::printf("%d steps of %g, c %g: newtonian %.2f ms, 1pn %.2f ms, "
+              "bodies up to %.6e apart\n",
+              options.steps, dt, c, newtonianMs, relativisticMs, apart);
+  return 0;
+}
+
+int runRetarded(const Options &options) {
+  // the three scene's bodies, stepped with Newtonian gravity and with
+  // gravity that travels at options.lightSpeed
+  NBodyParams params;
+  NBodySystem system(params);
+  addThreeBodies(system.bodies, 1e10, 1.0, params.G);
+  const double dt = options.dt > 0.0 ? options.dt : 1e-3;
+  const double c = options.lightSpeed;
+  const double eps2 = params.softening * params.softening;
+
+  FewBodyState<3> newtonian = fewBodiesFrom<3>(system.bodies);
+  FewBodyState<3> delayed = newtonian;
+  auto start = std::chrono::steady_clock::now();
+  stepFewBody(newtonian, params.G, eps2, dt, options.steps);
+  const double newtonianMs = millisecondsSince(start);
+  // room for twice the light travel time across the scene as it starts;
+  // the history doubles as the bodies spread out
+  double spread = 0.0;
+  for (int i = 0; i < 3; ++i)
+    for (int j = i + 1; j < 3; ++j)
+      spread = std::max(spread, std::hypot(delayed.x[j] - delayed.x[i],
+                                           delayed.y[j] - delayed.y[i],
+                                           delayed.z[j] - delayed.z[i]));
+  RetardedHistory<3> history;
+  history.reset(delayed, dt, 2.0 * spread / c);
+  start = std::chrono::steady_clock::now();
+  stepRetarded(delayed, history, params.G, eps2, c, options.steps);
+  const double delayedMs = millisecondsSince(start);
+
+  // the three scene flies apart chaotically, so compare how far each run
+  // strays from the starting energy rather than the runs' positions
+  auto energy = [&](const FewBodyState<3> &s) {
+    double e = 0.0;
+    for (int i = 0; i < 3; ++i) {
+      e += 0.5 * s.mass[i] *
+           (s.vx[i] * s.vx[i] + s.vy[i] * s.vy[i] + s.vz[i] * s.vz[i]);
+      for (int j = i + 1; j < 3; ++j) {
+        double dx = s.x[j] - s.x[i], dy = s.y[j] - s.y[i],
+               dz = s.z[j] - s.z[i];
+        e -= params.G * s.mass[i] * s.mass[j] /
+             std::sqrt(dx * dx + dy * dy + dz * dz + eps2);
+      }
+    }
+    return e;
+  };
+  const double e0 = energy(fewBodiesFrom<3>(system.bodies));
+  std::printf("%d steps of %g, c %g: newtonian %.2f ms, retarded %.2f ms "
+              "(%.0f ns/step, history %g long in %.1f MB, %ld lookups past "
+              "it)\n",
+              options.steps, dt, c, newtonianMs, delayedMs,
+              delayedMs * 1e6 / std::max(1, options.steps), history.span(),
+              history.bytes() / 1048576.0, history.clipped());
+  if (history.clipped() > 0) {
+    // only bodies near or past c outrun a history that keeps doubling
+    double fastest = 0.0;
+    for (int i = 0; i < 3; ++i)
+      fastest = std::max(fastest, std::hypot(delayed.vx[i], delayed.vy[i],
+                                             delayed.vz[i]));
+    std::fprintf(stderr,
+                 "warning: %ld lookups reached past the history and were "
+                 "extrapolated (fastest body %.2f c); the retarded figures "
+                 "don't hold\n",
+                 history.clipped(), fastest / c);
+  }
+  std::printf("energy drift: newtonian %+.3e, retarded %+.3e\n",
+              (energy(newtonian) - e0) / std::fabs(e0),
+              (energy(delayed) - e0) / std::fabs(e0));
+  return 0;
+}
+
+int runEvents(const Options &options) {
+  // the three scene, with every pair's collisions and close approaches and
+  // the first pair's turning points located inside the steps
+  NBodyParams params;
+  NBodySystem system(params);
+  addThreeBodies(system.bodies, 1e10, 1.0, params.G);
+  const BodyStore &b = system.bodies;
+  const double dt = options.dt > 0.0 ? options.dt : 1e-3;
+  std::vector<Event> list;
+  for (int i = 0; i < 3; ++i) {
+    for (int j = i + 1; j < 3; ++j) {
+      list.push_back({EventKind::Collision, i, j, b.radius[i] + b.radius[j]});
+      list.push_back({EventKind::CloseApproach, i, j, 0.5});
+    }
+  }
+  list.push_back({EventKind::Pericentre, 0, 1, 0.0});
+  list.push_back({EventKind::Apocentre, 0, 1, 0.0});
+
+  const char *names[] = {"collision", "close approach", "pericentre",
+                         "apocentre"};
+  size_t counts[4] = {};
+  auto onEvent = [&](size_t k, double time, FewBodyState<3> &s) {
+    const Event &e = list[k];
+    const int i = e.i, j = e.j;
+    double dx = s.x[j] - s.x[i], dy = s.y[j] - s.y[i], dz = s.z[j] - s.z[i];
+    double distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+    ++counts[int(e.kind)];
+    std::printf("t %-12.8g %-15s %d-%d  distance %.9g\n", time,
+                names[int(e.kind)], i, j, distance);
+    if (e.kind != EventKind::Collision || distance <= 0.0)
+      return EventAction::Continue;
+    // gravity.cpp's bounce: keep a fifth of the closing speed
+    dx /= distance, dy /= distance, dz /= distance;
+    double closing = (s.vx[i] - s.vx[j]) * dx + (s.vy[i] - s.vy[j]) * dy +
+                     (s.vz[i] - s.vz[j]) * dz;
+    if (closing <= 0.0)
+      return EventAction::Continue;
+    double impulse = 1.2 * closing / (1.0 / s.mass[i] + 1.0 / s.mass[j]);
+    s.vx[i] -= dx * impulse / s.mass[i];
+    s.vy[i] -= dy * impulse / s.mass[i];
+    s.vz[i] -= dz * impulse / s.mass[i];
+    s.vx[j] += dx * impulse / s.mass[j];
+    s.vy[j] += dy * impulse / s.mass[j];
+    s.vz[j] += dz * impulse / s.mass[j];
+    return EventAction::Restart;
+  };
+
+  FewBodyState<3> s = fewBodiesFrom<3>(b);
+  double t = 0.0;
+  const double eps2 = params.softening * params.softening;
+  auto start = std::chrono::steady_clock::now();
+  stepWithEvents(s, t, params.G, eps2, dt, options.steps, list, onEvent);
+  const double ms = millisecondsSince(start);
+  std::printf("%d steps of %g to t %g in %.2f ms: %zu collisions, %zu close "
+              "approaches, %zu pericentres, %zu apocentres\n",
+              options.steps, dt, t, ms, counts[0], counts[1], counts[2],
+              counts[3]);
+  return 0;
+}
+
+int runCloud(const Options &options) {
+  SphGas gas;
+  gas.addCloud(0.0, 0.0, 0.0, 1.0, options.bodies, 1.0, 0.05);
+  std::printf("%zu particles\n", gas.size());
+  double total = 0.0;
+  double time = 0.0;
+  for (int step = 1; step <= options.steps; ++step) {
+    double dt = options.dt > 0.0 ? options.dt : gas.stableTimestep();
+    auto start = std::chrono::steady_clock::now();
+    gas.step(dt);
+    total += millisecondsSince(start);
+    time += dt;
+    if (step % options.every == 0 || step == options.steps) {
+      double densest = 0.0;
+      for (double rho : gas.rho)
+        densest = std::max(densest, rho);
+      std::printf("step %6d  t %-10.4g  kinetic %.6g  thermal %.6g  "
+                  "max density %.4g  %.2f ms/step\n",
+                  step, time, gas.kineticEnergy(), gas.thermalEnergy(),
+                  densest, total / step);
+    }
+  }
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  bool parsed = parse(argc, argv, options);
+  if (options.hugePages == "off")
+    setHugePages(HugePages::Off);
+  else if (options.hugePages == "explicit")
+    setHugePages(HugePages::Explicit);
+  else if (options.hugePages != "thp")
+    parsed = false;
+  if (!parsed) {
+    std::fprintf(stderr,
+                 "usage: %s [--scene plummer|three|cloud] [--bodies N] "
+                 "[--steps S] [--dt DT] [--solver auto|direct|tree] "
+                 "[--integrator euler|leapfrog|respa] [--substeps K] "
+                 "[--cutoff R] [--composition leapfrog|yoshida4|suzuki4|"
+                 "yoshida6|yoshida8] [--every K] "
+                 "[--tiles auto|TARGETSxSOURCES] "
+                 "[--backend serial|openmp|stl|pool] [--threads T] "
+                 "[--numa on|off] [--hugepages off|thp|explicit] "
+                 "[--processes P] [--parareal SLICES] [--coarse STEPS] "
+                 "[--events on|off] [--ephemeris FILE] "
+                 "[--light-speed C] [--retarded on|off]\n",
+                 argv[0]);
+    return 2;
+  }
+  if (options.scene == "cloud")
+    return runCloud(options);
+  if (options.scene == "three" && options.events)
+    return runEvents(options);
+  if (options.scene == "three" && options.lightSpeed > 0.0)
+    return options.retarded ? runRetarded(options)
+                            : runPostNewtonian(options);
+  if (options.scene == "three" && options.slices > 0)
+    return runParallelInTime(options);
+  if (options.scene == "plummer" && options.processes > 1)
+    return runSplit(options);
+  if (options.scene == "plummer" || options.scene == "three")
+    return runGravity(options);
+  std::fprintf(stderr, "unknown scene '%s'\n", options.scene.c_str());
+  return 2;
+}